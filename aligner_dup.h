@@ -0,0 +1,251 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ALIGNER_DUP_H_
+#define ALIGNER_DUP_H_
+
+#include <stdint.h>
+#include "assert_helpers.h"
+#include "ds.h"
+#include "sstring.h"
+#include "read.h"
+#include "edit.h"
+#include "mem_ids.h"
+#include "aligner_result.h"
+#include "aln_sink.h"
+#include "threading.h"
+
+/**
+ * The alignments reported for one read or pair, kept apart from the
+ * aligner that found them.  'kinds' lists the alignments in the order they
+ * were reported (ALN_REP_PAIR, ALN_REP_MATE1 or ALN_REP_MATE2); a pair
+ * takes two consecutive elements of 'alns'.  The edits of alns[i] are
+ * edits[editOffs[2i] .. editOffs[2i+1]) (nucleotide edits) and
+ * edits[editOffs[2i+1] .. editOffs[2i+2]) (ambiguous-base edits).
+ */
+struct DupReadEntry {
+
+	DupReadEntry() :
+		hash(0),
+		hits(0),
+		kinds(4, RES_CAT),
+		alns(4, RES_CAT),
+		edits(16, RES_CAT),
+		editOffs(16, RES_CAT)
+	{ }
+
+	void reset() {
+		hash = 0;
+		hits = 0;
+		key.clear();
+		kinds.clear();
+		alns.clear();
+		edits.clear();
+		editOffs.clear();
+	}
+
+	bool empty() const { return key.empty(); }
+
+	/**
+	 * Append a detached copy of 'res' and its edits.
+	 */
+	void add(const AlnRes& res) {
+		if(editOffs.empty()) editOffs.push_back(0);
+		alns.expand();
+		alns.back().copyScalars(res);
+		for(size_t i = 0; i < res.ned().size(); i++) {
+			edits.push_back(res.ned()[i]);
+		}
+		editOffs.push_back((uint32_t)edits.size());
+		for(size_t i = 0; i < res.aed().size(); i++) {
+			edits.push_back(res.aed()[i]);
+		}
+		editOffs.push_back((uint32_t)edits.size());
+	}
+
+	/**
+	 * Rebuild alignment i for read 'rdid' in 'res', allocating its edits
+	 * from 'raw_edits'.
+	 */
+	void get(
+		size_t i,
+		TReadId rdid,
+		AlnRes& res,
+		LinkedEList<EList<Edit> >* raw_edits) const
+	{
+		assert_lt(i, alns.size());
+		assert_lt(2 * i + 2, editOffs.size());
+		size_t ned_i = editOffs[2 * i], aed_i = editOffs[2 * i + 1];
+		res.init(
+			alns[i],
+			rdid,
+			edits, ned_i, aed_i - ned_i,
+			edits, aed_i, editOffs[2 * i + 2] - aed_i,
+			raw_edits);
+	}
+
+	uint64_t         hash;     // hash of key
+	uint32_t         hits;     // times reused since stored (decays)
+	BTString         key;      // mate sequences and qualities
+	EList<uint8_t>   kinds;    // kind of each reported alignment
+	EList<AlnRes>    alns;     // reported alignments, without edits
+	EList<Edit>      edits;    // edits of all alignments
+	EList<uint32_t>  editOffs; // offsets into edits
+};
+
+/**
+ * Bounded table, shared by all search threads, of the alignments reported
+ * for reads and pairs seen so far.  RNA-seq libraries are dominated by a
+ * few highly expressed transcripts, so many reads or pairs are exact
+ * copies of one aligned earlier; these are answered from the table
+ * without searching the index again.
+ *
+ * The table is direct-mapped: a read can only live in the slot its hash
+ * selects.  A new read replaces the one in its slot only once that one
+ * has gone unused for a while, so reads that keep coming back stay put.
+ * Slots are protected by a fixed set of striped locks.
+ *
+ * The key covers everything in the read that the search looks at (the
+ * sequences and qualities of the mates that pass the filters); everything
+ * else that affects the search is fixed for the whole run.
+ */
+class DupReadCache {
+
+	static const size_t NLOCKS = 256;
+
+public:
+
+	explicit DupReadCache(size_t nslots) : nslots_(nslots) {
+		assert_gt(nslots_, 0);
+		slots_.resize(nslots_);
+		for(size_t i = 0; i < NLOCKS; i++) {
+			LOCK_SITE(locks_[i], "DupReadCache");
+		}
+	}
+
+	/**
+	 * Build the key for a read (rd2 NULL) or pair; mates that didn't pass
+	 * the filters are left out.
+	 */
+	static void makeKey(
+		const Read& rd1,
+		const Read* rd2,
+		const bool filt[2],
+		BTString& key)
+	{
+		key.clear();
+		const Read* rds[2] = { &rd1, rd2 };
+		for(size_t mate = 0; mate < 2; mate++) {
+			key.append((char)('0' + (rds[mate] == NULL ? 0 : 1) + (filt[mate] ? 2 : 0)));
+			if(rds[mate] == NULL || !filt[mate]) continue;
+			const Read& rd = *rds[mate];
+			for(size_t i = 0; i < rd.patFw.length(); i++) {
+				key.append("ACGTN"[(int)rd.patFw[i]]);
+			}
+			key.append('\t');
+			key.append(rd.qual.buf(), rd.qual.length());
+			key.append('\n');
+		}
+	}
+
+	/**
+	 * Look up 'key'.  If found, copy the entry to 'ent' and return true.
+	 */
+	bool lookup(const BTString& key, DupReadEntry& ent) {
+		uint64_t h = hash(key);
+		size_t slot = (size_t)(h % nslots_);
+		ThreadSafe t(&locks_[slot % NLOCKS]);
+		DupReadEntry& e = slots_[slot];
+		if(e.empty() || e.hash != h || e.key != key) {
+			// A miss ages whatever is in the slot
+			if(e.hits > 0) e.hits >>= 1;
+			return false;
+		}
+		if(e.hits < 0xffff) e.hits++;
+		ent.kinds = e.kinds;
+		ent.alns = e.alns;
+		ent.edits = e.edits;
+		ent.editOffs = e.editOffs;
+		return true;
+	}
+
+	/**
+	 * Store the alignments reported for 'key', in the order they were
+	 * reported.  'rs1'/'rs2' hold the concordant pairs and 'rs1u'/'rs2u'
+	 * the unpaired alignments, as in AlnSinkWrap.  An empty 'kinds' is
+	 * stored as well: reads that fail to align are duplicated as much as
+	 * any others.
+	 */
+	void insert(
+		const BTString& key,
+		const EList<uint8_t>& kinds,
+		const EList<AlnRes>& rs1,
+		const EList<AlnRes>& rs2,
+		const EList<AlnRes>& rs1u,
+		const EList<AlnRes>& rs2u)
+	{
+		uint64_t h = hash(key);
+		size_t slot = (size_t)(h % nslots_);
+		ThreadSafe t(&locks_[slot % NLOCKS]);
+		DupReadEntry& e = slots_[slot];
+		if(!e.empty() && e.hits > 0) {
+			return;
+		}
+		e.reset();
+		e.hash = h;
+		e.key = key;
+		size_t ip = 0, i1 = 0, i2 = 0;
+		for(size_t i = 0; i < kinds.size(); i++) {
+			e.kinds.push_back(kinds[i]);
+			if(kinds[i] == ALN_REP_PAIR) {
+				e.add(rs1[ip]);
+				e.add(rs2[ip]);
+				ip++;
+			} else if(kinds[i] == ALN_REP_MATE1) {
+				e.add(rs1u[i1++]);
+			} else {
+				assert_eq(ALN_REP_MATE2, kinds[i]);
+				e.add(rs2u[i2++]);
+			}
+		}
+		assert_eq(ip, rs1.size());
+		assert_eq(i1, rs1u.size());
+		assert_eq(i2, rs2u.size());
+	}
+
+protected:
+
+	/**
+	 * 64-bit FNV-1a hash of the key.
+	 */
+	static uint64_t hash(const BTString& key) {
+		uint64_t h = 14695981039346656037ULL;
+		for(size_t i = 0; i < key.length(); i++) {
+			h ^= (uint8_t)key[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+
+	size_t              nslots_;
+	EList<DupReadEntry> slots_;
+	MUTEX_T             locks_[NLOCKS];
+};
+
+#endif /*ALIGNER_DUP_H_*/
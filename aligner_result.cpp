@@ -906,10 +906,10 @@ void StackedAln::writeCigar(
 		for(size_t i = 0; i < op.size(); i++) {
 			size_t r = run[i];
 			if(r > 0) {
-				itoa10<size_t>(r, buf);
+				size_t nbuf = itoa10<size_t>(r, buf) - buf;
 				ASSERT_ONLY(printed = true);
 				if(o != NULL) {
-					o->append(buf);
+					o->append(buf, nbuf);
 					o->append(op[i]);
 				}
 				if(occ != NULL) {
@@ -943,8 +943,8 @@ void StackedAln::writeMdz(BTString* o, char* occ) const {
 		if(r > 0) {
 			if(op[i] == '=') {
 				// Write run length
-				itoa10<size_t>(r, buf);
-				if(o != NULL)  { o->append(buf); }
+				size_t nbuf = itoa10<size_t>(r, buf) - buf;
+				if(o != NULL)  { o->append(buf, nbuf); }
 				if(occ != NULL) { COPY_BUF(); }
 				first_print = false;
 				mm_last = false;
@@ -905,35 +905,7 @@ public:
     aed_node_(NULL),
     raw_edits_(NULL)
     {
-        shapeSet_ = other.shapeSet_;
-        rdlen_ = other.rdlen_;
-        rdid_ = other.rdid_;
-        rdrows_ = other.rdrows_;
-        score_ = other.score_;
-        oscore_ = other.oscore_;
-        refcoord_ = other.refcoord_;
-        reflen_ = other.reflen_;
-        refival_ = other.refival_;
-        rdextent_ = other.rdextent_;
-        rdexrows_ = other.rdexrows_;
-        rfextent_ = other.rfextent_;
-        seedmms_ = other.seedmms_;
-        seedlen_ = other.seedlen_;
-        minsc_ = other.minsc_;
-        nuc5p_ = other.nuc5p_;
-        nuc3p_ = other.nuc3p_;
-        refns_ = other.refns_;
-        type_ = other.type_;
-        fraglenSet_ = other.fraglenSet_;
-        fraglen_ = other.fraglen_;
-        pretrimSoft_ = other.pretrimSoft_;
-        pretrim5p_ = other.pretrim5p_;
-        pretrim3p_ = other.pretrim3p_;
-        trimSoft_ = other.trimSoft_;
-        trim5p_ = other.trim5p_;
-        trim3p_ = other.trim3p_;
-        
-        num_spliced_ = other.num_spliced_;
+        copyScalars(other);
         raw_edits_ = other.raw_edits_;
         if(raw_edits_ != NULL) {
             assert(ned_ == NULL && aed_ == NULL);
@@ -951,6 +923,38 @@ public:
     
     AlnRes& operator=(const AlnRes& other) {
         if(this == &other) return *this;
+        copyScalars(other);
+        assert(raw_edits_ == NULL || raw_edits_ == other.raw_edits_);
+        raw_edits_ = other.raw_edits_;
+        if(ned_ != NULL) {
+            assert(aed_ != NULL);
+            ned_->clear();
+            aed_->clear();
+        } else if(raw_edits_ != NULL) {
+            assert(aed_ == NULL);
+            assert(ned_node_ == NULL && aed_node_ == NULL);
+            ned_node_ = raw_edits_->new_node();
+            aed_node_ = raw_edits_->new_node();
+            assert(ned_node_ != NULL && aed_node_ != NULL);
+            ned_ = &(ned_node_->payload);
+            aed_ = &(aed_node_->payload);
+        }
+        
+        if(other.ned_ != NULL) {
+            assert(other.aed_ != NULL);
+            *ned_ = *(other.ned_);
+            *aed_ = *(other.aed_);
+        }
+        
+        return *this;
+    }
+    
+    /**
+     * Copy every field except the edits from 'other'.  Called on an AlnRes
+     * that isn't attached to an edit pool, this makes a detached copy
+     * that can outlive the aligner that produced 'other'.
+     */
+    void copyScalars(const AlnRes& other) {
         shapeSet_ = other.shapeSet_;
         rdlen_ = other.rdlen_;
         rdid_ = other.rdid_;
@@ -978,31 +982,46 @@ public:
         trimSoft_ = other.trimSoft_;
         trim5p_ = other.trim5p_;
         trim3p_ = other.trim3p_;
-        
         num_spliced_ = other.num_spliced_;
-        assert(raw_edits_ == NULL || raw_edits_ == other.raw_edits_);
-        raw_edits_ = other.raw_edits_;
-        if(ned_ != NULL) {
-            assert(aed_ != NULL);
-            ned_->clear();
-            aed_->clear();
-        } else if(raw_edits_ != NULL) {
+    }
+    
+    /**
+     * Make this a copy of 'other' for read 'rdid', with edits 'ned' and
+     * 'aed' allocated from 'raw_edits'.  'other' is typically a detached
+     * copy made with copyScalars().
+     */
+    void init(
+              const AlnRes& other,
+              TReadId rdid,
+              const EList<Edit>& ned,
+              size_t ned_i,
+              size_t ned_n,
+              const EList<Edit>& aed,
+              size_t aed_i,
+              size_t aed_n,
+              LinkedEList<EList<Edit> >* raw_edits)
+    {
+        assert(raw_edits != NULL);
+        assert(raw_edits_ == NULL || raw_edits_ == raw_edits);
+        copyScalars(other);
+        rdid_ = rdid;
+        raw_edits_ = raw_edits;
+        if(ned_ == NULL) {
             assert(aed_ == NULL);
             assert(ned_node_ == NULL && aed_node_ == NULL);
             ned_node_ = raw_edits_->new_node();
             aed_node_ = raw_edits_->new_node();
-            assert(ned_node_ != NULL && aed_node_ != NULL);
             ned_ = &(ned_node_->payload);
             aed_ = &(aed_node_->payload);
         }
-        
-        if(other.ned_ != NULL) {
-            assert(other.aed_ != NULL);
-            *ned_ = *(other.ned_);
-            *aed_ = *(other.aed_);
+        ned_->clear();
+        aed_->clear();
+        for(size_t i = ned_i; i < ned_i + ned_n; i++) {
+            ned_->push_back(ned[i]);
+        }
+        for(size_t i = aed_i; i < aed_i + aed_n; i++) {
+            aed_->push_back(aed[i]);
         }
-        
-        return *this;
     }
     
     ~AlnRes()
@@ -1567,6 +1586,7 @@ public:
 		const AlnFlags& flags,  // flags for this mate
         const SpliceSiteDB* ssdb = NULL, // splice sites
         uint64_t threads_rids_mindist = 0,
+        uint64_t ss_epoch = 0,
         EList<SpliceSite>* spliceSites = NULL)
 	{
 		assert_gt(type, 0);
@@ -1583,7 +1603,7 @@ public:
 			if((sameChr && refcoord_.ref() == omate->refcoord_.ref()) ||
 			   flags.alignedConcordant())
 			{
-				setFragmentLength(*omate, ssdb, threads_rids_mindist, spliceSites);
+				setFragmentLength(*omate, ssdb, threads_rids_mindist, ss_epoch, spliceSites);
 			} else {
 				assert(!isFraglenSet());
 			}
@@ -1601,6 +1621,7 @@ public:
     int64_t setFragmentLength(const AlnRes& omate,
                               const SpliceSiteDB* ssdb = NULL, // splice sites
                               uint64_t threads_rids_mindist = 0,
+                              uint64_t ss_epoch = 0,
                               EList<SpliceSite>* spliceSites = NULL) {
 		Coord st, en, st2, en2;
 		Coord ost, oen, ost2, oen2;
@@ -1629,7 +1650,7 @@ public:
             }
             for(size_t si = 0; si < spliceSites->size(); si++) {
                 const SpliceSite& ss = (*spliceSites)[si];
-                if(!ss._fromfile && ss._readid + threads_rids_mindist > rdid_) continue;
+                if(!ss._fromfile && ss._readid >= novelSpliceSiteBound(rdid_, threads_rids_mindist, ss_epoch)) continue;
                 if(ss.left() <= up || ss.right() >= dn) continue;
                 TRefOff tmp_intron_len = ss.intron_len();
                 if(intron_len < tmp_intron_len) {
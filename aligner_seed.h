@@ -2068,12 +2068,12 @@ bool SeedAligner<index_t>::oneMmSearch(
 			const Ebwt<index_t>* ebwtp = (ebwtfw ? ebwtBw : ebwtFw);
 			assert(rep1mm || ebwt->fw());
 			const BTDnaString& seq =
-			(fw ? (ebwtfw ? read.patFw : read.patFwRev) :
-			 (ebwtfw ? read.patRc : read.patRcRev));
+			(fw ? (ebwtfw ? read.patFw : read.patFwRev()) :
+			 (ebwtfw ? read.patRc : read.patRcRev()));
 			assert(!seq.empty());
 			const BTString& qual =
-			(fw ? (ebwtfw ? read.qual    : read.qualRev) :
-			 (ebwtfw ? read.qualRev : read.qual));
+			(fw ? (ebwtfw ? read.qual    : read.qualRev()) :
+			 (ebwtfw ? read.qualRev() : read.qual));
 			int ftabLen = ebwt->eh().ftabChars();
 			size_t nea = ebwtfw ? halfFw : halfBw;
 			// Check if there's an N in the near portion
@@ -1556,7 +1556,7 @@ int SwDriver<index_t>::extendSeeds(
 					resUngap_.reset();
 					int al = swa.ungappedAlign(
 											   fw ? rd.patFw : rd.patRc,
-											   fw ? rd.qual  : rd.qualRev,
+											   fw ? rd.qual  : rd.qualRev(),
 											   refcoord,
 											   ref,
 											   tlen,
@@ -1630,7 +1630,7 @@ int SwDriver<index_t>::extendSeeds(
 									 rd.patFw,  // fw version of query
 									 rd.patRc,  // rc version of query
 									 rd.qual,   // fw version of qualities
-									 rd.qualRev,// rc version of qualities
+									 rd.qualRev(),// rc version of qualities
 									 0,         // off of first char in 'rd' to consider
 									 rdlen,     // off of last char (excl) in 'rd' to consider
 									 sc);       // scoring scheme
@@ -2268,7 +2268,7 @@ int SwDriver<index_t>::extendSeedsPaired(
 					resUngap_.reset();
 					int al = swa.ungappedAlign(
 											   fw ? rd.patFw : rd.patRc,
-											   fw ? rd.qual  : rd.qualRev,
+											   fw ? rd.qual  : rd.qualRev(),
 											   refcoord,
 											   ref,
 											   tlen,
@@ -2328,7 +2328,7 @@ int SwDriver<index_t>::extendSeedsPaired(
 									 rd.patFw,  // fw version of query
 									 rd.patRc,  // rc version of query
 									 rd.qual,   // fw version of qualities
-									 rd.qualRev,// rc version of qualities
+									 rd.qualRev(),// rc version of qualities
 									 0,         // off of first char in 'rd' to consider
 									 rdlen,     // off of last char (excl) in 'rd' to consider
 									 sc);       // scoring scheme
@@ -2509,7 +2509,7 @@ int SwDriver<index_t>::extendSeedsPaired(
 							//	oresUngap_.reset();
 							//	oungappedAlign = oswa.ungappedAlign(
 							//		ofw ? ord.patFw : ord.patRc,
-							//		ofw ? ord.qual  : ord.qualRev,
+							//		ofw ? ord.qual  : ord.qualRev(),
 							//		orefcoord,
 							//		ref,
 							//		otlen,
@@ -2559,7 +2559,7 @@ int SwDriver<index_t>::extendSeedsPaired(
 											  ord.patFw,  // read to align
 											  ord.patRc,  // qualities
 											  ord.qual,   // read to align
-											  ord.qualRev,// qualities
+											  ord.qualRev(),// qualities
 											  0,          // off of first char to consider
 											  ordlen,     // off of last char (ex) to consider
 											  sc);        // scoring scheme
@@ -27,6 +27,7 @@
 #include "ds.h"
 #include "simple_func.h"
 #include "outq.h"
+#include "read_dump.h"
 #include <utility>
 #include "alt.h"
 #include "splice_site.h"
@@ -39,6 +40,13 @@ enum {
 	OUTPUT_SAM = 1
 };
 
+// Kinds of alignment passed to AlnSinkWrap::report()
+enum {
+	ALN_REP_PAIR = 0, // concordant pair
+	ALN_REP_MATE1,    // unpaired alignment for mate 1
+	ALN_REP_MATE2     // unpaired alignment for mate 2
+};
+
 /**
  * Metrics summarizing the work done by the reporter and summarizing
  * the number of reads that align, that fail to align, and that align
@@ -47,11 +55,14 @@ enum {
 struct ReportingMetrics {
 
 	ReportingMetrics():mutex_m() {
+	    LOCK_SITE(mutex_m, "ReportingMetrics");
 	    reset();
 	}
 
 	void reset() {
 		init(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+		ndup_lookup = ndup_hit = 0;
+		nbudget = 0;
 	}
 
 	void init(
@@ -160,6 +171,10 @@ struct ReportingMetrics {
 		sum_best1     += met.sum_best1;
 		sum_best2     += met.sum_best2;
 		sum_best      += met.sum_best;
+
+		ndup_lookup   += met.ndup_lookup;
+		ndup_hit      += met.ndup_hit;
+		nbudget       += met.nbudget;
 	}
 
 	uint64_t  nread;         // # reads
@@ -204,6 +219,10 @@ struct ReportingMetrics {
 	uint64_t  sum_best2;     // Sum of all the second-best alignment scores
 	uint64_t  sum_best;      // Sum of all the best and second-best
 
+	uint64_t  ndup_lookup;   // # reads/pairs looked up in the duplicate cache
+	uint64_t  ndup_hit;      // # of those answered from the cache
+	uint64_t  nbudget;       // # reads/pairs stopped at the per-read work budget
+
 	MUTEX_T mutex_m;
 };
 
@@ -615,7 +634,8 @@ public:
     refnames_(refnames),
     quiet_(quiet),
     altdb_(altdb),
-    spliceSiteDB_(ssdb)
+    spliceSiteDB_(ssdb),
+    readDump_(NULL)
 	{ }
 
 	/**
@@ -875,6 +895,15 @@ public:
 		met_.merge(met, getLock);
 	}
 
+	/**
+	 * Copy the global reporting metrics into 'met'.  Synchronized.
+	 */
+	void snapshotMetrics(ReportingMetrics& met) {
+		ThreadSafe ts(&met_.mutex_m);
+		met.reset();
+		met.merge(met_, false);
+	}
+
 	/**
 	 * Return mutable reference to the shared OutputQueue.
 	 */
@@ -882,6 +911,21 @@ public:
 		return oq_;
 	}
 
+	/**
+	 * Set the files that --un/--al/--un-conc/--al-conc reads go to.  Must
+	 * be called before any AlnSinkWrap is constructed.
+	 */
+	void setReadDump(ReadDump* dump) {
+		readDump_ = dump;
+	}
+
+	/**
+	 * Return the read dump files, or NULL if there are none.
+	 */
+	ReadDump* readDump() {
+		return readDump_;
+	}
+
 protected:
 
 	OutputQueue&       oq_;           // output queue
@@ -891,6 +935,7 @@ protected:
 	ReportingMetrics   met_;          // global repository of reporting metrics
     ALTDB<index_t>*    altdb_;
     SpliceSiteDB*      spliceSiteDB_; //
+    ReadDump*          readDump_;     // --un/--al/--un-conc/--al-conc files
 };
 
 /**
@@ -992,7 +1037,8 @@ public:
                 size_t threadId,           // Thread ID
                 bool secondary = false,    // Secondary alignments
                 const SpliceSiteDB* ssdb = NULL, // splice sites
-                uint64_t threads_rids_mindist = 0) : // synchronization
+                uint64_t threads_rids_mindist = 0, // synchronization
+                uint64_t ss_epoch = 0) :
 		g_(g),
 		rp_(rp),
         threadid_(threadId),
@@ -1000,6 +1046,7 @@ public:
     	secondary_(secondary),
         ssdb_(ssdb),
         threads_rids_mindist_(threads_rids_mindist),
+        ss_epoch_(ss_epoch),
 		init_(false),   
 		maxed1_(false),       // read is pair and we maxed out mate 1 unp alns
 		maxed2_(false),       // read is pair and we maxed out mate 2 unp alns
@@ -1025,11 +1072,19 @@ public:
 		rs2u_(),       // mate 2 unpaired alignments
 		select1_(),    // for selecting random subsets for mate 1
 		select2_(),    // for selecting random subsets for mate 2
-		st_(rp)        // reporting state - what's left to do?
+		st_(rp),       // reporting state - what's left to do?
+		dumpbuf_(g.readDump()), // reads to write to --un/--al files
+		stageMet_(NULL)
 	{
 		assert(rp_.repOk());
 	}
 
+	/**
+	 * Set where the time spent handing records to the output queue is
+	 * charged to.  NULL (the default) disables the accounting.
+	 */
+	void setStageMetrics(StageMetrics* met) { stageMet_ = met; }
+
 	/**
 	 * Initialize the wrapper with a new read pair and return an
 	 * integer >= -1 indicating which stage the aligner should start
@@ -1150,6 +1205,18 @@ public:
     
     const ReportingParams& reportingParams() { return rp_;}
 	
+	/**
+	 * Return the kind of each alignment reported for the current read, in
+	 * the order report() was called: ALN_REP_PAIR for a concordant pair
+	 * (taken in turn from rs1()/rs2()), ALN_REP_MATE1 or ALN_REP_MATE2 for
+	 * an unpaired alignment (from rs1u() or rs2u()).
+	 */
+	const EList<uint8_t>& repOrder() const { return repOrder_; }
+	const EList<AlnRes>& rs1()  const { return rs1_;  }
+	const EList<AlnRes>& rs2()  const { return rs2_;  }
+	const EList<AlnRes>& rs1u() const { return rs1u_; }
+	const EList<AlnRes>& rs2u() const { return rs2u_; }
+	
 	/**
 	 * Return true iff we're in -M mode.
 	 */
@@ -1319,6 +1386,7 @@ protected:
     bool              secondary_; // allow for secondary alignments
     const SpliceSiteDB* ssdb_; // splice sites
     uint64_t threads_rids_mindist_; // synchronization
+    uint64_t ss_epoch_; // reads per splice site epoch; 0 = none
 	bool              init_;  // whether we're initialized w/ read pair
 	bool              maxed1_; // true iff # unpaired mate-1 alns reported so far exceeded -m/-M
 	bool              maxed2_; // true iff # unpaired mate-2 alns reported so far exceeded -m/-M
@@ -1344,6 +1412,7 @@ protected:
 	EList<AlnRes>     rs2u_;  // unpaired alignments for mate #2
 	EList<size_t>     select1_; // parallel to rs1_/rs2_ - which to report
 	EList<size_t>     select2_; // parallel to rs1_/rs2_ - which to report
+	EList<uint8_t>    repOrder_; // kinds of alignments in the order reported
 	ReportingState    st_;      // reporting state - what's left to do?
 	
 	EList<std::pair<TAlScore, size_t> > selectBuf_;
@@ -1351,6 +1420,8 @@ protected:
 	StackedAln staln_;
     
     EList<SpliceSite> spliceSites_;
+	ReadDumpBuf       dumpbuf_; // this thread's --un/--al/--un-conc/--al-conc reads
+	StageMetrics*     stageMet_; // per-stage tick accounting, or NULL
 };
 
 /**
@@ -1523,6 +1594,12 @@ void AlnSink<index_t>::printAlSumm(
             out << "\t\tAligned >1 times: " << met.nunp_uni2 << " ("; printPct(out, met.nunp_uni2, met.nunpaired); out << ")" << endl;
         }
         out << "\tOverall alignment rate: "; printPct(out, tot_al, tot_al_cand); out << endl;
+        if(met.ndup_lookup > 0) {
+            out << "\tDuplicate cache hits: " << met.ndup_hit << " ("; printPct(out, met.ndup_hit, met.ndup_lookup); out << ")" << endl;
+        }
+        if(met.nbudget > 0) {
+            out << "\tStopped at work budget: " << met.nbudget << " ("; printPct(out, met.nbudget, met.nread); out << ")" << endl;
+        }
         
     } else {
         if(totread > 0) {
@@ -1658,6 +1735,16 @@ void AlnSink<index_t>::printAlSumm(
         
         printPct(out, tot_al, tot_al_cand);
         out << " overall alignment rate" << endl;
+        if(met.ndup_lookup > 0) {
+            out << met.ndup_hit << " (";
+            printPct(out, met.ndup_hit, met.ndup_lookup);
+            out << ") reads/pairs were exact duplicates answered from the duplicate cache" << endl;
+        }
+        if(met.nbudget > 0) {
+            out << met.nbudget << " (";
+            printPct(out, met.nbudget, met.nread);
+            out << ") reads/pairs were stopped at the per-read work budget" << endl;
+        }
     }
 }
 
@@ -1749,6 +1836,7 @@ int AlnSinkWrap<index_t>::nextRead(
 	rs2_.clear();     // clear out paired-end alignments
 	rs1u_.clear();    // clear out unpaired alignments for mate #1
 	rs2u_.clear();    // clear out unpaired alignments for mate #2
+	repOrder_.clear();
 	st_.nextRead(readIsPair()); // reset state
 	assert(empty());
 	assert(!maxed());
@@ -1803,7 +1891,9 @@ void AlnSinkWrap<index_t>::finishRead(
                                       bool templateLenAdjustment)      // = true
 {
 	obuf_.clear();
-	OutputQueueMark qqm(g_.outq(), obuf_, rdid_, threadid_);
+	OutputQueueMark qqm(
+		g_.outq(), obuf_, rdid_, threadid_, stageMet_,
+		dumpbuf_.active() ? &dumpbuf_.rec() : NULL);
 	assert(init_);
 	if(!suppressSeedSummary) {
 		if(sr1 != NULL) {
@@ -1851,6 +1941,20 @@ void AlnSinkWrap<index_t>::finishRead(
 		} else {
 			met.nunpaired++;
 		}
+		// Write the read to the --un/--al/--un-conc/--al-conc files
+		if(dumpbuf_.active()) {
+			if(readIsPair()) {
+				dumpbuf_.dumpPair(
+					*rd1_,
+					*rd2_,
+					nconcord > 0,
+					nconcord > 0 || ndiscord > 0 || nunpair1 > 0 || nunpair2 > 0);
+			} else if(rd1_ != NULL) {
+				dumpbuf_.dumpUnpaired(*rd1_, nunpair1 > 0);
+			} else {
+				dumpbuf_.dumpUnpaired(*rd2_, nunpair2 > 0);
+			}
+		}
 		// Report concordant paired-end alignments if possible
 		if(nconcord > 0) {
             AlnSetSumm concordSumm(
@@ -1909,8 +2013,8 @@ void AlnSinkWrap<index_t>::finishRead(
 			for(size_t i = 0; i < rs1_.size(); i++) {
                 spliceSites_.clear();
                 if(templateLenAdjustment) {
-                    rs1_[i].setMateParams(ALN_RES_TYPE_MATE1, &rs2_[i], flags1, ssdb_, threads_rids_mindist_, &spliceSites_);
-                    rs2_[i].setMateParams(ALN_RES_TYPE_MATE2, &rs1_[i], flags2, ssdb_, threads_rids_mindist_, &spliceSites_);
+                    rs1_[i].setMateParams(ALN_RES_TYPE_MATE1, &rs2_[i], flags1, ssdb_, threads_rids_mindist_, ss_epoch_, &spliceSites_);
+                    rs2_[i].setMateParams(ALN_RES_TYPE_MATE2, &rs1_[i], flags2, ssdb_, threads_rids_mindist_, ss_epoch_, &spliceSites_);
                 } else {
                     rs1_[i].setMateParams(ALN_RES_TYPE_MATE1, &rs2_[i], flags1);
                     rs2_[i].setMateParams(ALN_RES_TYPE_MATE2, &rs1_[i], flags2);
@@ -2421,12 +2525,15 @@ bool AlnSinkWrap<index_t>::report(
 		st_.foundConcordant();
 		rs1_.push_back(*rs1);
 		rs2_.push_back(*rs2);
+		repOrder_.push_back(ALN_REP_PAIR);
 	} else {
         st_.foundUnpaired(one);
 		if(one) {
 			rs1u_.push_back(*rs1);
+			repOrder_.push_back(ALN_REP_MATE1);
   		} else {
 			rs2u_.push_back(*rs2);
+			repOrder_.push_back(ALN_REP_MATE2);
 		}
 	}
 	// Tally overall alignment score
@@ -2627,8 +2734,7 @@ if(firstfield) firstfield = false; \
 else o.append('\t'); \
 }
 #define WRITE_NUM(o, x) { \
-itoa10(x, buf); \
-o.append(buf); \
+o.append(buf, itoa10(x, buf) - buf); \
 }
 
 /**
@@ -2891,8 +2997,7 @@ void AlnSinkSam<index_t>::appendMate(
 		// Failed to align
 		fl |= SAM_FLAG_UNMAPPED;
 	}
-	itoa10<int>(fl, buf);
-	o.append(buf);
+	o.append(buf, itoa10<int>(fl, buf) - buf);
 	o.append('\t');
 	// RNAME
 	if(rs != NULL) {
@@ -2914,16 +3019,14 @@ void AlnSinkSam<index_t>::appendMate(
 	// Note: POS is *after* soft clipping.  I.e. POS points to the
 	// upstream-most character *involved in the clipped alignment*.
 	if(rs != NULL) {
-		itoa10<int64_t>(rs->refoff()+1+offAdj, buf);
-		o.append(buf);
+		o.append(buf, itoa10<int64_t>(rs->refoff()+1+offAdj, buf) - buf);
 		o.append('\t');
 	} else {
 		if(summ.orefid() != -1) {
 			// Opposite mate aligned but this one didn't - print the opposite
 			// mate's RNAME and POS as is customary
 			assert(flags.partOfPair());
-			itoa10<int64_t>(summ.orefoff()+1+offAdj, buf);
-			o.append(buf);
+			o.append(buf, itoa10<int64_t>(summ.orefoff()+1+offAdj, buf) - buf);
 		} else {
 			// No alignment
 			o.append('0');
@@ -2969,29 +3072,25 @@ void AlnSinkSam<index_t>::appendMate(
 	// PNEXT
 	if(rs != NULL && flags.partOfPair()) {
 		if(rso != NULL) {
-			itoa10<int64_t>(rso->refoff()+1, buf);
-			o.append(buf);
+			o.append(buf, itoa10<int64_t>(rso->refoff()+1, buf) - buf);
 			o.append('\t');
 		} else {
 			// The convenstion is that if this mate aligns but the opposite
 			// doesn't, we print this mate's offset here
-			itoa10<int64_t>(rs->refoff()+1, buf);
-			o.append(buf);
+			o.append(buf, itoa10<int64_t>(rs->refoff()+1, buf) - buf);
 			o.append('\t');
 		}
 	} else if(summ.orefid() != -1) {
 		// The convention if this mate fails to align but the other doesn't is
 		// to copy the mate's details into here
-		itoa10<int64_t>(summ.orefoff()+1, buf);
-		o.append(buf);
+		o.append(buf, itoa10<int64_t>(summ.orefoff()+1, buf) - buf);
 		o.append('\t');
 	} else {
 		o.append("0\t");
 	}
 	// ISIZE
 	if(rs != NULL && rs->isFraglenSet()) {
-		itoa10<int64_t>(rs->fragmentLength(), buf);
-		o.append(buf);
+		o.append(buf, itoa10<int64_t>(rs->fragmentLength(), buf) - buf);
 		o.append('\t');
 	} else {
 		// No fragment
@@ -3005,11 +3104,8 @@ void AlnSinkSam<index_t>::appendMate(
 		if(rd.patFw.length() == 0) {
 			o.append('*');
 		} else {
-			if(rs == NULL || rs->fw()) {
-				o.append(rd.patFw.toZBuf());
-			} else {
-				o.append(rd.patRc.toZBuf());
-			}
+			const BTDnaString& seq = (rs == NULL || rs->fw()) ? rd.patFw : rd.patRc;
+			o.appendXForm(seq.buf(), seq.length(), "ACGTN");
 		}
 	}
 	o.append('\t');
@@ -3022,9 +3118,10 @@ void AlnSinkSam<index_t>::appendMate(
 			o.append('*');
 		} else {
 			if(rs == NULL || rs->fw()) {
-				o.append(rd.qual.toZBuf());
+				o.append(rd.qual.buf(), rd.qual.length());
 			} else {
-				o.append(rd.qualRev.toZBuf());
+				// Write reversed quals straight into the record
+				o.appendReverse(rd.qual.buf(), rd.qual.length());
 			}
 		}
 	}
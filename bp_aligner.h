@@ -300,7 +300,7 @@ void BP_Aligner<index_t, local_index_t>::hybridSearch_recur(
             ssdb.getLeftSpliceSites(hit.ref(), left + minMatchLen, minMatchLen * 2, spliceSites);
             for(size_t si = 0; si < spliceSites.size(); si++) {
                 const SpliceSite& ss = spliceSites[si];
-                if(!ss._fromfile && ss._readid + this->_thread_rids_mindist > rd.rdid) continue;
+                if(!ss._fromfile && ss._readid >= this->novelSpliceSiteBound(rd.rdid)) continue;
                 if(left + fraglen - 1 < ss.right()) continue;
                 index_t frag2off = ss.left() -  (ss.right() - left);
                 if(frag2off + 1 < hitoff) continue;
@@ -771,7 +771,7 @@ void BP_Aligner<index_t, local_index_t>::hybridSearch_recur(
             ssdb.getRightSpliceSites(hit.ref(), right + fraglen - minMatchLen, minMatchLen * 2, spliceSites);
             for(size_t si = 0; si < spliceSites.size(); si++) {
                 const SpliceSite& ss = spliceSites[si];
-                if(!ss._fromfile && ss._readid + this->_thread_rids_mindist > rd.rdid) continue;
+                if(!ss._fromfile && ss._readid >= this->novelSpliceSiteBound(rd.rdid)) continue;
                 if(right > ss.left()) continue;
                 index_t frag2off = ss.right() - ss.left() + right + fraglen - 1;
                 GenomeHit<index_t> tempHit;
@@ -0,0 +1,239 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUILD_MEM_H_
+#define BUILD_MEM_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+#include "hier_idx_common.h"
+
+using namespace std;
+
+/**
+ * Parse a memory size such as "4096", "512M" or "16G" (K, M, G and T
+ * suffixes, case-insensitive, powers of 1024).  Returns 0 if the string
+ * is not a valid size.
+ */
+static inline uint64_t parseMemSize(const char *str) {
+	char *endPtr = NULL;
+	double v = strtod(str, &endPtr);
+	if(endPtr == str || v <= 0) return 0;
+	uint64_t mult = 1;
+	switch(*endPtr) {
+		case 'k': case 'K': mult = 1ULL << 10; endPtr++; break;
+		case 'm': case 'M': mult = 1ULL << 20; endPtr++; break;
+		case 'g': case 'G': mult = 1ULL << 30; endPtr++; break;
+		case 't': case 'T': mult = 1ULL << 40; endPtr++; break;
+		default: break;
+	}
+	if(*endPtr == 'b' || *endPtr == 'B') endPtr++;
+	if(*endPtr != '\0') return 0;
+	return (uint64_t)(v * mult);
+}
+
+/**
+ * Return the peak resident set size of this process so far in bytes, or
+ * 0 if the platform does not report it.
+ */
+static inline uint64_t peakRss() {
+#if !defined(_WIN32)
+	struct rusage ru;
+	if(getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#if defined(__APPLE__)
+	return (uint64_t)ru.ru_maxrss;        // bytes
+#else
+	return (uint64_t)ru.ru_maxrss << 10;  // kilobytes
+#endif
+#else
+	return 0;
+#endif
+}
+
+/**
+ * Pessimistic model of hisat2-build's memory footprint.  Each phase
+ * method returns the bytes expected to be live at the peak of that phase,
+ * including whatever earlier phases leave behind (the joined reference
+ * string lives until the very end), so the figures are directly
+ * comparable with the process's peak RSS.
+ *
+ * The constants were fit against builds of the example data and of
+ * synthetic references; they are meant for choosing parameters, not for
+ * exact accounting.
+ */
+struct BuildMemModel {
+
+	BuildMemModel() { reset(); }
+
+	void reset() {
+		jlen = 0;
+		maxSeqLen = 0;
+		nalts = 0;
+		graph = false;
+		nthreads = 1;
+		bmaxDivN = 4;
+		dcv = 1024;
+		ftabChars = 10;
+		indexSz = 4;
+	}
+
+	/// Fixed cost: executable, ftab, stream buffers and other small tables.
+	/// Code, static tables and stdio buffers take about 4 MB of RSS before
+	/// any input is read; 16 MB leaves room for allocator overhead.
+	/// buildToDisk() fills an ftab of twice 4^ftabChars + 1 entries (low
+	/// and high bounds) before writing it out.
+	uint64_t base() const {
+		return (16ULL << 20) + ((1ULL << (2 * ftabChars)) + 1) * indexSz * 2;
+	}
+
+	/// Joined reference string plus the parsed ALTs and their names; these
+	/// stay live through every later phase.  The joined string takes one
+	/// byte per base.  An ALT<index_t> is about 6 index_t words and its
+	/// name a std::string of 8 words (plus a heap copy for names longer
+	/// than 15 characters), and sorting the ALTs with several threads
+	/// keeps a second copy of them: 24 words per ALT in all.
+	uint64_t text() const {
+		return base() + jlen + nalts * 24 * indexSz;
+	}
+
+	/// Joining; with several threads the FASTA file is read in blocks of
+	/// 16 MB per thread, or twice the longest sequence, since a block
+	/// holds whole records and doubles until the longest one fits (line
+	/// breaks add about 2%).  --snp files are read in blocks of 4 MB per
+	/// thread, after the FASTA blocks are freed.
+	uint64_t join() const {
+		if(nthreads <= 1) return text();
+		uint64_t fastaBlock = max((uint64_t)nthreads << 24, 2 * (maxSeqLen + maxSeqLen / 50));
+		return text() + max(fastaBlock, (uint64_t)nthreads << 22);
+	}
+
+	/// Number of elements in the difference-cover sample
+	uint64_t dcSampleLen() const {
+		if(dcv == 0) return 0;
+		return (jlen / dcv + 1) * (uint64_t)(sqrt(1.5 * dcv) + 6);
+	}
+
+	/// Difference-cover construction: sPrime, sPrimeOrder and isaPrime
+	uint64_t dcSample() const {
+		return text() + dcSampleLen() * 3 * indexSz;
+	}
+
+	/// Size of the in-memory GFM image assembled by buildToDisk().  A graph
+	/// GBWT has about one row per base plus three per ALT (the alternative
+	/// path and the nodes it splits), each taking 4 bits; with the default
+	/// 128-byte sides, 24 bytes of which hold occurrence counts, that is
+	/// 0.5 * 128 / 104 ~= 0.6 bytes per row.  A linear GBWT takes 2 bits per
+	/// row in 64-byte sides with 16 bytes of counts: 0.25 * 64 / 48 = 1/3.
+	uint64_t gfmImage() const {
+		if(graph) return (jlen + 3 * nalts) * 6 / 10;
+		return jlen / 3;
+	}
+
+	/// Blockwise suffix sorting: one bucket per thread (its suffix offsets
+	/// and the copy made while sorting them, plus a flat 8 MB for sort
+	/// recursion stacks and bucket bookkeeping, the most seen in our
+	/// builds), the retained isaPrime, the bucket boundaries and the GFM
+	/// image being filled in
+	uint64_t blockwise() const {
+		uint64_t bmax = jlen / (bmaxDivN == 0 ? 1 : bmaxDivN) + 1;
+		return text() + dcSampleLen() * indexSz
+		       + (uint64_t)nthreads * (bmax * indexSz * 2 + (8ULL << 20))
+		       + (jlen / bmax + 1) * indexSz
+		       + gfmImage();
+	}
+
+	/// RefGraph nodes and edges, with room for the temporary copies made
+	/// while sorting and reverse-determinizing.  A Node (label and value)
+	/// and an Edge (from and to) take 2 words each, there are about as many
+	/// of each as GBWT rows, and the radix sort of the edges writes a 2-word
+	/// copy; one more word covers the composite nodes: 7 words per row.
+	uint64_t refGraph() const {
+		return text() + (jlen + 3 * nalts) * 7 * indexSz;
+	}
+
+	/// PathGraph generations.  A PathNode takes 4 words and a PathEdge 3;
+	/// a generation holds the previous and the new nodes (8 words) and the
+	/// edges with their sorted copy (6 words): 14 words per row.  The
+	/// parallel radix sort writes the new nodes to a separate array, which
+	/// adds 2 more words per row on average over a generation.
+	uint64_t pathGraph() const {
+		return text() + (jlen + 3 * nalts) * (nthreads > 1 ? 16 : 14) * indexSz;
+	}
+
+	/// Local indexes: every thread builds one local index at a time over
+	/// local_index_size bases.  A local linear index goes through the
+	/// blockwise SA builder (about 16 words per base with its buckets and
+	/// difference cover); a local graph index builds a small RefGraph and
+	/// PathGraph first, with the 7 + 14 words per row above and about twice
+	/// as many rows as bases in dense regions: 48 words per base.
+	uint64_t localIndexes() const {
+		return text() + (uint64_t)nthreads * local_index_size * (graph ? 48 : 16) * indexSz;
+	}
+
+	/// Predicted peak over all phases
+	uint64_t peak() const {
+		uint64_t p = max(join(), localIndexes());
+		if(graph) {
+			p = max(p, max(refGraph(), pathGraph()));
+		} else {
+			p = max(p, max(dcSample(), blockwise()));
+		}
+		return p;
+	}
+
+	/// Print the predicted peak of each phase
+	void print(ostream& out) const {
+		out << "  Predicted memory peak per phase (MB):" << endl
+		    << "    joining reference: " << (join() >> 20) << endl;
+		if(graph) {
+			out << "    RefGraph: " << (refGraph() >> 20) << endl
+			    << "    PathGraph: " << (pathGraph() >> 20) << endl;
+		} else {
+			out << "    difference cover: " << (dcSample() >> 20) << endl
+			    << "    blockwise SA: " << (blockwise() >> 20) << endl;
+		}
+		out << "    local indexes: " << (localIndexes() >> 20) << endl;
+	}
+
+	uint64_t jlen;      // length of the joined reference
+	uint64_t maxSeqLen; // length of the longest reference sequence
+	uint64_t nalts;     // number of SNPs, splice sites and exons
+	bool     graph;     // building a graph index (any ALTs)?
+	int      nthreads;  // worker threads
+	uint64_t bmaxDivN;  // bucket size as a divisor of jlen
+	int      dcv;       // difference-cover period
+	int      ftabChars; // chars in the ftab lookup
+	size_t   indexSz;   // sizeof(index_t)
+};
+
+/**
+ * Log the predicted peak of a phase next to the peak RSS observed so far.
+ */
+static inline void logMemPhase(ostream& out, const char *phase, uint64_t predicted) {
+	out << "  Memory after " << phase << ": predicted " << (predicted >> 20)
+	    << " MB, observed peak " << (peakRss() >> 20) << " MB" << endl;
+}
+
+#endif /*BUILD_MEM_H_*/
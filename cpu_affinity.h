@@ -0,0 +1,287 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPU_AFFINITY_H_
+#define CPU_AFFINITY_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sstream>
+#include <iostream>
+#ifdef __linux__
+#include <sched.h>
+#include <dirent.h>
+#endif
+#include "ds.h"
+
+/**
+ * Parse a list of CPUs like "0-3,8,10-11" into 'cpus', in the order
+ * given and without duplicates.  Return false if the list is malformed.
+ */
+static inline bool parseCpuList(const std::string& s, EList<int>& cpus) {
+	cpus.clear();
+	size_t i = 0;
+	while(i < s.length()) {
+		char *end = NULL;
+		long lo = strtol(s.c_str() + i, &end, 10);
+		if(end == s.c_str() + i || lo < 0) return false;
+		i = end - s.c_str();
+		long hi = lo;
+		if(i < s.length() && s[i] == '-') {
+			i++;
+			hi = strtol(s.c_str() + i, &end, 10);
+			if(end == s.c_str() + i || hi < lo) return false;
+			i = end - s.c_str();
+		}
+		for(long c = lo; c <= hi; c++) {
+			bool dup = false;
+			for(size_t j = 0; j < cpus.size(); j++) {
+				if(cpus[j] == (int)c) { dup = true; break; }
+			}
+			if(!dup) cpus.push_back((int)c);
+		}
+		if(i < s.length()) {
+			if(s[i] != ',') return false;
+			i++;
+		}
+	}
+	return !cpus.empty();
+}
+
+/**
+ * Where one CPU sits in the machine, for ordering CPUs so that workers
+ * fill the physical cores of the home NUMA node first.
+ */
+struct CpuTopo {
+
+	bool operator<(const CpuTopo& o) const {
+		if(home != o.home) return home;
+		if(node != o.node) return node < o.node;
+		if(smt != o.smt) return smt < o.smt;
+		if(pkg != o.pkg) return pkg < o.pkg;
+		if(core != o.core) return core < o.core;
+		return cpu < o.cpu;
+	}
+
+	int  cpu;
+	int  node; // NUMA node
+	int  pkg;  // physical package (socket)
+	int  core; // core within the package
+	int  smt;  // 0 for the first hardware thread of a core, 1 for the next, ...
+	bool home; // on the home node
+};
+
+/**
+ * Placement of the aligner's threads on CPUs for --pin and --cpu-list.
+ * Each worker is pinned to one CPU.  The main thread, and with it every
+ * helper thread it starts (index and reference loaders, the status
+ * thread), is confined to the "home" CPUs before the index is loaded, so
+ * that the index is allocated on the home NUMA node, where the first
+ * workers run.
+ *
+ * With an explicit list the workers take the CPUs in the order listed and
+ * the home CPUs are the whole list.  Otherwise the CPUs this process may
+ * run on are ordered by topology: the home node is the NUMA node with the
+ * most of them, and workers get one hardware thread per physical core of
+ * the home node, then the remaining hardware threads of the home node,
+ * then the other nodes in the same way.  Workers beyond the number of
+ * CPUs wrap around.  Only supported on Linux.
+ */
+class CpuPlacement {
+
+public:
+
+	CpuPlacement() : on_(false), order_(MISC_CAT), home_(MISC_CAT) { }
+
+	/**
+	 * Work out the placement.  Return false, having warned, if pinning
+	 * isn't possible here.
+	 */
+	bool init(const std::string& cpuList, bool verbose) {
+		on_ = false;
+		order_.clear();
+		home_.clear();
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if(sched_getaffinity(0, sizeof(set), &set) != 0) {
+			std::cerr << "Warning: could not get the CPU affinity of this process; not pinning threads" << std::endl;
+			return false;
+		}
+		if(!cpuList.empty()) {
+			EList<int> cpus(MISC_CAT);
+			parseCpuList(cpuList, cpus);
+			for(size_t i = 0; i < cpus.size(); i++) {
+				if(cpus[i] < CPU_SETSIZE && CPU_ISSET(cpus[i], &set)) {
+					order_.push_back(cpus[i]);
+				} else {
+					std::cerr << "Warning: CPU " << cpus[i] << " in --cpu-list is not available to this process; skipping it" << std::endl;
+				}
+			}
+			home_ = order_;
+		} else {
+			EList<CpuTopo> topo(MISC_CAT);
+			EList<int> nodeOf(MISC_CAT);
+			readNodes(nodeOf);
+			for(int c = 0; c < CPU_SETSIZE; c++) {
+				if(!CPU_ISSET(c, &set)) continue;
+				topo.expand();
+				CpuTopo& t = topo.back();
+				t.cpu = c;
+				t.node = (c < (int)nodeOf.size() && nodeOf[c] >= 0) ? nodeOf[c] : 0;
+				t.pkg = readCpuInt(c, "physical_package_id", 0);
+				t.core = readCpuInt(c, "core_id", c);
+				t.smt = 0;
+				for(size_t j = 0; j + 1 < topo.size(); j++) {
+					if(topo[j].pkg == t.pkg && topo[j].core == t.core) t.smt++;
+				}
+				t.home = false;
+			}
+			// The home node is the one with the most CPUs available
+			int home = -1;
+			size_t homeCpus = 0;
+			for(size_t i = 0; i < topo.size(); i++) {
+				size_t n = 0;
+				for(size_t j = 0; j < topo.size(); j++) {
+					if(topo[j].node == topo[i].node) n++;
+				}
+				if(n > homeCpus || (n == homeCpus && topo[i].node < home)) {
+					home = topo[i].node;
+					homeCpus = n;
+				}
+			}
+			for(size_t i = 0; i < topo.size(); i++) {
+				topo[i].home = (topo[i].node == home);
+			}
+			topo.sort();
+			for(size_t i = 0; i < topo.size(); i++) {
+				order_.push_back(topo[i].cpu);
+				if(topo[i].home) home_.push_back(topo[i].cpu);
+			}
+		}
+		if(order_.empty()) {
+			std::cerr << "Warning: no CPUs to pin threads to; not pinning threads" << std::endl;
+			return false;
+		}
+		on_ = true;
+		if(verbose) {
+			std::cerr << "Worker CPUs:";
+			for(size_t i = 0; i < order_.size(); i++) std::cerr << ' ' << order_[i];
+			std::cerr << std::endl << "Home CPUs:";
+			for(size_t i = 0; i < home_.size(); i++) std::cerr << ' ' << home_[i];
+			std::cerr << std::endl;
+		}
+		return true;
+#else
+		std::cerr << "Warning: --pin and --cpu-list are only supported on Linux; not pinning threads" << std::endl;
+		return false;
+#endif
+	}
+
+	/**
+	 * Confine the calling thread, and threads it starts from now on, to
+	 * the home CPUs.
+	 */
+	void confineToHome() const {
+		if(on_) setAffinity(home_);
+	}
+
+	/**
+	 * Pin the calling thread to the CPU of worker 'tid' (0-based).
+	 */
+	void pinWorker(size_t tid) const {
+		if(!on_) return;
+		EList<int> cpu(MISC_CAT);
+		cpu.push_back(order_[tid % order_.size()]);
+		setAffinity(cpu);
+	}
+
+	bool on() const { return on_; }
+
+protected:
+
+	static void setAffinity(const EList<int>& cpus) {
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for(size_t i = 0; i < cpus.size(); i++) CPU_SET(cpus[i], &set);
+		if(sched_setaffinity(0, sizeof(set), &set) != 0) {
+			std::cerr << "Warning: could not set the CPU affinity of a thread" << std::endl;
+		}
+#endif
+	}
+
+#ifdef __linux__
+	/**
+	 * Fill 'nodeOf' with the NUMA node of each CPU, -1 where unknown.
+	 */
+	static void readNodes(EList<int>& nodeOf) {
+		nodeOf.resize(CPU_SETSIZE);
+		nodeOf.fill(-1);
+		DIR *dir = opendir("/sys/devices/system/node");
+		if(dir == NULL) return;
+		struct dirent *ent;
+		while((ent = readdir(dir)) != NULL) {
+			int node = -1;
+			if(sscanf(ent->d_name, "node%d", &node) != 1) continue;
+			std::ostringstream fname;
+			fname << "/sys/devices/system/node/" << ent->d_name << "/cpulist";
+			FILE *f = fopen(fname.str().c_str(), "r");
+			if(f == NULL) continue;
+			char buf[4096];
+			if(fgets(buf, sizeof(buf), f) != NULL) {
+				std::string s(buf);
+				while(!s.empty() && (s[s.length()-1] == '\n' || s[s.length()-1] == ' ')) {
+					s.erase(s.length() - 1);
+				}
+				EList<int> cpus(MISC_CAT);
+				if(parseCpuList(s, cpus)) {
+					for(size_t i = 0; i < cpus.size(); i++) {
+						if(cpus[i] < (int)nodeOf.size()) nodeOf[cpus[i]] = node;
+					}
+				}
+			}
+			fclose(f);
+		}
+		closedir(dir);
+	}
+
+	/**
+	 * Read an integer from /sys/devices/system/cpu/cpu<cpu>/topology/<name>,
+	 * or return 'def' if it isn't there.
+	 */
+	static int readCpuInt(int cpu, const char *name, int def) {
+		std::ostringstream fname;
+		fname << "/sys/devices/system/cpu/cpu" << cpu << "/topology/" << name;
+		FILE *f = fopen(fname.str().c_str(), "r");
+		if(f == NULL) return def;
+		int v = def;
+		if(fscanf(f, "%d", &v) != 1) v = def;
+		fclose(f);
+		return v;
+	}
+#endif
+
+	bool       on_;
+	EList<int> order_; // CPU of worker 0, 1, ...
+	EList<int> home_;  // CPUs of the main and helper threads
+};
+
+#endif /*ndef CPU_AFFINITY_H_*/
@@ -21,11 +21,19 @@
 
 extern MemoryTally gMemTally;
 
+// Allocations tallied by the calling thread, for per-read metrics
+static thread_local uint64_t threadAllocs_ = 0;
+static thread_local uint64_t threadAllocBytes_ = 0;
+
 /**
  * Tally a memory allocation of size amt bytes.
  */
 void MemoryTally::add(int cat, uint64_t amt) {
+	threadAllocs_++;
+	threadAllocBytes_ += amt;
 	ThreadSafe ts(&mutex_m);
+	nallocs_++;
+	allocBytes_ += amt;
 	tots_[cat] += amt;
 	tot_ += amt;
 	if(tots_[cat] > peaks_[cat]) {
@@ -46,6 +54,20 @@ void MemoryTally::del(int cat, uint64_t amt) {
 	tots_[cat] -= amt;
 	tot_ -= amt;
 }
+
+/**
+ * Return the number of allocations tallied so far by the calling thread.
+ */
+uint64_t MemoryTally::threadAllocs() {
+	return threadAllocs_;
+}
+
+/**
+ * Return the number of bytes allocated so far by the calling thread.
+ */
+uint64_t MemoryTally::threadAllocBytes() {
+	return threadAllocBytes_;
+}
 	
 #ifdef MAIN_DS
 
@@ -40,7 +40,8 @@ class MemoryTally {
 
 public:
 
-	MemoryTally() : tot_(0), peak_(0) {
+	MemoryTally() : tot_(0), peak_(0), nallocs_(0), allocBytes_(0) {
+		LOCK_SITE(mutex_m, "MemoryTally");
 		memset(tots_,  0, 256 * sizeof(uint64_t));
 		memset(peaks_, 0, 256 * sizeof(uint64_t));
 	}
@@ -77,6 +78,28 @@ public:
 	 */
 	uint64_t peak(int cat) { return peaks_[cat]; }
 
+	/**
+	 * Return the number of allocations tallied so far.
+	 */
+	uint64_t allocs() { return nallocs_; }
+
+	/**
+	 * Return the number of bytes allocated so far, not counting frees.
+	 */
+	uint64_t allocBytes() { return allocBytes_; }
+
+	/**
+	 * Return the number of allocations tallied so far by the calling
+	 * thread.
+	 */
+	static uint64_t threadAllocs();
+
+	/**
+	 * Return the number of bytes allocated so far by the calling thread,
+	 * not counting frees.
+	 */
+	static uint64_t threadAllocBytes();
+
 #ifndef NDEBUG
 	/**
 	 * Check that memory tallies are internally consistent;
@@ -99,6 +122,8 @@ protected:
 	uint64_t tot_;
 	uint64_t peaks_[256];
 	uint64_t peak_;
+	uint64_t nallocs_;    // # allocations
+	uint64_t allocBytes_; // bytes allocated
 };
 
 extern MemoryTally gMemTally;
@@ -114,7 +139,7 @@ public:
 	AutoArray(size_t sz, int cat = 0) : cat_(cat) {
 		t_ = NULL;
 		t_ = new T[sz];
-		gMemTally.add(cat_, sz);
+		gMemTally.add(cat_, sizeof(T) * sz);
 		memset(t_, 0, sz * sizeof(T));
 		sz_ = sz;
 	}
@@ -122,7 +147,7 @@ public:
 	~AutoArray() {
 		if(t_ != NULL) {
 			delete[] t_;
-			gMemTally.del(cat_, sz_);
+			gMemTally.del(cat_, sizeof(T) * sz_);
 		}
 	}
 	
@@ -954,7 +979,7 @@ private:
 	T *alloc(size_t sz) {
 		T* tmp = new T[sz];
 		assert(tmp != NULL);
-		gMemTally.add(cat_, sz);
+		gMemTally.add(cat_, sizeof(T) * sz);
 		allocCat_ = cat_;
 		return tmp;
 	}
@@ -968,7 +993,7 @@ private:
 			assert_neq(-1, allocCat_);
 			assert_eq(allocCat_, cat_);
 			delete[] list_;
-			gMemTally.del(cat_, sz_);
+			gMemTally.del(cat_, sizeof(T) * sz_);
 			list_ = NULL;
 			sz_ = cur_ = 0;
 		}
@@ -1313,7 +1338,7 @@ protected:
 	EList<T, S1> *alloc(size_t sz) {
 		assert_gt(sz, 0);
 		EList<T, S1> *tmp = new EList<T, S1>[sz];
-		gMemTally.add(cat_, sz);
+		gMemTally.add(cat_, sizeof(EList<T, S1>) * sz);
 		if(cat_ != 0) {
 			for(size_t i = 0; i < sz; i++) {
 				assert(tmp[i].ptr() == NULL);
@@ -1330,7 +1355,7 @@ protected:
 	void free() {
 		if(list_ != NULL) {
 			delete[] list_;
-			gMemTally.del(cat_, sz_);
+			gMemTally.del(cat_, sizeof(EList<T, S1>) * sz_);
 			list_ = NULL;
 		}
 	}
@@ -1649,7 +1674,7 @@ protected:
 	ELList<T, S1, S2> *alloc(size_t sz) {
 		assert_gt(sz, 0);
 		ELList<T, S1, S2> *tmp = new ELList<T, S1, S2>[sz];
-		gMemTally.add(cat_, sz);
+		gMemTally.add(cat_, sizeof(ELList<T, S1, S2>) * sz);
 		if(cat_ != 0) {
 			for(size_t i = 0; i < sz; i++) {
 				assert(tmp[i].ptr() == NULL);
@@ -1666,7 +1691,7 @@ protected:
 	void free() {
 		if(list_ != NULL) {
 			delete[] list_;
-			gMemTally.del(cat_, sz_);
+			gMemTally.del(cat_, sizeof(ELList<T, S1, S2>) * sz_);
 			list_ = NULL;
 		}
 	}
@@ -1937,7 +1962,7 @@ private:
 	T *alloc(size_t sz) {
 		assert_gt(sz, 0);
 		T *tmp = new T[sz];
-		gMemTally.add(cat_, sz);
+		gMemTally.add(cat_, sizeof(T) * sz);
 		return tmp;
 	}
 
@@ -1948,7 +1973,7 @@ private:
 	void free() {
 		if(list_ != NULL) {
 			delete[] list_;
-			gMemTally.del(cat_, sz_);
+			gMemTally.del(cat_, sizeof(T) * sz_);
 			list_ = NULL;
 		}
 	}
@@ -2329,7 +2354,7 @@ protected:
 	ESet<T> *alloc(size_t sz) {
 		assert_gt(sz, 0);
 		ESet<T> *tmp = new ESet<T>[sz];
-		gMemTally.add(cat_, sz);
+		gMemTally.add(cat_, sizeof(ESet<T>) * sz);
 		if(cat_ != 0) {
 			for(size_t i = 0; i < sz; i++) {
 				assert(tmp[i].ptr() == NULL);
@@ -2346,7 +2371,7 @@ protected:
 	void free() {
 		if(list_ != NULL) {
 			delete[] list_;
-			gMemTally.del(cat_, sz_);
+			gMemTally.del(cat_, sizeof(ESet<T>) * sz_);
 			list_ = NULL;
 		}
 	}
@@ -2596,7 +2621,7 @@ private:
 	std::pair<K, V> *alloc(size_t sz) {
 		assert_gt(sz, 0);
 		std::pair<K, V> *tmp = new std::pair<K, V>[sz];
-		gMemTally.add(cat_, sz);
+		gMemTally.add(cat_, sizeof(std::pair<K, V>) * sz);
 		return tmp;
 	}
 
@@ -2607,7 +2632,7 @@ private:
 	void free() {
 		if(list_ != NULL) {
 			delete[] list_;
-			gMemTally.del(cat_, sz_);
+			gMemTally.del(cat_, sizeof(std::pair<K, V>) * sz_);
 			list_ = NULL;
 		}
 	}
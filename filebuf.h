@@ -27,6 +27,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdexcept>
+#include <algorithm>
 #include "assert_helpers.h"
 
 /**
@@ -78,11 +79,22 @@ public:
 		assert(_ins != NULL);
 	}
 
+	/**
+	 * Read from a block of memory that outlives this FileBuf, e.g. a
+	 * chunk of a file that was already read in by getBlock().
+	 */
+	FileBuf(const char *mem, size_t memLen) {
+		init();
+		_mem = mem;
+		_memLen = memLen;
+		assert(_mem != NULL);
+	}
+
 	/**
 	 * Return true iff there is a stream ready to read.
 	 */
 	bool isOpen() {
-		return _in != NULL || _inf != NULL || _ins != NULL;
+		return _in != NULL || _inf != NULL || _ins != NULL || _mem != NULL;
 	}
 
 	/**
@@ -102,7 +114,7 @@ public:
 	 * Get the next character of input and advance.
 	 */
 	int get() {
-		assert(_in != NULL || _inf != NULL || _ins != NULL);
+		assert(isOpen());
 		int c = peek();
 		if(c != -1) {
 			_cur++;
@@ -125,6 +137,7 @@ public:
 		_in = in;
 		_inf = NULL;
 		_ins = NULL;
+		_mem = NULL;
 		_cur = BUF_SZ;
 		_buf_sz = BUF_SZ;
 		_done = false;
@@ -137,6 +150,7 @@ public:
 		_in = NULL;
 		_inf = __inf;
 		_ins = NULL;
+		_mem = NULL;
 		_cur = BUF_SZ;
 		_buf_sz = BUF_SZ;
 		_done = false;
@@ -149,6 +163,7 @@ public:
 		_in = NULL;
 		_inf = NULL;
 		_ins = __ins;
+		_mem = NULL;
 		_cur = BUF_SZ;
 		_buf_sz = BUF_SZ;
 		_done = false;
@@ -165,6 +180,8 @@ public:
 		} else if(_ins != NULL) {
 			_ins->clear();
 			_ins->seekg(0, std::ios::beg);
+		} else if(_mem != NULL) {
+			_memOff = 0;
 		} else {
 			rewind(_in);
 		}
@@ -179,7 +196,7 @@ public:
 	 * Occasionally we'll need to read in a new buffer's worth of data.
 	 */
 	int peek() {
-		assert(_in != NULL || _inf != NULL || _ins != NULL);
+		assert(isOpen());
 		assert_leq(_cur, _buf_sz);
 		if(_cur == _buf_sz) {
 			if(_done) {
@@ -195,6 +212,11 @@ public:
 				} else if(_ins != NULL) {
 					_ins->read((char*)_buf, BUF_SZ);
 					_buf_sz = _ins->gcount();
+				} else if(_mem != NULL) {
+					_buf_sz = _memLen - _memOff;
+					if(_buf_sz > BUF_SZ) _buf_sz = BUF_SZ;
+					memcpy(_buf, _mem + _memOff, _buf_sz);
+					_memOff += _buf_sz;
 				} else {
 					assert(_in != NULL);
 					_buf_sz = fread(_buf, 1, BUF_SZ, _in);
@@ -259,6 +281,25 @@ public:
 		return len;
 	}
 
+	/**
+	 * Copy up to 'len' characters of input into 'buf' and advance past
+	 * them.  Unlike get(char*, size_t), characters are copied a buffer
+	 * at a time and are not recorded in the last-N buffer.  Returns the
+	 * number of characters copied, which is less than 'len' only at
+	 * end of input.
+	 */
+	size_t getBlock(char *buf, size_t len) {
+		size_t stored = 0;
+		while(stored < len) {
+			if(peek() == -1) break;
+			size_t n = std::min(len - stored, _buf_sz - _cur);
+			memcpy(buf + stored, _buf + _cur, n);
+			_cur += n;
+			stored += n;
+		}
+		return stored;
+	}
+
 	static const size_t LASTN_BUF_SZ = 8 * 1024;
 
 	/**
@@ -432,6 +473,8 @@ private:
 		_in = NULL;
 		_inf = NULL;
 		_ins = NULL;
+		_mem = NULL;
+		_memLen = _memOff = 0;
 		_cur = _buf_sz = BUF_SZ;
 		_done = false;
 		_lastn_cur = 0;
@@ -442,6 +485,9 @@ private:
 	FILE     *_in;
 	std::ifstream *_inf;
 	std::istream  *_ins;
+	const char    *_mem;
+	size_t    _memLen;
+	size_t    _memOff;
 	size_t    _cur;
 	size_t    _buf_sz;
 	bool      _done;
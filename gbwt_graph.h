@@ -118,19 +118,27 @@ public:
         }
     };
 
+    static index_t EdgeFrom (Edge& a) {
+        return a.from;
+    }
+
     static index_t EdgeTo (Edge& a) {
         return a.to;
     }
 
+    // Both orders break ties on the other node so that the radix and
+    // comparison sorts below produce the same list for any thread count
     struct EdgeFromCmp {
         bool operator() (const Edge& a, const Edge& b) const {
-            return a.from < b.from;
+            if(a.from != b.from) return a.from < b.from;
+            return a.to < b.to;
         }
     };
 
     struct EdgeToCmp {
         bool operator() (const Edge& a, const Edge& b) const {
-            return a.to < b.to;
+            if(a.to != b.to) return a.to < b.to;
+            return a.from < b.from;
         };
     };
 
@@ -187,14 +195,34 @@ public:
     }
 
 private:
-    static bool isReverseDeterministic(EList<Node>& nodes, EList<Edge>& edges);
-    static void reverseDeterminize(EList<Node>& nodes, EList<Edge>& edges, index_t& lastNode, index_t lastNode_add = 0);
-
-    static void sortEdgesFrom(EList<Edge>& edges) {
-        std::sort(edges.begin(), edges.end(), EdgeFromCmp());
+    static bool isReverseDeterministic(EList<Node>& nodes, EList<Edge>& edges, int nthreads = 1);
+    static void reverseDeterminize(EList<Node>& nodes, EList<Edge>& edges, index_t& lastNode, index_t lastNode_add = 0, int nthreads = 1);
+
+    // Edge lists of the whole genome graph are sorted with the parallel radix sort,
+    // while small lists (e.g. those of a fragment built by one thread) use std::sort.
+    // Only the sorts run in parallel; the whole-graph pass itself is not split by
+    // connected component.
+    static const index_t radix_sort_min_edges = (1 << 20);
+
+    static void sortEdgesFrom(EList<Edge>& edges, index_t num_nodes = 0, int nthreads = 1) {
+        if(nthreads > 1 && num_nodes > 0 && edges.size() >= radix_sort_min_edges) {
+            EList<Edge> temp_edges; temp_edges.resizeExact(edges.size());
+            radix_sort_copy<Edge, EdgeFromCmp, index_t>(edges.begin(), edges.end(), temp_edges.ptr(),
+                                                       &EdgeFrom, num_nodes, nthreads);
+            edges.xfer(temp_edges);
+        } else {
+            std::sort(edges.begin(), edges.end(), EdgeFromCmp());
+        }
     }
-    static void sortEdgesTo(EList<Edge>& edges) {
-        std::sort(edges.begin(), edges.end(), EdgeToCmp());
+    static void sortEdgesTo(EList<Edge>& edges, index_t num_nodes = 0, int nthreads = 1) {
+        if(nthreads > 1 && num_nodes > 0 && edges.size() >= radix_sort_min_edges) {
+            EList<Edge> temp_edges; temp_edges.resizeExact(edges.size());
+            radix_sort_copy<Edge, EdgeToCmp, index_t>(edges.begin(), edges.end(), temp_edges.ptr(),
+                                                      &EdgeTo, num_nodes, nthreads);
+            edges.xfer(temp_edges);
+        } else {
+            std::sort(edges.begin(), edges.end(), EdgeToCmp());
+        }
     }
 
     // Return edge ranges [begin, end)
@@ -339,10 +367,26 @@ private:
 
         bool operator < (const CompositeEdge& o) const
         {
-            return from < o.from;
+            if(from != o.from) return from < o.from;
+            return to < o.to;
         }
     };
 
+    static index_t CompositeEdgeFrom (CompositeEdge& a) {
+        return a.from;
+    }
+
+    static void sortCompositeEdges(EList<CompositeEdge>& cedges, index_t num_cnodes, int nthreads) {
+        if(nthreads > 1 && cedges.size() >= radix_sort_min_edges) {
+            EList<CompositeEdge> temp_cedges; temp_cedges.resizeExact(cedges.size());
+            radix_sort_copy<CompositeEdge, less<CompositeEdge>, index_t>(cedges.begin(), cedges.end(), temp_cedges.ptr(),
+                                                                         &CompositeEdgeFrom, num_cnodes, nthreads);
+            cedges.xfer(temp_cedges);
+        } else {
+            sort(cedges.begin(), cedges.end());
+        }
+    }
+
     struct TempNodeLabelCmp {
         TempNodeLabelCmp(const EList<Node>& nodes_) : nodes(nodes_) {}
         bool operator() (index_t a, index_t b) const {
@@ -593,12 +637,12 @@ RefGraph<index_t>::RefGraph(const SString<char>& s,
         }
 
         if(multipleHeadNodes) {
-            if(!isReverseDeterministic(nodes, edges)) {
+            if(!isReverseDeterministic(nodes, edges, nthreads)) {
                 if(verbose) cerr << "\tis not reverse-deterministic, so reverse-determinize..." << endl;
-                reverseDeterminize(nodes, edges, lastNode);
+                reverseDeterminize(nodes, edges, lastNode, 0, nthreads);
             }
         }
-        assert(isReverseDeterministic(nodes, edges));
+        assert(isReverseDeterministic(nodes, edges, nthreads));
     } else { // this is memory-consuming, but simple to implement
         index_t num_predicted_nodes = (index_t)(jlen * 1.2);
         nodes.reserveExact(num_predicted_nodes);
@@ -786,10 +830,10 @@ RefGraph<index_t>::RefGraph(const SString<char>& s,
             throw NongraphException();
         }
 
-        if(!isReverseDeterministic(nodes, edges)) {
+        if(!isReverseDeterministic(nodes, edges, nthreads)) {
             if(verbose) cerr << "\tis not reverse-deterministic, so reverse-determinize..." << endl;
-            reverseDeterminize(nodes, edges, lastNode);
-            assert(isReverseDeterministic(nodes, edges));
+            reverseDeterminize(nodes, edges, lastNode, 0, nthreads);
+            assert(isReverseDeterministic(nodes, edges, nthreads));
         }
     }
     
@@ -1268,12 +1312,12 @@ void RefGraph<index_t>::buildGraph_worker(void* vp) {
 }
 
 template <typename index_t>
-bool RefGraph<index_t>::isReverseDeterministic(EList<Node>& nodes, EList<Edge>& edges)
+bool RefGraph<index_t>::isReverseDeterministic(EList<Node>& nodes, EList<Edge>& edges, int nthreads)
 {
     if(edges.size() <= 0) return true;
 
     // Sort edges by "to" nodes
-    sortEdgesTo(edges);
+    sortEdgesTo(edges, (index_t)nodes.size(), nthreads);
 
     index_t curr_to = (index_t)INDEX_MAX;
     EList<bool> seen; seen.resize(5); seen.fillZero();
@@ -1302,7 +1346,7 @@ bool RefGraph<index_t>::isReverseDeterministic(EList<Node>& nodes, EList<Edge>&
 
 
 template <typename index_t>
-void RefGraph<index_t>::reverseDeterminize(EList<Node>& nodes, EList<Edge>& edges, index_t& lastNode, index_t lastNode_add)
+void RefGraph<index_t>::reverseDeterminize(EList<Node>& nodes, EList<Edge>& edges, index_t& lastNode, index_t lastNode_add, int nthreads)
 {
     EList<CompositeNode> cnodes; cnodes.ensure(nodes.size());
     map<CompositeNodeIDs, index_t> cnode_map;
@@ -1319,7 +1363,7 @@ void RefGraph<index_t>::reverseDeterminize(EList<Node>& nodes, EList<Edge>& edge
     cnodes.back().nodes.push_back(lastNode);
     active_cnodes.push_back(0);
     cnode_map[cnodes.back().nodes] = 0;
-    sortEdgesTo(edges);
+    sortEdgesTo(edges, (index_t)nodes.size(), nthreads);
 
     index_t firstNode = 0; // Y -> ... -> Z
     EList<index_t> predecessors;
@@ -1403,7 +1447,7 @@ void RefGraph<index_t>::reverseDeterminize(EList<Node>& nodes, EList<Edge>& edge
         cedges[i].from = cedges[i].to;
         cedges[i].to = tmp;
     }
-    sort(cedges.begin(), cedges.end());
+    sortCompositeEdges(cedges, (index_t)cnodes.size(), nthreads);
     active_cnodes.push_back(0);
     while(!active_cnodes.empty()) {
         index_t cnode_id = active_cnodes.front(); active_cnodes.pop_front();
@@ -1440,7 +1484,7 @@ void RefGraph<index_t>::reverseDeterminize(EList<Node>& nodes, EList<Edge>& edge
     nodes.expand();
     nodes.back() = first_node.getNode();
     active_cnodes.push_back(firstNode);
-    sort(cedges.begin(), cedges.end());
+    sortCompositeEdges(cedges, (index_t)cnodes.size(), nthreads);
     while(!active_cnodes.empty()) {
         index_t cnode_id = active_cnodes.front(); active_cnodes.pop_front();
         assert_lt(cnode_id, cnodes.size());
@@ -1475,7 +1519,7 @@ void RefGraph<index_t>::reverseDeterminize(EList<Node>& nodes, EList<Edge>& edge
         edges.expand();
         edges.back() = edge.getEdge(cnodes);
     }
-    sortEdgesFrom(edges);
+    sortEdgesFrom(edges, (index_t)nodes.size(), nthreads);
 
 #if 0
 #ifndef NDEBUG
@@ -1644,6 +1688,84 @@ public:
         return ret;
     }
 
+    // Position in the GBWT rows equivalent to the state kept by
+    // nextRow(); independent cursors let disjoint row ranges of a sorted
+    // graph be emitted by several threads
+    struct RowCursor {
+        index_t row;
+        index_t node;   // node whose incoming edges include 'row'
+        index_t M_node; // node whose outgoing edges include 'row'
+        index_t M_off;  // offset of 'row' among M_node's outgoing edges
+
+        RowCursor() : row(0), node(0), M_node(0), M_off(0) {}
+    };
+
+    // Position 'cur' at 'row', given the M position of that row
+    // (see advanceM)
+    void initRowCursor(RowCursor& cur, index_t row, index_t M_node, index_t M_off) const {
+        assert_lt(row, edges.size());
+        cur.row = row;
+        index_t lo = 0, hi = (index_t)nodes.size();
+        while(lo < hi) {
+            index_t mid = lo + ((hi - lo) >> 1);
+            if(nodes[mid].key.second <= row) lo = mid + 1;
+            else                             hi = mid;
+        }
+        assert_lt(lo, nodes.size());
+        cur.node = lo;
+        cur.M_node = M_node;
+        cur.M_off = M_off;
+    }
+
+    // Same as nextRow(), but reading from and advancing 'cur'
+    void nextRow(RowCursor& cur, int& gbwtChar, int& F, int& M, index_t& pos) const {
+        assert_lt(cur.row, edges.size());
+        assert_lt(cur.node, nodes.size());
+        gbwtChar = edges[cur.row].label;
+        index_t first_edge = (cur.node == 0 ? 0 : nodes[cur.node - 1].key.second);
+        F = (cur.row == first_edge ? 1 : 0);
+        cur.row++;
+        if(cur.row >= nodes[cur.node].key.second) {
+            cur.node++;
+        }
+        assert_lt(cur.M_node, nodes.size());
+        pos = nodes[cur.M_node].to;
+        M = (cur.M_off == 0 ? 1 : 0);
+        cur.M_off++;
+        if(cur.M_off >= nodes[cur.M_node].key.first) {
+            cur.M_node++;
+            cur.M_off = 0;
+        }
+    }
+
+    // Advance an M position (node, offset among its outgoing edges) by
+    // 'rows' rows
+    void advanceM(index_t& M_node, index_t& M_off, index_t rows) const {
+        while(rows > 0) {
+            assert_lt(M_node, nodes.size());
+            index_t left = nodes[M_node].key.first - M_off;
+            if(rows < left) {
+                M_off += rows;
+                break;
+            }
+            rows -= left;
+            M_node++;
+            M_off = 0;
+        }
+    }
+
+    // Label of the incoming edge at the given GBWT row
+    int rowLabel(index_t row) const {
+        assert_lt(row, edges.size());
+        return edges[row].label;
+    }
+
+    // Value returned by the i-th call to nextFLocation()
+    index_t FLocation(index_t i) const {
+        assert_lt(i, nodes.size());
+        return (i == 0 ? 0 : nodes[i - 1].key.second);
+    }
+
 private:
     void makeFromRef(RefGraph<index_t>& base);
     void generationOne();
@@ -56,6 +56,7 @@
 #include "mem_ids.h"
 #include "btypes.h"
 #include "tokenize.h"
+#include "build_mem.h"
 
 #ifdef POPCNT_CAPABILITY
 #include "processor_support.h"
@@ -1283,152 +1284,18 @@ public:
                     }
                 }
                 
-                map<string, index_t> snpID2num;
                 if(snpfile != "") {
-                    ifstream snp_file(snpfile.c_str(), ios::in);
-                    if(!snp_file.is_open()) {
-                        cerr << "Error: could not open " << snpfile.c_str() << endl;
-                        throw 1;
-                    }
-                    
-                    while(!snp_file.eof()) {
-                        // rs73387790	single	22:20000001-21000000	145	A
-                        string snp_id;
-                        snp_file >> snp_id;
-                        if(snp_id.empty() || snp_id[0] == '#') {
-                            string line;
-                            getline(snp_file, line);
-                            continue;
-                        }
-                        string type, chr;
-                        index_t genome_pos;
-                        char snp_ch = '\0';
-                        string ins_seq;
-                        index_t del_len = 0;
-                        snp_file >> type >> chr >> genome_pos;
-                        if(type == "single") {
-                            snp_file >> snp_ch;
-                        } else if(type == "deletion") {
-                            snp_file >> del_len;
-                        } else if(type == "insertion") {
-                            snp_file >> ins_seq;
-                        }
-                        index_t chr_idx = 0;
-                        for(; chr_idx < refnames_nospace.size(); chr_idx++) {
-                            if(chr == refnames_nospace[chr_idx])
-                                break;
-                        }
-                        if(chr_idx >= refnames_nospace.size()) {
-                            continue;
-                        }
-                        assert_eq(chr_szs.size(), refnames_nospace.size());
-                        assert_lt(chr_idx, chr_szs.size());
-                        pair<index_t, index_t> tmp_pair = chr_szs[chr_idx];
-                        const index_t sofar_len = tmp_pair.first;
-                        const index_t szs_idx = tmp_pair.second;
-                        bool involve_Ns = false;
-                        index_t pos = genome_pos;
-                        index_t add_pos = 0;
-                        assert(szs[szs_idx].first);
-                        for(index_t i = szs_idx; i < szs.size(); i++) {
-                            if(i != szs_idx && szs[i].first) {
-                                break;
-                            }
-                            if(pos < szs[i].off) {
-                                involve_Ns = true;
-                                break;
-                            } else {
-                                pos -= szs[i].off;
-                                if(pos == 0) {
-                                   if(type == "deletion" || type == "insertion") {
-                                       involve_Ns = true;
-                                       break;
-                                   }
-                                }
-                                if(pos < szs[i].len) {
-                                    break;
-                                } else {
-                                    pos -= szs[i].len;
-                                    add_pos += szs[i].len;
-                                }
-                            }
-                        }
-                        
-                        if(involve_Ns) {
-                            continue;
-                        }
-                        pos = sofar_len + add_pos + pos;
-                        if(chr_idx + 1 < chr_szs.size()) {
-                            if(pos >= chr_szs[chr_idx + 1].first) {
-                                continue;
-                            }
-                        } else {
-                            if(pos >= jlen){
-                                continue;
-                            }
-                        }
-                        
-                        _alts.expand();
-                        ALT<index_t>& snp = _alts.back();
-                        snp.pos = pos;
-                        if(type == "single") {
-                            snp.type = ALT_SNP_SGL;
-                            snp_ch = toupper(snp_ch);
-                            if(snp_ch != 'A' && snp_ch != 'C' && snp_ch != 'G' && snp_ch != 'T') {
-                                _alts.pop_back();
-                                continue;
-                            }
-                            uint64_t bp = asc2dna[(int)snp_ch];
-                            assert_lt(bp, 4);
-                            if((int)bp == s[pos]) {
-                                cerr << "Warning: single type should have a different base than " << "ACGTN"[(int)s[pos]]
-                                     << " (" << snp_id << ") at " << genome_pos << " on " << chr << endl;
-                                _alts.pop_back();
-                                continue;
-                                // throw 1;
-                            }
-                            snp.len = 1;
-                            snp.seq = bp;
-                        } else if(type == "deletion") {
-                            snp.type = ALT_SNP_DEL;
-                            snp.len = del_len;
-                            snp.seq = 0;
-                            snp.reversed = false;
-                        } else if(type == "insertion") {
-                            snp.type = ALT_SNP_INS;
-                            snp.len = (index_t)ins_seq.size();
-                            if(snp.len > sizeof(snp.seq) * 4) {
-                                _alts.pop_back();
-                                continue;
-                            }
-                            snp.seq = 0;
-                            bool failed = false;
-                            for(size_t i = 0; i < ins_seq.size(); i++) {
-                                char ch = toupper(ins_seq[i]);
-                                if(ch != 'A' && ch != 'C' && ch != 'G' && ch != 'T') {
-                                    failed = true;
-                                    break;
-                                }
-                                uint64_t bp = asc2dna[(int)ch];
-                                assert_lt(bp, 4);
-                                snp.seq = (snp.seq << 2) | bp;
-                            }
-                            if(failed) {
-                                _alts.pop_back();
-                                continue;
-                            }
-                        } else {
-                            cerr << "Error: unknown snp type " << type << endl;
-                            throw 1;
-                        }
-                        _altnames.push_back(snp_id);
-                        assert_eq(_alts.size(), _altnames.size());
-                        snpID2num[snp_id] = (index_t)_alts.size() - 1;
-                    }
-                    snp_file.close();
+                    readSNPs(snpfile, s, szs, chr_szs, refnames_nospace, jlen);
                     assert_eq(_alts.size(), _altnames.size());
                 }
                 
+                map<string, index_t> snpID2num;
+                if(htfile != "") {
+                    for(index_t i = 0; i < _altnames.size(); i++) {
+                        snpID2num[_altnames[i]] = i;
+                    }
+                }
+                
                 _haplotypes.clear();
                 if(_alts.size() > 0 && htfile != "") {
                     ifstream ht_file(htfile.c_str(), ios::in);
@@ -1739,7 +1606,7 @@ public:
                         buf[i].second = (index_t)i;
                         buf2[i] = _altnames[i];
                     }
-                    buf.sort();
+                    parallel_sort<pair<ALT<index_t>, index_t> >(buf.begin(), buf.end(), _nthreads);
                     for(size_t i = 0; i < _alts.size(); i++) {
                         _alts[i] = buf[i].first;
                         _altnames[i] = buf2[buf[i].second];
@@ -1793,6 +1660,14 @@ public:
                 fout7.close();
                 fout8.close();
             }
+            _memModel.jlen = jlen;
+            _memModel.nalts = _alts.size();
+            _memModel.graph = !_alts.empty();
+            _memModel.nthreads = _nthreads;
+            _memModel.dcv = dcv;
+            _memModel.ftabChars = _gh._ftabChars;
+            _memModel.indexSz = sizeof(index_t);
+            if(_verbose) logMemPhase(cerr, "joining reference", _memModel.join());
 			// Joined reference sequence now in 's'
 		} catch(bad_alloc& e) {
 			// If we throw an allocation exception in the try block,
@@ -1914,6 +1789,9 @@ public:
                     assert_eq(bsa.size(), s.length()+1);
                     VMSG_NL("Converting suffix-array elements to index image");
                     buildToDisk(bsa, s, out1, out2);
+                    _memModel.dcv = dcv;
+                    _memModel.bmaxDivN = max<index_t>(jlen / max<index_t>(bmax, 1), 1);
+                    if(_verbose) logMemPhase(cerr, "blockwise SA", _memModel.blockwise());
                 } else {
                     RefGraph<index_t>* graph = new RefGraph<index_t>(
                                                                      s,
@@ -1923,6 +1801,7 @@ public:
                                                                      outfile,
                                                                      _nthreads,
                                                                      verbose);
+                    if(_verbose) logMemPhase(cerr, "RefGraph", _memModel.refGraph());
                     PathGraph<index_t>* pg = new PathGraph<index_t>(
                                                                     *graph,
                                                                     outfile,
@@ -1932,6 +1811,7 @@ public:
 
                     if(verbose) { cerr << "Generating edges... " << endl; }
                     if(!pg->generateEdges(*graph)) { return; }
+                    if(_verbose) logMemPhase(cerr, "PathGraph", _memModel.pathGraph());
                     // Re-initialize GFM parameters to reflect real number of edges (gbwt string)
                     _gh.init(
                              _gh.len(),
@@ -1977,6 +1857,285 @@ public:
 		}
 		VMSG_NL("Returning from initFromVector");
 	}
+
+	/**
+	 * Input and output of a thread parsing a block of whole lines of a
+	 * SNP file (see readSNPs).
+	 */
+	template <typename TStr>
+	struct SNPParseParam {
+		// input
+		const char*                           begin;
+		const char*                           end;
+		const TStr*                           s;
+		const EList<RefRecord>*               szs;
+		const EList<pair<index_t, index_t> >* chr_szs;
+		const map<string, index_t>*           chr2idx;
+		index_t                               jlen;
+
+		// output
+		EList<ALT<index_t> >                  alts;
+		EList<string>                         altnames;
+		string                                msgs;  // warnings, printed in input order
+		string                                error; // malformed line or unknown SNP type, if any
+	};
+
+	template <typename TStr>
+	static void parseSNPs_worker(void* vp) {
+		SNPParseParam<TStr>* param = (SNPParseParam<TStr>*)vp;
+		const TStr& s = *(param->s);
+		const EList<RefRecord>& szs = *(param->szs);
+		const EList<pair<index_t, index_t> >& chr_szs = *(param->chr_szs);
+		const map<string, index_t>& chr2idx = *(param->chr2idx);
+		const index_t jlen = param->jlen;
+
+		string fields[5];
+		const char* line = param->begin;
+		while(line < param->end) {
+			const char* eol = (const char*)memchr(line, '\n', param->end - line);
+			if(eol == NULL) eol = param->end;
+			// rs73387790	single	22:20000001-21000000	145	A
+			size_t nfields = 0;
+			for(const char* p = line; p < eol && nfields < 5;) {
+				while(p < eol && isspace((unsigned char)*p)) p++;
+				const char* q = p;
+				while(q < eol && !isspace((unsigned char)*q)) q++;
+				if(q > p) fields[nfields++].assign(p, q - p);
+				p = q;
+			}
+			const char* cur_line = line;
+			line = eol + 1;
+			if(nfields == 0 || fields[0][0] == '#') continue;
+			// Lines on chromosomes that are not in the index are skipped
+			// without looking at the rest of the line
+			typename map<string, index_t>::const_iterator chr_itr = chr2idx.end();
+			if(nfields >= 3) {
+				chr_itr = chr2idx.find(fields[2]);
+				if(chr_itr == chr2idx.end()) {
+					continue;
+				}
+			}
+			if(nfields < 5) {
+				param->error = "malformed snp line: " + string(cur_line, eol - cur_line);
+				break;
+			}
+			const string& snp_id = fields[0];
+			const string& type = fields[1];
+			const string& chr = fields[2];
+			index_t genome_pos = (index_t)strtoull(fields[3].c_str(), NULL, 10);
+
+			index_t chr_idx = chr_itr->second;
+			assert_lt(chr_idx, chr_szs.size());
+			pair<index_t, index_t> tmp_pair = chr_szs[chr_idx];
+			const index_t sofar_len = tmp_pair.first;
+			const index_t szs_idx = tmp_pair.second;
+			bool involve_Ns = false;
+			index_t pos = genome_pos;
+			index_t add_pos = 0;
+			assert(szs[szs_idx].first);
+			for(index_t i = szs_idx; i < szs.size(); i++) {
+				if(i != szs_idx && szs[i].first) {
+					break;
+				}
+				if(pos < szs[i].off) {
+					involve_Ns = true;
+					break;
+				} else {
+					pos -= szs[i].off;
+					if(pos == 0) {
+						if(type == "deletion" || type == "insertion") {
+							involve_Ns = true;
+							break;
+						}
+					}
+					if(pos < szs[i].len) {
+						break;
+					} else {
+						pos -= szs[i].len;
+						add_pos += szs[i].len;
+					}
+				}
+			}
+			if(involve_Ns) {
+				continue;
+			}
+			pos = sofar_len + add_pos + pos;
+			if(chr_idx + 1 < chr_szs.size()) {
+				if(pos >= chr_szs[chr_idx + 1].first) {
+					continue;
+				}
+			} else {
+				if(pos >= jlen){
+					continue;
+				}
+			}
+
+			ALT<index_t> snp;
+			snp.pos = pos;
+			if(type == "single") {
+				snp.type = ALT_SNP_SGL;
+				char snp_ch = toupper(fields[4][0]);
+				if(snp_ch != 'A' && snp_ch != 'C' && snp_ch != 'G' && snp_ch != 'T') {
+					continue;
+				}
+				uint64_t bp = asc2dna[(int)snp_ch];
+				assert_lt(bp, 4);
+				if((int)bp == s[pos]) {
+					ostringstream msg;
+					msg << "Warning: single type should have a different base than " << "ACGTN"[(int)s[pos]]
+					    << " (" << snp_id << ") at " << genome_pos << " on " << chr << endl;
+					param->msgs += msg.str();
+					continue;
+				}
+				snp.len = 1;
+				snp.seq = bp;
+			} else if(type == "deletion") {
+				snp.type = ALT_SNP_DEL;
+				snp.len = (index_t)strtoull(fields[4].c_str(), NULL, 10);
+				snp.seq = 0;
+				snp.reversed = false;
+			} else if(type == "insertion") {
+				const string& ins_seq = fields[4];
+				snp.type = ALT_SNP_INS;
+				snp.len = (index_t)ins_seq.size();
+				if(snp.len > sizeof(snp.seq) * 4) {
+					continue;
+				}
+				snp.seq = 0;
+				bool failed = false;
+				for(size_t i = 0; i < ins_seq.size(); i++) {
+					char ch = toupper(ins_seq[i]);
+					if(ch != 'A' && ch != 'C' && ch != 'G' && ch != 'T') {
+						failed = true;
+						break;
+					}
+					uint64_t bp = asc2dna[(int)ch];
+					assert_lt(bp, 4);
+					snp.seq = (snp.seq << 2) | bp;
+				}
+				if(failed) {
+					continue;
+				}
+			} else {
+				param->error = "unknown snp type " + type;
+				break;
+			}
+			param->alts.push_back(snp);
+			param->altnames.push_back(snp_id);
+		}
+	}
+
+	/**
+	 * Read SNPs from a file and append them to _alts and _altnames.
+	 * The file is read in large blocks; each block is split at line
+	 * boundaries into one range per thread, and the per-thread results
+	 * are appended in input order so that the outcome is the same as
+	 * that of a single-threaded parse.
+	 */
+	template <typename TStr>
+	void readSNPs(const string& snpfile,
+	              const TStr& s,
+	              const EList<RefRecord>& szs,
+	              const EList<pair<index_t, index_t> >& chr_szs,
+	              const EList<string>& refnames_nospace,
+	              index_t jlen)
+	{
+		FILE* snp_file = fopen(snpfile.c_str(), "rb");
+		if(snp_file == NULL) {
+			cerr << "Error: could not open " << snpfile.c_str() << endl;
+			throw 1;
+		}
+		assert_eq(chr_szs.size(), refnames_nospace.size());
+		map<string, index_t> chr2idx;
+		for(index_t i = 0; i < refnames_nospace.size(); i++) {
+			// The first of identically named sequences is used
+			if(chr2idx.find(refnames_nospace[i]) == chr2idx.end()) {
+				chr2idx[refnames_nospace[i]] = i;
+			}
+		}
+
+		const int nthreads = max(_nthreads, 1);
+		EList<char> buf; buf.resizeExact((size_t)nthreads << 22);
+		EList<SNPParseParam<TStr> > params; params.resizeExact(nthreads);
+		AutoArray<tthread::thread*> threads(nthreads);
+		size_t carry = 0;
+		bool done = false;
+		while(!done) {
+			size_t len = carry + fread(buf.ptr() + carry, 1, buf.size() - carry, snp_file);
+			if(ferror(snp_file)) {
+				cerr << "Error: could not read " << snpfile.c_str() << endl;
+				fclose(snp_file);
+				throw 1;
+			}
+			done = (len < buf.size());
+			size_t parse_len = len;
+			if(!done) {
+				// Leave the last, possibly incomplete, line for the next block
+				while(parse_len > 0 && buf[parse_len - 1] != '\n') parse_len--;
+				if(parse_len == 0) {
+					// A line is longer than the buffer
+					carry = len;
+					buf.resize(buf.size() << 1);
+					continue;
+				}
+			}
+
+			const char* block_end = buf.ptr() + parse_len;
+			const char* st = buf.ptr();
+			for(int i = 0; i < nthreads; i++) {
+				const char* en = block_end;
+				if(i + 1 < nthreads) {
+					en = max<const char*>(st, buf.ptr() + parse_len / nthreads * (i + 1));
+					while(en < block_end && en > st && *(en - 1) != '\n') en++;
+				}
+				SNPParseParam<TStr>& param = params[i];
+				param.begin = st;
+				param.end = en;
+				param.s = &s;
+				param.szs = &szs;
+				param.chr_szs = &chr_szs;
+				param.chr2idx = &chr2idx;
+				param.jlen = jlen;
+				param.alts.clear();
+				param.altnames.clear();
+				param.msgs.clear();
+				param.error.clear();
+				if(nthreads == 1) {
+					parseSNPs_worker<TStr>((void*)&param);
+				} else {
+					threads[i] = new tthread::thread(parseSNPs_worker<TStr>, (void*)&param);
+				}
+				st = en;
+			}
+			if(nthreads > 1) {
+				for(int i = 0; i < nthreads; i++) {
+					threads[i]->join();
+					delete threads[i];
+				}
+			}
+
+			for(int i = 0; i < nthreads; i++) {
+				const SNPParseParam<TStr>& param = params[i];
+				cerr << param.msgs;
+				for(index_t j = 0; j < param.alts.size(); j++) {
+					_alts.push_back(param.alts[j]);
+					_altnames.push_back(param.altnames[j]);
+				}
+				if(!param.error.empty()) {
+					cerr << "Error: " << param.error << endl;
+					fclose(snp_file);
+					throw 1;
+				}
+			}
+
+			carry = len - parse_len;
+			if(carry > 0) {
+				memmove(buf.ptr(), buf.ptr() + parse_len, carry);
+			}
+		}
+		fclose(snp_file);
+		assert_eq(_alts.size(), _altnames.size());
+	}
 	
 	/**
 	 * Return the length that the joined string of the given string
@@ -2476,9 +2635,85 @@ public:
 	template <typename TStr> static TStr join(EList<TStr>& l, uint32_t seed);
 	template <typename TStr> static TStr join(EList<FileBuf*>& l, EList<RefRecord>& szs, index_t sztot, const RefReadInParams& refparams, uint32_t seed);
 	template <typename TStr> void joinToDisk(EList<FileBuf*>& l, EList<RefRecord>& szs, index_t sztot, const RefReadInParams& refparams, TStr& ret, ostream& out1, ostream& out2);
+	template <typename TStr> void joinFileToDisk(FileBuf& in, const RefReadInParams& refparams, TStr& ret, index_t& dstoff, EList<RefRecord>& recs, EList<string>& names);
 	template <typename TStr> void buildToDisk(PathGraph<index_t>& gbwt, const TStr& s, ostream& out1, ostream& out2);
     template <typename TStr> void buildToDisk(InorderBlockwiseSA<TStr>& sa, const TStr& s, ostream& out1, ostream& out2);
 
+	/**
+	 * One unit of work of joinFileToDisk: either a line-aligned chunk
+	 * of the sequence lines of a plain record, or a whole record that
+	 * has to go through fastaRefReadAppend (see joinFileToDisk).
+	 */
+	template <typename TStr>
+	struct JoinItem {
+		const char*            begin;
+		const char*            end;
+		bool                   plain;   // chunk of a plain record's sequence
+		index_t                rec;     // plain record the chunk belongs to
+
+		// pass 1 output
+		TIndexOffU             seqlen;  // number of characters parsed
+		EList<RefRecord>       frags;   // plain: unambiguous stretches of the chunk
+		TIndexOffU             trail;   // plain: ambiguous characters after the last stretch
+		TStr                   seq;     // otherwise: parsed characters
+		EList<RefRecord>       recs;    // otherwise: records
+		EList<string>          names;   // otherwise: record names
+
+		// where the characters go in the joined string
+		TIndexOffU             dstoff;
+	};
+
+	/**
+	 * Input of a thread working on every nthreads-th JoinItem.
+	 */
+	template <typename TStr>
+	struct JoinParam {
+		EList<JoinItem<TStr> >* items;
+		int                     tid;
+		int                     nthreads;
+		const RefReadInParams*  refparams;
+		TStr*                   dst;
+	};
+	template <typename TStr> static void joinParse_worker(void* vp);
+	template <typename TStr> static void joinCopy_worker(void* vp);
+
+	// Sequence lines of a plain record are split into chunks of about this size
+	static const size_t join_chunk_sz = (1 << 22);
+
+	/**
+	 * Input and output of a thread packing a contiguous run of GBWT sides
+	 * (see buildToDisk(PathGraph&, ...)).
+	 */
+	struct GbwtRunParam {
+		// input
+		GFM<index_t>*             gfm;
+		const PathGraph<index_t>* gbwt;
+		index_t                   sideBeg;
+		index_t                   sideEnd;
+		index_t                   occ[4]; // occurrences before the run
+		index_t                   M_node; // M position of the run's first row
+		index_t                   M_off;
+
+		// output
+		index_t                   cnt[4]; // occurrences in the run, excluding padding
+		EList<index_t>            zOffs;
+		EList<index_t>            offs;   // SA samples in row order
+	};
+	static void gbwtCount_worker(void* vp);
+	static void gbwtRun_worker(void* vp);
+
+	/**
+	 * A slice of ftab entries looked up by one thread; entries whose
+	 * k-mer does not occur are left as (INDEX_MAX, INDEX_MAX).
+	 */
+	struct GbwtFtabParam {
+		const GFM<index_t>*             gfm;
+		EList<pair<index_t, index_t> >* tFtab;
+		index_t                         begin;
+		index_t                         end;
+	};
+	static void gbwtFtab_worker(void* vp);
+
 	// I/O
 	void readIntoMemory(int needEntireRev, bool loadSASamp, bool loadFtab, bool loadRstarts, bool justHeader, GFMParams<index_t> *params, bool mmSweep, bool loadNames, bool startVerbose);
 	void writeFromMemory(bool justHeader, ostream& out1, ostream& out2) const;
@@ -3878,11 +4113,16 @@ public:
 	static const int      default_offRatePlus = 0;
 	static const int      default_ftabChars = 10;
 	static const bool     default_bigEndian = false;
+	// GBWT rows packed by one thread at a time in buildToDisk()
+	static const index_t  gbwt_run_rows = (1 << 22);
     
     EList<ALT<index_t> >       _alts;
     EList<string>              _altnames;
     EList<Haplotype<index_t> > _haplotypes;
 
+    // Memory model of the build, used to log predicted vs. observed peaks
+    BuildMemModel              _memModel;
+
 protected:
 
 	ostream& log() const {
@@ -4067,8 +4307,9 @@ TStr GFM<index_t>::join(EList<FileBuf*>& l,
 		// For each sequence we can pull out of istream l[i]...
 		assert(!l[i]->eof());
 		bool first = true;
+		int lastc = '>';
 		while(!l[i]->eof()) {
-			RefRecord rec = fastaRefReadAppend(*l[i], first, ret, dstoff, rpcp);
+			RefRecord rec = fastaRefReadAppend(*l[i], first, lastc, ret, dstoff, rpcp);
 			first = false;
 			index_t bases = (index_t)rec.len;
 			assert_eq(rec.off, szs[szsi].off);
@@ -4150,19 +4391,34 @@ void GFM<index_t>::joinToDisk(
 	ASSERT_ONLY(index_t szsi = 0);
 	ASSERT_ONLY(index_t entsWritten = 0);
 	index_t dstoff = 0;
+	EList<RefRecord> recs;
+	EList<string> names;
 	// For each filebuf
 	for(unsigned int i = 0; i < l.size(); i++) {
 		assert(!l[i]->eof());
 		bool first = true;
+		int lastc = '>';
 		index_t patoff = 0;
+		// With multiple threads, the fragments of the whole file are
+		// parsed and copied into 'ret' up front
+		const bool parallel = _nthreads > 1;
+		if(parallel) {
+			joinFileToDisk(*l[i], rpcp, ret, dstoff, recs, names);
+		}
 		// For each *fragment* (not necessary an entire sequence) we
 		// can pull out of istream l[i]...
-		while(!l[i]->eof()) {
+		for(index_t r = 0; parallel ? r < recs.size() : !l[i]->eof(); r++) {
 			string name;
 			// Push a new name onto our vector
 			_refnames.push_back("");
-			RefRecord rec = fastaRefReadAppend(
-				*l[i], first, ret, dstoff, rpcp, &_refnames.back());
+			RefRecord rec;
+			if(parallel) {
+				rec = recs[r];
+				_refnames.back() = names[r];
+			} else {
+				rec = fastaRefReadAppend(
+					*l[i], first, lastc, ret, dstoff, rpcp, &_refnames.back());
+			}
 			first = false;
 			index_t bases = rec.len;
 			if(rec.first && rec.len > 0) {
@@ -4214,6 +4470,453 @@ void GFM<index_t>::joinToDisk(
 	assert_eq(entsWritten, this->_nFrag);
 }
 
+/**
+ * Parse all records of one FASTA input with _nthreads threads and write
+ * the parsed characters into 'ret' starting at 'dstoff'.  The input is
+ * read in large blocks that are cut just before a record's '>', so a
+ * record longer than a block is held in the block buffer whole.
+ *
+ * A "plain" record is one whose only '>' is its first character and
+ * that has no '#' comment; its records are the maximal runs of
+ * unambiguous characters of its sequence lines, so those lines can be
+ * split at line boundaries into chunks that are parsed independently
+ * and stitched back together.  Any other record, and every record when
+ * colors, Ns-to-As or per-sequence reversal are requested, is parsed
+ * whole with fastaRefReadAppend.
+ *
+ * Pass 1 counts the characters of each chunk (and parses the other
+ * records into a scratch buffer); pass 2 writes the characters into
+ * 'ret' at offsets given by prefix sums of the counts.  The records
+ * and names are returned in input order, just as fastaRefReadAppend
+ * would return them one by one, except that plain records without any
+ * unambiguous character, which joinToDisk ignores, are left out.
+ */
+template <typename index_t>
+template <typename TStr>
+void GFM<index_t>::joinFileToDisk(
+	FileBuf& in,
+	const RefReadInParams& refparams,
+	TStr& ret,
+	index_t& dstoff,
+	EList<RefRecord>& recs,
+	EList<string>& names)
+{
+	assert_gt(_nthreads, 1);
+	recs.clear();
+	names.clear();
+	int c = in.getPastWhitespace();
+	if(c != '>') {
+		cerr << "Reference file does not seem to be a FASTA file" << endl;
+		throw 1;
+	}
+	const bool chunkable = !refparams.color && !refparams.nsToAs && refparams.reverse != REF_READ_REVERSE_EACH;
+	const int nthreads = _nthreads;
+	EList<char> buf; buf.resizeExact((size_t)nthreads << 24);
+	buf[0] = '>';
+	size_t carry = 1;
+	EList<JoinItem<TStr> > items;
+	EList<string> plain_names;
+	EList<JoinParam<TStr> > params; params.resizeExact(nthreads);
+	AutoArray<tthread::thread*> threads(nthreads);
+	EList<RefRecord> frags; // unambiguous stretches of the current plain record
+	bool done = false;
+	while(!done) {
+		size_t len = carry + in.getBlock(buf.ptr() + carry, buf.size() - carry);
+		done = (len < buf.size());
+		size_t parse_len = len;
+		if(!done) {
+			// Leave the last, possibly incomplete, record for the next block
+			while(parse_len > 1 && !(buf[parse_len - 1] == '>' && isnewline(buf[parse_len - 2]))) parse_len--;
+			parse_len--;
+			if(parse_len == 0) {
+				// A record is longer than the buffer
+				carry = len;
+				buf.resize(buf.size() << 1);
+				continue;
+			}
+		}
+
+		// Split the block into records and plain records into chunks
+		items.clear();
+		plain_names.clear();
+		const char* block_end = buf.ptr() + parse_len;
+		const char* st = buf.ptr();
+		while(st < block_end) {
+			assert_eq('>', *st);
+			const char* en = st + 1;
+			bool plain = chunkable;
+			while(en < block_end) {
+				en = (const char*)memchr(en, '>', block_end - en);
+				if(en == NULL) {
+					en = block_end;
+				} else if(isnewline(*(en - 1))) {
+					break;
+				} else {
+					plain = false;
+					en++;
+				}
+			}
+			if(plain && memchr(st, '#', en - st) != NULL) plain = false;
+			if(!plain) {
+				items.expand();
+				JoinItem<TStr>& item = items.back();
+				item.begin = st;
+				item.end = en;
+				item.plain = false;
+				st = en;
+				continue;
+			}
+			const char* name_end = st + 1;
+			while(name_end < en && !isnewline(*name_end)) name_end++;
+			plain_names.expand();
+			plain_names.back().assign(st + 1, name_end - st - 1);
+			for(const char* cst = name_end; cst < en;) {
+				const char* cen = en;
+				if((size_t)(en - cst) > join_chunk_sz) {
+					cen = (const char*)memchr(cst + join_chunk_sz, '\n', en - cst - join_chunk_sz);
+					cen = (cen == NULL ? en : cen + 1);
+				}
+				items.expand();
+				JoinItem<TStr>& item = items.back();
+				item.begin = cst;
+				item.end = cen;
+				item.plain = true;
+				item.rec = (index_t)plain_names.size() - 1;
+				cst = cen;
+			}
+			st = en;
+		}
+
+		for(int t = 0; t < nthreads; t++) {
+			JoinParam<TStr>& param = params[t];
+			param.items = &items;
+			param.tid = t;
+			param.nthreads = nthreads;
+			param.refparams = &refparams;
+			param.dst = &ret;
+			threads[t] = new tthread::thread(joinParse_worker<TStr>, (void*)&param);
+		}
+		for(int t = 0; t < nthreads; t++) {
+			threads[t]->join();
+			delete threads[t];
+		}
+
+		// Collect records in input order and place each item's characters.
+		// Stretches of a plain record that meet at a chunk boundary are
+		// joined, and ambiguous characters at the end of a chunk are added
+		// to the offset of the next stretch.
+		for(index_t i = 0; i < items.size(); i++) {
+			JoinItem<TStr>& item = items[i];
+			assert_leq(dstoff + item.seqlen, ret.length());
+			item.dstoff = dstoff;
+			dstoff += (index_t)item.seqlen;
+			if(!item.plain) {
+				for(index_t r = 0; r < item.recs.size(); r++) {
+					recs.push_back(item.recs[r]);
+					names.push_back(item.names[r]);
+				}
+				continue;
+			}
+			const bool rec_first = (i == 0 || !items[i - 1].plain || items[i - 1].rec != item.rec);
+			const bool rec_last = (i + 1 == items.size() || !items[i + 1].plain || items[i + 1].rec != item.rec);
+			if(rec_first) frags.clear();
+			TIndexOffU gaps = ((!frags.empty() && frags.back().len == 0) ? frags.back().off : 0);
+			for(index_t f = 0; f < item.frags.size(); f++) {
+				const RefRecord& frag = item.frags[f];
+				if(f == 0 && frag.off == 0 && !frags.empty() && frags.back().len > 0) {
+					frags.back().len += frag.len;
+				} else {
+					if(!frags.empty() && frags.back().len == 0) frags.pop_back();
+					frags.push_back(RefRecord(gaps + frag.off, frag.len, false));
+				}
+				gaps = 0;
+			}
+			// A trailing empty stretch carries the ambiguous characters seen so far
+			if(item.trail > 0) {
+				if(!frags.empty() && frags.back().len == 0) {
+					frags.back().off += item.trail;
+				} else {
+					frags.push_back(RefRecord(item.trail, 0, false));
+				}
+			}
+			if(rec_last) {
+				if(!frags.empty() && frags.back().len == 0) frags.pop_back();
+				for(index_t f = 0; f < frags.size(); f++) {
+					recs.push_back(frags[f]);
+					recs.back().first = (f == 0);
+					names.push_back(f == 0 ? plain_names[item.rec] : string());
+				}
+			}
+		}
+
+		for(int t = 0; t < nthreads; t++) {
+			threads[t] = new tthread::thread(joinCopy_worker<TStr>, (void*)&params[t]);
+		}
+		for(int t = 0; t < nthreads; t++) {
+			threads[t]->join();
+			delete threads[t];
+		}
+
+		carry = len - parse_len;
+		if(carry > 0) {
+			memmove(buf.ptr(), buf.ptr() + parse_len, carry);
+		}
+	}
+}
+
+/**
+ * Pass 1 of joinFileToDisk: find the unambiguous stretches of each
+ * chunk of a plain record, or parse a whole record into a scratch
+ * buffer.
+ */
+template <typename index_t>
+template <typename TStr>
+void GFM<index_t>::joinParse_worker(void* vp)
+{
+	JoinParam<TStr>* param = (JoinParam<TStr>*)vp;
+	EList<JoinItem<TStr> >& items = *(param->items);
+	for(index_t i = param->tid; i < items.size(); i += param->nthreads) {
+		JoinItem<TStr>& item = items[i];
+		item.seqlen = 0;
+		item.frags.clear();
+		item.trail = 0;
+		item.recs.clear();
+		item.names.clear();
+		if(item.plain) {
+			TIndexOffU len = 0, gaps = 0;
+			for(const char* p = item.begin; p < item.end; p++) {
+				int cat = asc2dnacat[(uint8_t)*p];
+				if(cat == 1) {
+					len++;
+				} else if(cat >= 2) {
+					if(len > 0) {
+						item.frags.push_back(RefRecord(gaps, len, false));
+						item.seqlen += len;
+						len = gaps = 0;
+					}
+					gaps++;
+				}
+			}
+			if(len > 0) {
+				item.frags.push_back(RefRecord(gaps, len, false));
+				item.seqlen += len;
+				gaps = 0;
+			}
+			item.trail = gaps;
+			continue;
+		}
+		RefReadInParams rpcp = *(param->refparams);
+		// No more characters than the record's can be parsed
+		item.seq.resize(item.end - item.begin);
+		FileBuf in(item.begin, item.end - item.begin);
+		bool first = true;
+		int lastc = '>';
+		while(!in.eof()) {
+			item.names.expand();
+			item.names.back().clear();
+			RefRecord rec = fastaRefReadAppend(
+				in, first, lastc, item.seq, item.seqlen, rpcp, &item.names.back());
+			first = false;
+			item.recs.push_back(rec);
+		}
+	}
+}
+
+/**
+ * Pass 2 of joinFileToDisk: write the characters of each item into the
+ * joined string.
+ */
+template <typename index_t>
+template <typename TStr>
+void GFM<index_t>::joinCopy_worker(void* vp)
+{
+	JoinParam<TStr>* param = (JoinParam<TStr>*)vp;
+	EList<JoinItem<TStr> >& items = *(param->items);
+	TStr& dst = *(param->dst);
+	const bool bisulfite = param->refparams->bisulfite;
+	for(index_t i = param->tid; i < items.size(); i += param->nthreads) {
+		const JoinItem<TStr>& item = items[i];
+		TIndexOffU off = item.dstoff;
+		if(item.plain) {
+			for(const char* p = item.begin; p < item.end; p++) {
+				int c = *p;
+				if(asc2dnacat[(uint8_t)c] != 1) continue;
+				if(bisulfite && toupper(c) == 'C') c = 'T';
+				dst.set(asc2dna[c], off++);
+			}
+		} else {
+			for(TIndexOffU j = 0; j < item.seqlen; j++) {
+				dst.set(item.seq[j], off++);
+			}
+		}
+		assert_eq(item.dstoff + item.seqlen, off);
+	}
+}
+
+/**
+ * Look up the GBWT range of each ftab k-mer in a slice of the ftab.
+ */
+template <typename index_t>
+void GFM<index_t>::gbwtFtab_worker(void* vp)
+{
+	GbwtFtabParam* param = (GbwtFtabParam*)vp;
+	const GFM<index_t>& gfm = *(param->gfm);
+	const GFMParams<index_t>& gh = gfm._gh;
+	EList<pair<index_t, index_t> >& tFtab = *(param->tFtab);
+	for(index_t i = param->begin; i < param->end; i++) {
+		index_t q = i;
+		pair<index_t, index_t> range(0, gh._gbwtLen);
+		SideLocus<index_t> tloc, bloc;
+		SideLocus<index_t>::initFromTopBot(range.first, range.second, gh, gfm.gfm(), tloc, bloc);
+		index_t j = 0;
+		for(; j < (index_t)gh._ftabChars; j++) {
+			int nt = q & 0x3; q >>= 2;
+			if(bloc.valid()) {
+				range = gfm.mapGLF(tloc, bloc, nt);
+			} else {
+				range = gfm.mapGLF1(range.first, tloc, nt);
+			}
+			if(range.first == (index_t)INDEX_MAX || range.first >= range.second) {
+				break;
+			}
+			if(range.first + 1 == range.second) {
+				tloc.initFromRow(range.first, gh, gfm.gfm());
+				bloc.invalidate();
+			} else {
+				SideLocus<index_t>::initFromTopBot(range.first, range.second, gh, gfm.gfm(), tloc, bloc);
+			}
+		}
+		if(range.first >= range.second || j < (index_t)gh._ftabChars) {
+			tFtab[i].first = tFtab[i].second = (index_t)INDEX_MAX;
+		} else {
+			tFtab[i].first = range.first;
+			tFtab[i].second = range.second;
+		}
+	}
+}
+
+/**
+ * Count the A/C/G/T occurrences among the GBWT rows of a run of sides.
+ */
+template <typename index_t>
+void GFM<index_t>::gbwtCount_worker(void* vp)
+{
+	GbwtRunParam* param = (GbwtRunParam*)vp;
+	const GFMParams<index_t>& gh = param->gfm->_gh;
+	index_t rowBeg = param->sideBeg * gh._sideGbwtLen;
+	index_t rowEnd = min<index_t>(param->sideEnd * gh._sideGbwtLen, gh._gbwtLen);
+	param->cnt[0] = param->cnt[1] = param->cnt[2] = param->cnt[3] = 0;
+	for(index_t row = rowBeg; row < rowEnd; row++) {
+		int gbwtChar = param->gbwt->rowLabel(row);
+		if(gbwtChar != 'Z') {
+			assert_lt(asc2dna[gbwtChar], 4);
+			param->cnt[asc2dna[gbwtChar]]++;
+		}
+	}
+}
+
+/**
+ * Pack a run of GBWT sides into the in-memory GFM, starting from the
+ * occurrence counts and M position given in the parameters.  Produces
+ * the same bytes the sides would get from a single serial pass.
+ */
+template <typename index_t>
+void GFM<index_t>::gbwtRun_worker(void* vp)
+{
+	GbwtRunParam* param = (GbwtRunParam*)vp;
+	const GFMParams<index_t>& gh = param->gfm->_gh;
+	const PathGraph<index_t>& gbwt = *(param->gbwt);
+	const index_t gbwtLen = gh._gbwtLen;
+	const index_t sideSz = gh._sideSz;
+	const bool be = param->gfm->toBe();
+	index_t occ[4], occSave[4];
+	memcpy(occ, param->occ, sizeof(occ));
+	memcpy(occSave, param->occ, sizeof(occ));
+	// # of occurrences of 1 in M arrays
+	index_t M_occ = param->M_node + (param->M_off > 0 ? 1 : 0);
+	// Location in F that corresponds to the last 1 in M
+	index_t F_loc = (M_occ == 0 ? 0 : gbwt.FLocation(M_occ - 1));
+	index_t M_occSave = M_occ, F_locSave = F_loc;
+	param->cnt[0] = param->cnt[1] = param->cnt[2] = param->cnt[3] = 0;
+	param->zOffs.clear();
+	param->offs.clear();
+
+	index_t si = param->sideBeg * gh._sideGbwtLen; // GBWT row
+	typename PathGraph<index_t>::RowCursor cur;
+	if(si < gbwtLen) {
+		gbwt.initRowCursor(cur, si, param->M_node, param->M_off);
+	}
+	for(index_t side = param->sideBeg; side < param->sideEnd; side++) {
+		uint8_t *gfmSide = param->gfm->_gfm.get() + side * sideSz;
+		memset(gfmSide, 0, gh._sideGbwtSz);
+		for(int sideCur = 0; (sideCur << 1) < (int)gh._sideGbwtSz; sideCur++) {
+			// Iterate over bit-pairs in the si'th character of the BWT
+			for(int bpi = 0; bpi < 4; bpi++, si++) {
+				int gbwtChar = 0; // one of A, C, G, T, and Z
+				int F = 0, M = 0; // either 0 or 1
+				index_t pos = 0;  // pos on joined string
+				bool count = true;
+				if(si < gbwtLen) {
+					gbwt.nextRow(cur, gbwtChar, F, M, pos);
+					if(gbwtChar == 'Z') {
+						// Don't add the 'Z' in the last column to the BWT
+						// transform; we can't encode a $ (only A C T or G)
+						// and counting it as, say, an A, will mess up the
+						// LF mapping
+						gbwtChar = 0; count = false;
+						param->zOffs.push_back(si);
+					} else {
+						gbwtChar = asc2dna[gbwtChar];
+						assert_lt(gbwtChar, 4);
+						param->cnt[gbwtChar]++;
+					}
+					assert_lt(F, 2);
+					assert_lt(M, 2);
+					if(M == 1) {
+						F_loc = gbwt.FLocation(M_occ);
+					}
+					// Suffix array offset boundary? - update offset array
+					if(M == 1 && (M_occ & gh._offMask) == M_occ) {
+						assert_lt((M_occ >> gh._offRate), gh._offsLen);
+						param->offs.push_back(pos);
+					}
+				} else {
+					// Strayed off the end of the SA, now we're just
+					// padding out a bucket; 'A' used for padding, which
+					// must be counted in the occ[] array
+					gbwtChar = 0;
+					F = M = 0;
+				}
+				if(count) occ[gbwtChar]++;
+				if(M) M_occ++;
+				// Append BWT char to bwt section of current side
+				pack_2b_in_8b(gbwtChar, gfmSide[sideCur], bpi);
+				assert_eq((gfmSide[sideCur] >> (bpi*2)) & 3, gbwtChar);
+
+				int F_sideCur = (gh._sideGbwtSz + sideCur) >> 1;
+				int F_bpi = bpi + ((sideCur & 0x1) << 2); // Can be used as M_bpi as well
+				pack_1b_in_8b(F, gfmSide[F_sideCur], F_bpi);
+				assert_eq((gfmSide[F_sideCur] >> F_bpi) & 1, F);
+
+				int M_sideCur = F_sideCur + (gh._sideGbwtSz >> 2);
+				pack_1b_in_8b(M, gfmSide[M_sideCur], F_bpi);
+				assert_eq((gfmSide[M_sideCur] >> F_bpi) & 1, M);
+			}
+		}
+		// Write 'A', 'C', 'G', 'T', and '1' in M tallies
+		index_t *uside = reinterpret_cast<index_t*>(gfmSide);
+		uside[(sideSz / sizeof(index_t))-6] = endianizeIndex(F_locSave, be);
+		uside[(sideSz / sizeof(index_t))-5] = endianizeIndex(M_occSave, be);
+		uside[(sideSz / sizeof(index_t))-4] = endianizeIndex(occSave[0], be);
+		uside[(sideSz / sizeof(index_t))-3] = endianizeIndex(occSave[1], be);
+		uside[(sideSz / sizeof(index_t))-2] = endianizeIndex(occSave[2], be);
+		uside[(sideSz / sizeof(index_t))-1] = endianizeIndex(occSave[3], be);
+		F_locSave = F_loc;
+		M_occSave = M_occ;
+		memcpy(occSave, occ, sizeof(occ));
+	}
+}
+
 /**
  * Build an Ebwt from a string 's' and its suffix array 'sa' (which
  * might actually be a suffix array *builder* that builds blocks of the
@@ -4264,14 +4967,6 @@ void GFM<index_t>::buildToDisk(
 	EList<index_t> ftab(EBWT_CAT);
     EList<index_t> zOffs;
 
-	// Save # of occurrences of each character as we walk along the bwt
-	index_t occ[4] = {0, 0, 0, 0};
-	index_t occSave[4] = {0, 0, 0, 0};
-    // # of occurrences of 1 in M arrays
-    index_t M_occ = 0, M_occSave = 0;
-    // Location in F that corresponds to 1 in M
-    index_t F_loc = 0, F_locSave = 0;
-    
     // Record rows that should "absorb" adjacent rows in the ftab.
     try {
         VMSG_NL("Allocating ftab, absorbFtab");
@@ -4284,21 +4979,9 @@ void GFM<index_t>::buildToDisk(
         throw e;
     }
     
-	// Allocate the side buffer; holds a single side as its being
-	// constructed and then written to disk.  Reused across all sides.
-#ifdef SIXTY4_FORMAT
-	EList<uint64_t> gfmSide(EBWT_CAT);
-#else
-	EList<uint8_t> gfmSide(EBWT_CAT);
-#endif
 	try {
         // Used to calculate ftab and eftab, but having gfm costs a lot of memory
         _gfm.init(new uint8_t[gh._gbwtTotLen], gh._gbwtTotLen, true);
-#ifdef SIXTY4_FORMAT
-		gfmSide.resize(sideSz >> 3);
-#else
-		gfmSide.resize(sideSz);
-#endif
 	} catch(bad_alloc &e) {
 		cerr << "Out of memory allocating ebwtSide[] in "
 		     << "GFM::buildToDisk() at " << __FILE__ << ":"
@@ -4306,182 +4989,91 @@ void GFM<index_t>::buildToDisk(
 		throw e;
 	}
 
-	// Points to the base offset within ebwt for the side currently
-	// being written
-	index_t side = 0;
-
-	// Whether we're assembling a forward or a reverse bucket
-    bool fw = true;
-	int sideCur = 0;
-
-	index_t si = 0;   // string offset (chars)
-	ASSERT_ONLY(bool inSA = true); // true iff saI still points inside suffix
-	                               // array (as opposed to the padding at the
-	                               // end)
-	// Iterate over packed bwt bytes
+	// Pack the sides a round at a time.  A round is split into one
+	// contiguous run of sides per thread; the occurrence counts and the
+	// M position at the start of each run are worked out first so that
+	// the runs can be packed independently.  SA samples and zOffs are
+	// gathered per run and written out in order after each round.
 	VMSG_NL("Entering GFM loop");
 	ASSERT_ONLY(index_t beforeGbwtOff = (index_t)out1.tellp());
-	while(side < gbwtTotSz) {
-		// Sanity-check our cursor into the side buffer
-		assert_geq(sideCur, 0);
-		assert_lt(sideCur, (int)gh._sideGbwtSz);
-		assert_eq(0, side % sideSz); // 'side' must be on side boundary
-        if(sideCur == 0) {
-            memset(gfmSide.ptr(), 0, gh._sideGbwtSz);
-            gfmSide[sideCur] = 0; // clear
-        }
-		assert_lt(side + sideCur, gbwtTotSz);
-		// Iterate over bit-pairs in the si'th character of the BWT
-#ifdef SIXTY4_FORMAT
-		for(int bpi = 0; bpi < 32; bpi++, si++)
-#else
-		for(int bpi = 0; bpi < 4; bpi++, si++)
-#endif
-		{
-			int gbwtChar = 0; // one of A, C, G, T, and Z
-            int F= 0, M = 0;     // either 0 or 1
-            index_t pos = 0;  // pos on joined string
-            bool count = true;
-			if(si < gbwtLen) {
-				gbwt.nextRow(gbwtChar, F, M, pos);
-                
-				// (that might have triggered sa to calc next suf block)
-				if(gbwtChar == 'Z') {
-					// Don't add the 'Z' in the last column to the BWT
-					// transform; we can't encode a $ (only A C T or G)
-					// and counting it as, say, an A, will mess up the
-					// LF mapping
-					gbwtChar = 0; count = false;
-#ifndef NDEBUG
-                    if(zOffs.size() > 0) {
-                        assert_gt(si, zOffs.back());
-                    }
-#endif
-                    zOffs.push_back(si); // remember GBWT row that corresponds to the 0th suffix
-				} else {
-                    gbwtChar = asc2dna[gbwtChar];
-                    assert_lt(gbwtChar, 4);
-                    // Update the fchr
-                    fchr[gbwtChar]++;
-				}
-                
-                assert_lt(F, 2);
-                assert_lt(M, 2);
-                if(M == 1) {
-                    assert_neq(F_loc, numeric_limits<index_t>::max());
-                    F_loc = gbwt.nextFLocation();
-#ifndef NDEBUG
-                    if(F_loc > 0) {
-                        assert_gt(F_loc, F_locSave);
-                    }
-#endif
-                }
-				// Suffix array offset boundary? - update offset array
-				if(M == 1 && (M_occ & gh._offMask) == M_occ) {
-					assert_lt((M_occ >> gh._offRate), gh._offsLen);
-                    // Write offsets directly to the secondary output
-					// stream, thereby avoiding keeping them in memory
-                    writeIndex<index_t>(out2, pos, this->toBe());
-				}
-			} else {
-				// Strayed off the end of the SA, now we're just
-				// padding out a bucket
-#ifndef NDEBUG
-				if(inSA) {
-					// Assert that we wrote all the characters in the
-					// string before now
-					assert_eq(si, gbwtLen);
-					inSA = false;
-				}
-#endif
-				// 'A' used for padding; important that padding be
-				// counted in the occ[] array
-				gbwtChar = 0;
-                F = M = 0;
+	const index_t numSides = gbwtTotSz / sideSz;
+	const index_t sidesPerRun = max<index_t>(gbwt_run_rows / gh._sideGbwtLen, 1);
+	const int nthreads = max<int>(_nthreads, 1);
+	EList<GbwtRunParam> params;
+	params.resizeExact(nthreads);
+	AutoArray<tthread::thread*> threads(nthreads);
+	index_t occ[4] = {0, 0, 0, 0};
+	index_t M_node = 0, M_off = 0;
+	index_t side = 0;
+	while(side < numSides) {
+		const index_t roundBeg = side;
+		int nruns = 0;
+		for(; nruns < nthreads && side < numSides; nruns++) {
+			GbwtRunParam& param = params[nruns];
+			param.gfm = this;
+			param.gbwt = &gbwt;
+			param.sideBeg = side;
+			param.sideEnd = min<index_t>(side + sidesPerRun, numSides);
+			side = param.sideEnd;
+		}
+		// Only runs followed by another run in this round need counting
+		// ahead of time
+		for(int t = 0; t + 1 < nruns; t++) {
+			threads[t] = new tthread::thread(gbwtCount_worker, (void*)&params[t]);
+		}
+		for(int t = 0; t + 1 < nruns; t++) {
+			threads[t]->join();
+			delete threads[t];
+		}
+		for(int t = 0; t < nruns; t++) {
+			GbwtRunParam& param = params[t];
+			memcpy(param.occ, occ, sizeof(occ));
+			param.M_node = M_node;
+			param.M_off = M_off;
+			if(t + 1 < nruns) {
+				for(int c = 0; c < 4; c++) occ[c] += param.cnt[c];
+				index_t rowBeg = param.sideBeg * gh._sideGbwtLen;
+				index_t rowEnd = min<index_t>(param.sideEnd * gh._sideGbwtLen, gbwtLen);
+				gbwt.advanceM(M_node, M_off, rowEnd - rowBeg);
 			}
-			if(count) occ[gbwtChar]++;
-            if(M) M_occ++;
-			// Append BWT char to bwt section of current side
-			if(fw) {
-				// Forward bucket: fill from least to most
-#ifdef SIXTY4_FORMAT
-				gfmSide[sideCur] |= ((uint64_t)gbwtChar << (bpi << 1));
-				if(gbwtChar > 0) assert_gt(gfmSide[sideCur], 0);
-                // To be implemented ...
-                assert(false);
-                cerr << "Not implemented" << endl;
-                exit(1);
-#else
-				pack_2b_in_8b(gbwtChar, gfmSide[sideCur], bpi);
-				assert_eq((gfmSide[sideCur] >> (bpi*2)) & 3, gbwtChar);
-                
-                int F_sideCur = (gh._sideGbwtSz + sideCur) >> 1;
-                int F_bpi = bpi + ((sideCur & 0x1) << 2); // Can be used as M_bpi as well
-                pack_1b_in_8b(F, gfmSide[F_sideCur], F_bpi);
-                assert_eq((gfmSide[F_sideCur] >> F_bpi) & 1, F);
-                
-                int M_sideCur = F_sideCur + (gh._sideGbwtSz >> 2);
-                pack_1b_in_8b(M, gfmSide[M_sideCur], F_bpi);
-                assert_eq((gfmSide[M_sideCur] >> F_bpi) & 1, M);
-#endif
-			} else {
-				// Backward bucket: fill from most to least
-#ifdef SIXTY4_FORMAT
-				gfmSide[sideCur] |= ((uint64_t)gbwtChar << ((31 - bpi) << 1));
-				if(gbwtChar > 0) assert_gt(gfmSide[sideCur], 0);
-                // To be implemented ...
-                assert(false);
-                cerr << "Not implemented" << endl;
-                exit(1);
-#else
-				pack_2b_in_8b(gbwtChar, gfmSide[sideCur], 3-bpi);
-				assert_eq((gfmSide[sideCur] >> ((3-bpi)*2)) & 3, gbwtChar);
-                // To be implemented ...
-                assert(false);
-                cerr << "Not implemented" << endl;
-                exit(1);
-#endif
+		}
+		for(int t = 0; t < nruns; t++) {
+			threads[t] = new tthread::thread(gbwtRun_worker, (void*)&params[t]);
+		}
+		for(int t = 0; t < nruns; t++) {
+			threads[t]->join();
+			delete threads[t];
+		}
+		// Carry the state of the round's last run over to the next round
+		GbwtRunParam& last = params[nruns - 1];
+		for(int c = 0; c < 4; c++) occ[c] = last.occ[c] + last.cnt[c];
+		M_node = last.M_node;
+		M_off = last.M_off;
+		if(side < numSides) {
+			index_t rowBeg = last.sideBeg * gh._sideGbwtLen;
+			index_t rowEnd = min<index_t>(last.sideEnd * gh._sideGbwtLen, gbwtLen);
+			gbwt.advanceM(M_node, M_off, rowEnd - rowBeg);
+		}
+		// Write the round's sides, zOffs and SA samples in order
+		out1.write((const char *)_gfm.get() + roundBeg * sideSz, (side - roundBeg) * sideSz);
+		for(int t = 0; t < nruns; t++) {
+			GbwtRunParam& param = params[t];
+			for(int c = 0; c < 4; c++) fchr[c] += param.cnt[c];
+			for(index_t i = 0; i < param.zOffs.size(); i++) {
+				assert(zOffs.empty() || param.zOffs[i] > zOffs.back());
+				zOffs.push_back(param.zOffs[i]);
+			}
+			for(index_t i = 0; i < param.offs.size(); i++) {
+				// Write offsets directly to the secondary output stream
+				writeIndex<index_t>(out2, param.offs[i], this->toBe());
 			}
-		} // end loop over bit-pairs
-        assert_eq(0, (occ[0] + occ[1] + occ[2] + occ[3] + zOffs.size()) & 3);
-#ifdef SIXTY4_FORMAT
-		assert_eq(0, si & 31);
-#else
-		assert_eq(0, si & 3);
-#endif
-
-		sideCur++;
-		if((sideCur << 1) == (int)gh._sideGbwtSz) {
-			sideCur = 0;
-			index_t *uside = reinterpret_cast<index_t*>(gfmSide.ptr());
-			// Write 'A', 'C', 'G', 'T', and '1' in M tallies
-			side += sideSz;
-			assert_leq(side, gh._gbwtTotSz);
-            uside[(sideSz / sizeof(index_t))-6] = endianizeIndex(F_locSave, this->toBe());
-            uside[(sideSz / sizeof(index_t))-5] = endianizeIndex(M_occSave, this->toBe());
-			uside[(sideSz / sizeof(index_t))-4] = endianizeIndex(occSave[0], this->toBe());
-			uside[(sideSz / sizeof(index_t))-3] = endianizeIndex(occSave[1], this->toBe());
-			uside[(sideSz / sizeof(index_t))-2] = endianizeIndex(occSave[2], this->toBe());
-			uside[(sideSz / sizeof(index_t))-1] = endianizeIndex(occSave[3], this->toBe());
-            F_locSave = F_loc;
-            M_occSave = M_occ;
-			occSave[0] = occ[0];
-			occSave[1] = occ[1];
-			occSave[2] = occ[2];
-			occSave[3] = occ[3];
-			// Write backward side to primary file
-			out1.write((const char *)gfmSide.ptr(), sideSz);
-            
-            //
-            memcpy(((char*)_gfm.get()) + side - sideSz, (const char *)gfmSide.ptr(), sideSz);
 		}
 	}
 	VMSG_NL("Exited GFM loop");
 	// Assert that our loop counter got incremented right to the end
-	assert_eq(side, gh._gbwtTotSz);
+	assert_eq(side * sideSz, gh._gbwtTotSz);
 	// Assert that we wrote the expected amount to out1
 	assert_eq(((index_t)out1.tellp() - beforeGbwtOff), gh._gbwtTotSz);
-	// assert that the last thing we did was write a forward bucket
 
 	//
 	// Write zOffs to primary stream
@@ -4521,44 +5113,35 @@ void GFM<index_t>::buildToDisk(
     _zOffs = zOffs;
     postReadInit(gh);
 
-    // Build ftab and eftab
+    // Build ftab and eftab.  Each thread looks up a slice of the ftab
+    // entries; empty entries are marked and then filled in order.
     EList<pair<index_t, index_t> > tFtab;
     tFtab.resizeExact(ftabLen - 1);
-    for(index_t i = 0; i + 1 < ftabLen; i++) {
-        index_t q = i;
-        pair<index_t, index_t> range(0, gh._gbwtLen);
-        SideLocus<index_t> tloc, bloc;
-        SideLocus<index_t>::initFromTopBot(range.first, range.second, gh, gfm(), tloc, bloc);
-        index_t j = 0;
-        for(; j < (index_t)gh._ftabChars; j++) {
-            int nt = q & 0x3; q >>= 2;
-            if(bloc.valid()) {
-                range = mapGLF(tloc, bloc, nt);
-            } else {
-                range = mapGLF1(range.first, tloc, nt);
-            }
-            if(range.first == (index_t)INDEX_MAX || range.first >= range.second) {
-                break;
-            }
-            if(range.first + 1 == range.second) {
-                tloc.initFromRow(range.first, gh, gfm());
-                bloc.invalidate();
-            } else {
-                SideLocus<index_t>::initFromTopBot(range.first, range.second, gh, gfm(), tloc, bloc);
-            }
+    {
+        EList<GbwtFtabParam> ftabParams;
+        ftabParams.resizeExact(nthreads);
+        index_t per = (ftabLen - 1 + nthreads - 1) / nthreads;
+        for(int t = 0; t < nthreads; t++) {
+            GbwtFtabParam& param = ftabParams[t];
+            param.gfm = this;
+            param.tFtab = &tFtab;
+            param.begin = min<index_t>(per * t, ftabLen - 1);
+            param.end = min<index_t>(param.begin + per, ftabLen - 1);
+            threads[t] = new tthread::thread(gbwtFtab_worker, (void*)&param);
         }
-        
-        if(range.first >= range.second || j < (index_t)gh._ftabChars) {
+        for(int t = 0; t < nthreads; t++) {
+            threads[t]->join();
+            delete threads[t];
+        }
+    }
+    for(index_t i = 0; i + 1 < ftabLen; i++) {
+        if(tFtab[i].first == (index_t)INDEX_MAX) {
             if(i == 0) {
                 tFtab[i].first = tFtab[i].second = 0;
             } else {
                 tFtab[i].first = tFtab[i].second = tFtab[i-1].second;
             }
-        } else {
-            tFtab[i].first = range.first;
-            tFtab[i].second = range.second;
         }
-        
 #ifndef NDEBUG
         if(gbwt.ftab.size() > i) {
             assert_eq(tFtab[i].first, gbwt.ftab[i].first);
@@ -23,6 +23,9 @@
 #include "hier_idx_common.h"
 #include "gfm.h"
 
+// # local indexes a loader thread takes at a time when loading in parallel
+static const size_t local_gfm_load_batch = 64;
+
 /**
  * Extended Burrows-Wheeler transform data.
  * LocalEbwt is a specialized Ebwt index that represents ~64K bps
@@ -66,7 +69,8 @@ public:
              bool startVerbose, // = false,
              bool passMemExc, // = false,
              bool sanityCheck, // = false)
-             bool useHaplotype) : // = false
+             bool useHaplotype, // = false
+             bool justLayout = false) :
 	GFM<index_t>(in,
                  altdb,
                  needEntireReverse,
@@ -111,7 +115,8 @@ public:
 					   ftabChars,
 					   mmSweep,
 					   loadNames,
-					   startVerbose);
+					   startVerbose,
+					   justLayout);
 		
 		_tidx = tidx;
 		_localOffset = localOffset;
@@ -126,7 +131,7 @@ public:
 			this->_gh.setOffRate(this->_overrideOffRate);
 			assert_eq(this->_overrideOffRate, this->_gh._offRate);
 		}
-		assert(this->repOk());
+		assert(justLayout || this->repOk());
 	}
 
 
@@ -302,7 +307,8 @@ public:
 						int32_t ftabChars,
 						bool mmSweep, 
 						bool loadNames, 
-						bool startVerbose);
+						bool startVerbose,
+						bool justLayout);
 	
 	/**
 	 * Sanity-check various pieces of the Ebwt
@@ -1098,7 +1104,10 @@ void LocalGFM<index_t, full_index_t>::buildToDisk(
 }
     
 /**
- * Read an Ebwt from file with given filename.
+ * Read an Ebwt from file with given filename.  If 'justLayout' is set,
+ * only the header, plen, zOffs and fchr are read; everything else is
+ * seeked over and the size of the SA sample is added to 'bytesRead2', so
+ * the streams end up where the next local index starts.
  */
 template <typename index_t, typename full_index_t>
 void LocalGFM<index_t, full_index_t>::readIntoMemory(
@@ -1122,7 +1131,8 @@ void LocalGFM<index_t, full_index_t>::readIntoMemory(
                                                      int32_t ftabChars,
                                                      bool mmSweep,
                                                      bool loadNames,
-                                                     bool startVerbose)
+                                                     bool startVerbose,
+                                                     bool justLayout)
     {
 #ifdef BOWTIE_MM
 	char *mmFile[] = { mmFile5, mmFile6 };
@@ -1253,7 +1263,10 @@ void LocalGFM<index_t, full_index_t>::readIntoMemory(
 	}
 	
 	this->_gfm.reset();
-	if(this->_useMm) {
+	if(justLayout) {
+		bytesRead += this->_gh._gbwtTotLen;
+		fseek(in5, this->_gh._gbwtTotLen, SEEK_CUR);
+	} else if(this->_useMm) {
 #ifdef BOWTIE_MM
 		this->_gfm.init((uint8_t*)(mmFile[0] + bytesRead), this->_gh._gbwtTotLen, false);
 		bytesRead += this->_gh._gbwtTotLen;
@@ -1434,6 +1447,12 @@ void LocalGFM<index_t, full_index_t>::readIntoMemory(
 		throw 1;
 	}
 	
+	// Only the sizes were wanted; the .6 file holds offsLen offsets
+	if(justLayout) {
+		bytesRead2 += offsLen * sizeof(index_t);
+		return;
+	}
+	
 	this->_offs.reset();
 	if(loadSASamp) {
 		shmemLeader = true;
@@ -1652,7 +1671,9 @@ public:
                         bool loadFtab,
                         bool loadRstarts,
                         bool loadNames,
-                        bool verbose)
+                        bool verbose,
+                        int nthreads = 1,
+                        bool timing = false)
 	{
 		readIntoMemory(
                        needEntireReverse, // require reverse index to be concatenated reference reversed
@@ -1663,7 +1684,9 @@ public:
                        NULL,        // params
                        false,       // mmSweep
                        loadNames,   // loadNames
-                       verbose);    // startVerbose
+                       verbose,     // startVerbose
+                       nthreads,    // # loader threads
+                       timing);     // print time taken by each part?
 	}
 	
 	// I/O
@@ -1676,7 +1699,19 @@ public:
                         GFMParams<index_t> *params,
                         bool mmSweep,
                         bool loadNames,
-                        bool startVerbose);
+                        bool startVerbose,
+                        int nthreads = 1,
+                        bool timing = false);
+	void readLocalGFMs(
+                       int needEntireRev,
+                       bool loadSASamp,
+                       bool loadFtab,
+                       bool loadRstarts,
+                       bool justHeader,
+                       bool mmSweep,
+                       bool loadNames,
+                       bool startVerbose,
+                       int nthreads);
 	
 	/**
 	 * Frees memory associated with the Ebwt.
@@ -1780,12 +1815,75 @@ private:
         RefGraph<index_t>*           rg;
         PathGraph<index_t>*          pg;
         
-        // communication
+        // communication; done and last are guarded by *mutex and
+        // signalled on *cond, which all the workers share
         bool                         done;
         bool                         last;
         bool                         mainThread;
+        tthread::mutex*              mutex;
+        tthread::condition_variable* cond;
     };
     static void gbwt_worker(void* vp);
+
+    /**
+     * Loads the global index on a thread of its own while the local
+     * indexes are being loaded.
+     */
+    struct GlobalLoadParam {
+        HGFM*                        hgfm;
+        int                          needEntireRev;
+        bool                         loadSASamp;
+        bool                         loadFtab;
+        bool                         loadRstarts;
+        bool                         justHeader;
+        GFMParams<index_t>*          params;
+        bool                         mmSweep;
+        bool                         loadNames;
+        bool                         startVerbose;
+        bool                         timing;
+        bool                         failed;
+    };
+    static void globalLoad_worker(void* vp);
+
+    /**
+     * Shared by the threads loading the local indexes.  The main thread
+     * scans the headers in the .5 file to find where each local index
+     * starts in .5 and .6, and the loaders take batches of local indexes
+     * and read them with their own file handles as soon as their offsets
+     * are known.
+     */
+    struct LocalLoadState {
+        HGFM*                                     hgfm;
+        EList<LocalGFM<local_index_t, index_t>*>  gfms;     // one per local index, in file order
+        EList<pair<uint64_t, uint64_t> >          offs;     // start of each local index in .5 and .6
+        size_t                                    nscanned; // offs is known for [0, nscanned)
+        size_t                                    next;     // next local index to hand out
+        bool                                      failed;
+        tthread::mutex                            mutex_;   // guards nscanned, next and failed
+        tthread::condition_variable               cond_;    // signalled when nscanned or failed changes
+        int                                       needEntireRev;
+        bool                                      loadSASamp;
+        bool                                      loadFtab;
+        bool                                      loadRstarts;
+        bool                                      mmSweep;
+        bool                                      loadNames;
+        int32_t                                   lineRate;
+        int32_t                                   offRate;
+        int32_t                                   ftabChars;
+    };
+    static void localLoad_worker(void* vp);
+    static void localLoad_fail(LocalLoadState& st);
+    void readLocalGFMsParallel(
+                               int nthreads,
+                               int needEntireRev,
+                               bool loadSASamp,
+                               bool loadFtab,
+                               bool loadRstarts,
+                               bool mmSweep,
+                               bool loadNames,
+                               int32_t lineRate,
+                               int32_t offRate,
+                               int32_t ftabChars);
 };
 
     
@@ -1793,7 +1891,7 @@ template <typename index_t, typename local_index_t>
 void HGFM<index_t, local_index_t>::gbwt_worker(void* vp)
 {
     ThreadParam& tParam = *(ThreadParam*)vp;
-    while(!tParam.last) {
+    while(true) {
         if(tParam.mainThread) {
             assert(!tParam.done);
             if(tParam.s.length() <= 0) {
@@ -1801,17 +1899,17 @@ void HGFM<index_t, local_index_t>::gbwt_worker(void* vp)
                 return;
             }
         } else {
-            while(tParam.done) {
-                if(tParam.last) return;
-#if defined(_TTHREAD_WIN32_)
-                Sleep(1);
-#elif defined(_TTHREAD_POSIX_)
-                const static timespec ts = {0, 1000000};  // 1 millisecond
-                nanosleep(&ts, NULL);
-#endif
+            {
+                tthread::lock_guard<tthread::mutex> guard(*tParam.mutex);
+                while(tParam.done && !tParam.last) {
+                    tParam.cond->wait(*tParam.mutex);
+                }
+                if(tParam.done) return;
             }
             if(tParam.s.length() <= 0) {
+                tthread::lock_guard<tthread::mutex> guard(*tParam.mutex);
                 tParam.done = true;
+                tParam.cond->notify_all();
                 continue;
             }
         }
@@ -1896,8 +1994,13 @@ void HGFM<index_t, local_index_t>::gbwt_worker(void* vp)
             }
             break;
         }
+        if(tParam.mainThread) {
+            tParam.done = true;
+            break;
+        }
+        tthread::lock_guard<tthread::mutex> guard(*tParam.mutex);
         tParam.done = true;
-        if(tParam.mainThread) break;
+        tParam.cond->notify_all();
     }
 }
     
@@ -2164,9 +2267,13 @@ HGFM<index_t, local_index_t>::HGFM(
     
     assert_gt(this->_nthreads, 0);
     AutoArray<tthread::thread*> threads(this->_nthreads - 1);    
+    tthread::mutex gbwtMutex;
+    tthread::condition_variable gbwtCond;
     EList<ThreadParam> tParams;
     for(index_t t = 0; t < (index_t)this->_nthreads; t++) {
         tParams.expand();
+        tParams.back().mutex = &gbwtMutex;
+        tParams.back().cond = &gbwtCond;
         tParams.back().s.clear();
         tParams.back().rg = NULL;
         tParams.back().pg = NULL;
@@ -2293,7 +2400,13 @@ HGFM<index_t, local_index_t>::HGFM(
 
                 assert(tParam.rg == NULL);
                 assert(tParam.pg == NULL);
-                tParam.done = false;
+                if(tParam.mainThread) {
+                    tParam.done = false;
+                } else {
+                    tthread::lock_guard<tthread::mutex> guard(gbwtMutex);
+                    tParam.done = false;
+                    gbwtCond.notify_all();
+                }
                 curr_sztot += local_sztot_interval;
                 local_offset += local_index_interval;
                
@@ -2306,13 +2419,11 @@ HGFM<index_t, local_index_t>::HGFM(
             
             for(index_t t2 = 0; t2 < t; t2++) {
                 ThreadParam& tParam = tParams[t2];
-                while(!tParam.done) {
-#if defined(_TTHREAD_WIN32_)
-                    Sleep(1);
-#elif defined(_TTHREAD_POSIX_)
-                    const static timespec ts = {0, 1000000};  // 1 millisecond
-                    nanosleep(&ts, NULL);
-#endif
+                {
+                    tthread::lock_guard<tthread::mutex> guard(gbwtMutex);
+                    while(!tParam.done) {
+                        gbwtCond.wait(gbwtMutex);
+                    }
                 }
  
                 LocalGFM<local_index_t, index_t>(
@@ -2353,11 +2464,18 @@ HGFM<index_t, local_index_t>::HGFM(
     }
     assert_eq(curr_sztot, sztot);
     if(this->_nthreads > 1) {
+        {
+            tthread::lock_guard<tthread::mutex> guard(gbwtMutex);
+            for(index_t i = 0; i + 1 < (index_t)this->_nthreads; i++) {
+                tParams[i].last = true;
+            }
+            gbwtCond.notify_all();
+        }
         for(index_t i = 0; i + 1 < (index_t)this->_nthreads; i++) {
-            tParams[i].last = true;
             threads[i]->join();
         }
     }
+    if(this->_verbose) logMemPhase(cerr, "local indexes", this->_memModel.localIndexes());
     
     fout5 << '\0';
     fout5.flush(); fout6.flush();
@@ -2414,6 +2532,250 @@ HGFM<index_t, local_index_t>::HGFM(
 }
 
     
+template <typename index_t, typename local_index_t>
+void HGFM<index_t, local_index_t>::globalLoad_worker(void* vp)
+{
+    GlobalLoadParam& p = *(GlobalLoadParam*)vp;
+    try {
+        Timer _t(cerr, "  Time loading global index: ", p.timing, p.startVerbose || p.hgfm->_verbose);
+        p.hgfm->PARENT_CLASS::readIntoMemory(p.needEntireRev,
+                                             p.loadSASamp,
+                                             p.loadFtab,
+                                             p.loadRstarts,
+                                             p.justHeader,
+                                             p.params,
+                                             p.mmSweep,
+                                             p.loadNames,
+                                             p.startVerbose);
+    } catch(...) {
+        p.failed = true;
+    }
+}
+
+/**
+ * Mark the parallel load as failed and wake up any loader waiting for the
+ * scanner.
+ */
+template <typename index_t, typename local_index_t>
+void HGFM<index_t, local_index_t>::localLoad_fail(LocalLoadState& st)
+{
+    tthread::lock_guard<tthread::mutex> guard(st.mutex_);
+    st.failed = true;
+    st.cond_.notify_all();
+}
+
+template <typename index_t, typename local_index_t>
+void HGFM<index_t, local_index_t>::localLoad_worker(void* vp)
+{
+    LocalLoadState& st = *(LocalLoadState*)vp;
+    const HGFM& hgfm = *st.hgfm;
+    FILE *in5 = fopen(hgfm._in5Str.c_str(), "rb");
+    FILE *in6 = st.loadSASamp ? fopen(hgfm._in6Str.c_str(), "rb") : NULL;
+    if(in5 == NULL || (st.loadSASamp && in6 == NULL)) {
+        cerr << "Could not open index file " << (in5 == NULL ? hgfm._in5Str.c_str() : hgfm._in6Str.c_str()) << endl;
+        localLoad_fail(st);
+    }
+    try {
+        while(true) {
+            size_t beg, end;
+            {
+                tthread::lock_guard<tthread::mutex> guard(st.mutex_);
+                if(st.failed) break;
+                beg = st.next;
+                end = min<size_t>(beg + local_gfm_load_batch, st.gfms.size());
+                st.next = end;
+            }
+            if(beg >= end) break;
+            for(size_t i = beg; i < end; i++) {
+                pair<uint64_t, uint64_t> off;
+                {
+                    tthread::lock_guard<tthread::mutex> guard(st.mutex_);
+                    while(st.nscanned <= i && !st.failed) {
+                        st.cond_.wait(st.mutex_);
+                    }
+                    if(st.failed) break;
+                    off = st.offs[i];
+                }
+                // Local indexes are stored back to back, so only the first
+                // of a batch needs a seek
+                if(i == beg) {
+                    fseek64(in5, (int64_t)off.first, SEEK_SET);
+                    if(in6 != NULL) fseek64(in6, (int64_t)off.second, SEEK_SET);
+                }
+                index_t tidx = 0, localOffset = 0, joinedOffset = 0;
+                size_t bytesRead = 0, bytesRead2 = 0;
+                st.gfms[i] = new LocalGFM<local_index_t, index_t>(string(""),
+                                                                  NULL,
+                                                                  in5,
+                                                                  in6,
+                                                                  NULL,
+                                                                  NULL,
+                                                                  tidx,
+                                                                  localOffset,
+                                                                  joinedOffset,
+                                                                  false,  // switchEndian
+                                                                  bytesRead,
+                                                                  bytesRead2,
+                                                                  st.needEntireRev,
+                                                                  hgfm.fw_,
+                                                                  -1, // overrideOffRate
+                                                                  -1, // offRatePlus
+                                                                  (uint32_t)st.lineRate,
+                                                                  (uint32_t)st.offRate,
+                                                                  (uint32_t)st.ftabChars,
+                                                                  false,  // useMm
+                                                                  false,  // useShmem
+                                                                  st.mmSweep,
+                                                                  st.loadNames,
+                                                                  st.loadSASamp,
+                                                                  st.loadFtab,
+                                                                  st.loadRstarts,
+                                                                  false,  // _verbose
+                                                                  false,
+                                                                  hgfm._passMemExc,
+                                                                  hgfm._sanity,
+                                                                  false); // use haplotypes?
+            }
+        }
+    } catch(...) {
+        localLoad_fail(st);
+    }
+    if(in5 != NULL) fclose(in5);
+    if(in6 != NULL) fclose(in6);
+}
+
+/**
+ * Load the local indexes with 'nthreads' threads.  The layout of the .5
+ * and .6 files is not indexed, so the main thread reads the local indexes
+ * with LocalGFM in layout-only mode to find their offsets, while
+ * the other threads load the ones found so far.  The main thread joins
+ * in once it is done scanning.  Only used for heap loading without
+ * switching endianness.
+ */
+template <typename index_t, typename local_index_t>
+void HGFM<index_t, local_index_t>::readLocalGFMsParallel(
+                                                         int nthreads,
+                                                         int needEntireRev,
+                                                         bool loadSASamp,
+                                                         bool loadFtab,
+                                                         bool loadRstarts,
+                                                         bool mmSweep,
+                                                         bool loadNames,
+                                                         int32_t lineRate,
+                                                         int32_t offRate,
+                                                         int32_t ftabChars)
+{
+    LocalLoadState st;
+    st.hgfm = this;
+    st.gfms.resizeExact(_nlocalGFMs);
+    st.gfms.fill(NULL);
+    st.offs.resizeExact(_nlocalGFMs);
+    st.nscanned = 0;
+    st.next = 0;
+    st.failed = false;
+    st.needEntireRev = needEntireRev;
+    st.loadSASamp = loadSASamp;
+    st.loadFtab = loadFtab;
+    st.loadRstarts = loadRstarts;
+    st.mmSweep = mmSweep;
+    st.loadNames = loadNames;
+    st.lineRate = lineRate;
+    st.offRate = offRate;
+    st.ftabChars = ftabChars;
+
+    AutoArray<tthread::thread*> threads(nthreads - 1);
+    for(int t = 0; t + 1 < nthreads; t++) {
+        threads[t] = new tthread::thread(localLoad_worker, (void*)&st);
+    }
+
+    // Scan with a small buffer, letting the LocalGFM reader walk each
+    // local index in layout-only mode
+    uint64_t pos5 = (uint64_t)ftell64(_in5), pos6 = 4;
+    FILE *scan = fopen(_in5Str.c_str(), "rb");
+    if(scan == NULL) {
+        cerr << "Could not open index file " << _in5Str.c_str() << endl;
+        localLoad_fail(st);
+    } else {
+        setvbuf(scan, NULL, _IOFBF, 4096);
+        fseek64(scan, (int64_t)pos5, SEEK_SET);
+    }
+    for(size_t i = 0; i < _nlocalGFMs && scan != NULL; i++) {
+        pair<uint64_t, uint64_t> off(pos5, pos6);
+        index_t tidx = 0, localOffset = 0, joinedOffset = 0;
+        size_t bytesRead = 0, bytesRead2 = 0;
+        try {
+            LocalGFM<local_index_t, index_t> layout(string(""),
+                                                    NULL,
+                                                    scan,
+                                                    NULL,
+                                                    NULL,
+                                                    NULL,
+                                                    tidx,
+                                                    localOffset,
+                                                    joinedOffset,
+                                                    false,  // switchEndian
+                                                    bytesRead,
+                                                    bytesRead2,
+                                                    needEntireRev,
+                                                    this->fw_,
+                                                    -1, // overrideOffRate
+                                                    -1, // offRatePlus
+                                                    (uint32_t)lineRate,
+                                                    (uint32_t)offRate,
+                                                    (uint32_t)ftabChars,
+                                                    false,  // useMm
+                                                    false,  // useShmem
+                                                    false,  // mmSweep
+                                                    false,  // loadNames
+                                                    false,  // loadSASamp
+                                                    false,  // loadFtab
+                                                    false,  // loadRstarts
+                                                    false,  // _verbose
+                                                    false,
+                                                    this->_passMemExc,
+                                                    false,  // sanityCheck
+                                                    false,  // use haplotypes?
+                                                    true);  // justLayout
+        } catch(...) {
+            localLoad_fail(st);
+            break;
+        }
+        if(feof(scan) || ferror(scan)) {
+            cerr << "Error reading local index headers from " << _in5Str.c_str() << endl;
+            localLoad_fail(st);
+            break;
+        }
+        pos5 = (uint64_t)ftell64(scan);
+        pos6 += bytesRead2;
+        tthread::lock_guard<tthread::mutex> guard(st.mutex_);
+        if(st.failed) break;
+        st.offs[i] = off;
+        st.nscanned = i + 1;
+        st.cond_.notify_all();
+    }
+    if(scan != NULL) fclose(scan);
+    localLoad_worker((void*)&st);
+    for(int t = 0; t + 1 < nthreads; t++) {
+        threads[t]->join();
+        delete threads[t];
+    }
+    if(st.failed) {
+        for(size_t i = 0; i < st.gfms.size(); i++) {
+            if(st.gfms[i] != NULL) delete st.gfms[i];
+        }
+        throw 1;
+    }
+    for(size_t i = 0; i < st.gfms.size(); i++) {
+        index_t tidx = st.gfms[i]->_tidx;
+        if(tidx >= _localGFMs.size()) {
+            assert_eq(tidx, _localGFMs.size());
+            _localGFMs.expand();
+        }
+        assert_eq(tidx + 1, _localGFMs.size());
+        _localGFMs.back().push_back(st.gfms[i]);
+    }
+}
+    
 /**
  * Read an Ebwt from file with given filename.
  */
@@ -2427,18 +2789,66 @@ void HGFM<index_t, local_index_t>::readIntoMemory(
                                                   GFMParams<index_t> *params,
                                                   bool mmSweep,
                                                   bool loadNames,
-                                                  bool startVerbose)
+                                                  bool startVerbose,
+                                                  int nthreads,
+                                                  bool timing)
+{
+    // The global index is in the .1 and .2 files and the local indexes in
+    // the .5 and .6 files, so with more than one thread they are read at
+    // the same time
+    GlobalLoadParam gparam;
+    gparam.hgfm = this;
+    gparam.needEntireRev = needEntireRev;
+    gparam.loadSASamp = loadSASamp;
+    gparam.loadFtab = loadFtab;
+    gparam.loadRstarts = loadRstarts;
+    gparam.justHeader = justHeader || needEntireRev == 1;
+    gparam.params = params;
+    gparam.mmSweep = mmSweep;
+    gparam.loadNames = loadNames;
+    gparam.startVerbose = startVerbose;
+    gparam.timing = timing;
+    gparam.failed = false;
+    bool parallel = nthreads > 1 && !this->_useMm && !this->useShmem_;
+    tthread::thread *gthread = NULL;
+    if(parallel) {
+        gthread = new tthread::thread(globalLoad_worker, (void*)&gparam);
+    } else {
+        globalLoad_worker((void*)&gparam);
+        if(gparam.failed) throw 1;
+    }
+    try {
+        Timer _t(cerr, "  Time loading local indexes: ", timing, startVerbose || this->_verbose);
+        readLocalGFMs(needEntireRev, loadSASamp, loadFtab, loadRstarts, justHeader, mmSweep, loadNames, startVerbose, parallel ? nthreads : 1);
+    } catch(...) {
+        if(gthread != NULL) {
+            gthread->join();
+            delete gthread;
+        }
+        throw;
+    }
+    if(gthread != NULL) {
+        gthread->join();
+        delete gthread;
+        if(gparam.failed) throw 1;
+    }
+}
+
+/**
+ * Read the local indexes from the .5 and .6 files.
+ */
+template <typename index_t, typename local_index_t>
+void HGFM<index_t, local_index_t>::readLocalGFMs(
+                                                 int needEntireRev,
+                                                 bool loadSASamp,
+                                                 bool loadFtab,
+                                                 bool loadRstarts,
+                                                 bool justHeader,
+                                                 bool mmSweep,
+                                                 bool loadNames,
+                                                 bool startVerbose,
+                                                 int nthreads)
 {
-    PARENT_CLASS::readIntoMemory(needEntireRev,
-                                 loadSASamp,
-                                 loadFtab,
-                                 loadRstarts,
-                                 justHeader || needEntireRev == 1,
-                                 params,
-                                 mmSweep,
-                                 loadNames,
-                                 startVerbose);
-    
     bool switchEndian; // dummy; caller doesn't care
 #ifdef BOWTIE_MM
 	char *mmFile[] = { NULL, NULL };
@@ -2567,48 +2977,61 @@ void HGFM<index_t, local_index_t>::readIntoMemory(
 	
 	clearLocalGFMs();
 	
-    index_t tidx = 0, localOffset = 0, joinedOffset = 0;
-    string base = "";
-	for(size_t i = 0; i < _nlocalGFMs; i++) {
-		LocalGFM<local_index_t, index_t> *localGFM = new LocalGFM<local_index_t, index_t>(base,
-                                                                                          NULL,
-                                                                                          _in5,
-                                                                                          _in6,
-                                                                                          mmFile5_,
-                                                                                          mmFile6_,
-                                                                                          tidx,
-                                                                                          localOffset,
-                                                                                          joinedOffset,
-                                                                                          switchEndian,
-                                                                                          bytesRead,
-                                                                                          bytesRead2,
-                                                                                          needEntireRev,
-                                                                                          this->fw_,
-                                                                                          -1, // overrideOffRate
-                                                                                          -1, // offRatePlus
-                                                                                          (uint32_t)lineRate,
-                                                                                          (uint32_t)offRate,
-                                                                                          (uint32_t)ftabChars,
-                                                                                          this->_useMm,
-                                                                                          this->useShmem_,
-                                                                                          mmSweep,
-                                                                                          loadNames,
-                                                                                          loadSASamp,
-                                                                                          loadFtab,
-                                                                                          loadRstarts,
-                                                                                          false,  // _verbose
-                                                                                          false,
-                                                                                          this->_passMemExc,
-                                                                                          this->_sanity,
-                                                                                          false); // use haplotypes?
+    if(nthreads > 1 && _nlocalGFMs > 1 && !switchEndian) {
+        readLocalGFMsParallel(nthreads,
+                              needEntireRev,
+                              loadSASamp,
+                              loadFtab,
+                              loadRstarts,
+                              mmSweep,
+                              loadNames,
+                              lineRate,
+                              offRate,
+                              ftabChars);
+    } else {
+        index_t tidx = 0, localOffset = 0, joinedOffset = 0;
+        string base = "";
+		for(size_t i = 0; i < _nlocalGFMs; i++) {
+			LocalGFM<local_index_t, index_t> *localGFM = new LocalGFM<local_index_t, index_t>(base,
+                                                                                              NULL,
+                                                                                              _in5,
+                                                                                              _in6,
+                                                                                              mmFile5_,
+                                                                                              mmFile6_,
+                                                                                              tidx,
+                                                                                              localOffset,
+                                                                                              joinedOffset,
+                                                                                              switchEndian,
+                                                                                              bytesRead,
+                                                                                              bytesRead2,
+                                                                                              needEntireRev,
+                                                                                              this->fw_,
+                                                                                              -1, // overrideOffRate
+                                                                                              -1, // offRatePlus
+                                                                                              (uint32_t)lineRate,
+                                                                                              (uint32_t)offRate,
+                                                                                              (uint32_t)ftabChars,
+                                                                                              this->_useMm,
+                                                                                              this->useShmem_,
+                                                                                              mmSweep,
+                                                                                              loadNames,
+                                                                                              loadSASamp,
+                                                                                              loadFtab,
+                                                                                              loadRstarts,
+                                                                                              false,  // _verbose
+                                                                                              false,
+                                                                                              this->_passMemExc,
+                                                                                              this->_sanity,
+                                                                                              false); // use haplotypes?
         
-		if(tidx >= _localGFMs.size()) {
-			assert_eq(tidx, _localGFMs.size());
-			_localGFMs.expand();
-		}
-		assert_eq(tidx + 1, _localGFMs.size());
-		_localGFMs.back().push_back(localGFM);
-	}	
+			if(tidx >= _localGFMs.size()) {
+				assert_eq(tidx, _localGFMs.size());
+				_localGFMs.expand();
+			}
+			assert_eq(tidx + 1, _localGFMs.size());
+			_localGFMs.back().push_back(localGFM);
+		}	
+    }
 		
 #ifdef BOWTIE_MM
     fseek(_in5, 0, SEEK_SET);
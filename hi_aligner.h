@@ -43,6 +43,8 @@
 #include "group_walk.h"
 #include "tp.h"
 #include "gp.h"
+#include "splice_scan.h"
+#include "stage_timer.h"
 
 // Allow longer introns for long anchored reads involving canonical splice sites
 inline uint32_t MaxIntronLen(uint32_t anchor, uint32_t minAnchorLen) {
@@ -396,11 +398,13 @@ struct SharedTempVars {
     SStringExpandable<char> raw_refbuf2;
     EList<int64_t> temp_scores;
     EList<int64_t> temp_scores2;
+    EList<uint8_t> temp_spldirs;
     
     // Align with alternatives
     EList<pair<index_t, int> >      ssOffs;
     EList<pair<index_t, int> >      offDiffs;
     EList<SStringExpandable<char> > raw_refbufs;
+    PackedDnaString                 rfpacked;
     EList<Edit>                     alt_edits;
     ELList<Edit, 128, 4>            candidate_edits;
     ELList<pair<index_t, index_t> > ht_llist;
@@ -675,6 +679,7 @@ struct GenomeHit {
                                  const EList<index_t>&             haplotype_maxrights,
                                  index_t                           joinedOff,
                                  const BTDnaString&                rdseq,
+                                 const PackedDnaString*            rdpacked,
                                  index_t                           base_rdoff,
                                  index_t                           rdoff,
                                  index_t                           rdlen,
@@ -709,11 +714,13 @@ struct GenomeHit {
                             haplotype_maxrights,
                             joinedOff,
                             rdseq,
+                            rdpacked,
                             rdoff - base_rdoff,
                             rdoff,
                             rdlen,
                             ref,
                             sharedVar.raw_refbufs,
+                            sharedVar.rfpacked,
                             ASSERT_ONLY(sharedVar.destU32,)
                             alt_edits,
                             best_rdoff,
@@ -772,6 +779,30 @@ struct GenomeHit {
         return extlen;
     }
     
+    /*
+     * Unpack 'rflen' reference characters starting at 'rfoff' (which may
+     * be negative; those positions are Ns) into 'raw_refbuf'
+     */
+    static const char* getRefStretch(
+                                     const BitPairReference&           ref,
+                                     SStringExpandable<char>&          raw_refbuf,
+                                     index_t                           tidx,
+                                     int                               rfoff,
+                                     index_t                           rflen
+                                     ASSERT_ONLY(, SStringExpandable<uint32_t>& destU32))
+    {
+        raw_refbuf.resize(rflen + 16 + 16);
+        raw_refbuf.fill(0x4);
+        int off = ref.getStretch(
+                                 reinterpret_cast<uint32_t*>(raw_refbuf.wbuf() + 16),
+                                 tidx,
+                                 max<int>(rfoff, 0),
+                                 rfoff > 0 ? rflen : rflen + rfoff
+                                 ASSERT_ONLY(, destU32));
+        assert_lt(off, 16);
+        return raw_refbuf.wbuf() + 16 + off + min<int>(rfoff, 0);
+    }
+    
     /*
      *
      */
@@ -781,11 +812,13 @@ struct GenomeHit {
                                        const EList<index_t>&             haplotype_maxrights,
                                        index_t                           joinedOff,
                                        const BTDnaString&                rdseq,
+                                       const PackedDnaString*            rdpacked,
                                        index_t                           rdoff_add,
                                        index_t                           rdoff,
                                        index_t                           rdlen,
                                        const BitPairReference&           ref,
                                        EList<SStringExpandable<char> >&  raw_refbufs,
+                                       PackedDnaString&                  rfpacked,
                                        ASSERT_ONLY(SStringExpandable<uint32_t> destU32,)
                                        EList<Edit>&                      tmp_edits,
                                        int&                              best_rdoff,
@@ -900,7 +933,7 @@ struct GenomeHit {
             assert(rd != NULL);
             assert(sc != NULL);
             *score = 0;
-            qual = &(_fw ? rd->qual : rd->qualRev);
+            qual = &(_fw ? rd->qual : rd->qualRev());
         }
         for(index_t i = 0; i < _edits->size(); i++) {
             const Edit& edit = (*_edits)[i];
@@ -943,7 +976,7 @@ struct GenomeHit {
             assert(rd != NULL);
             assert(sc != NULL);
             *score = 0;
-            qual = &(_fw ? rd->qual  : rd->qualRev);
+            qual = &(_fw ? rd->qual  : rd->qualRev());
         }
         if(_edits->size() == 0) return;
         for(int i = (int)_edits->size() - 1; i >= 0; i--) {
@@ -1391,7 +1424,7 @@ bool GenomeHit<index_t>::combineWith(
     
     // calculate the maximum gap lengths based on the current score and the mimumimu alignment score to be reported
     const BTDnaString& seq = this->_fw ? rd.patFw : rd.patRc;
-    const BTString& qual = this->_fw ? rd.qual : rd.qualRev;
+    const BTString& qual = this->_fw ? rd.qual : rd.qualRev();
     index_t rdlen = (index_t)seq.length();
     int64_t remainsc = minsc - (_score - this_score) - (otherHit._score - other_score);
     if(remainsc > 0) remainsc = 0;
@@ -1417,6 +1450,7 @@ bool GenomeHit<index_t>::combineWith(
     SStringExpandable<char>& raw_refbuf = _sharedVars->raw_refbuf;
     EList<int64_t>& temp_scores = _sharedVars->temp_scores;
     EList<int64_t>& temp_scores2 = _sharedVars->temp_scores2;
+    EList<uint8_t>& temp_spldirs = _sharedVars->temp_spldirs;
     ASSERT_ONLY(SStringExpandable<uint32_t>& destU32 = _sharedVars->destU32);
     raw_refbuf.resize(len + this_ref_ext + 16);
     int off = ref.getStretch(
@@ -1451,42 +1485,11 @@ bool GenomeHit<index_t>::combineWith(
         temp_scores.resize(len);
         temp_scores2.resize(len);
         if(spliced) {
-            static const char GT   = 0x23, AG   = 0x02;
-            static const char GTrc = 0x01, AGrc = 0x13;
-            static const char GC   = 0x21, GCrc = 0x21;
-            static const char AT   = 0x03, AC   = 0x01;
-            static const char ATrc = 0x03, ACrc = 0x20;
-            int i;
-            for(i = 0; i < (int)len; i++) {
-                int rdc = seq[this_rdoff + i], rfc = refbuf[i];
-                if(i > 0) {
-                    temp_scores[i] = temp_scores[i-1];
-                } else {
-                    temp_scores[i] = 0;
-                }
-                if(rdc != rfc) {
-                    temp_scores[i] += sc.score(rdc, 1 << rfc, qual[this_rdoff + i] - 33);
-                }
-                if(temp_scores[i] < remainsc) {
-                    break;
-                }
-            }
+            int i = spliceScanPrefix(seq.buf() + this_rdoff, qual.buf() + this_rdoff, refbuf,
+                                     (int)len, sc, remainsc, temp_scores.ptr());
             int i_limit = min<int>(i, len);
-            int i2;
-            for(i2 = len - 1; i2 >= 0; i2--) {
-                int rdc = seq[this_rdoff + i2], rfc = refbuf2[i2];
-                if((index_t)(i2 + 1) < len) {
-                    temp_scores2[i2] = temp_scores2[i2+1];
-                } else {
-                    temp_scores2[i2] = 0;
-                }
-                if(rdc != rfc) {
-                    temp_scores2[i2] += sc.score(rdc, 1 << rfc, qual[this_rdoff + i2] - 33);
-                }
-                if(temp_scores2[i2] < remainsc) {
-                    break;
-                }
-            }
+            int i2 = spliceScanSuffix(seq.buf() + this_rdoff, qual.buf() + this_rdoff, refbuf2,
+                                      (int)len, sc, remainsc, temp_scores2.ptr());
             int i2_limit = max<int>(i2, 0);
             if(spliceSite != NULL){
                 assert_leq(this_toff, (int)spliceSite->left());
@@ -1497,34 +1500,26 @@ bool GenomeHit<index_t>::combineWith(
                     i_limit = i2_limit;
                 }
             }
+            // classify the donor and acceptor dinucleotides of all breakpoints at once;
+            //    breakpoints whose donor or acceptor lies outside the reference stretches have none
+            int bp_lo = i2_limit, bp_hi = min<int>(i_limit, (int)len - 1);
+            temp_spldirs.resize(max<int>(bp_hi - bp_lo, 0));
+            temp_spldirs.fill(SPL_UNKNOWN);
+            int motif_lo = max<int>(bp_lo, 1 - other_ref_ext);
+            int motif_hi = min<int>(bp_hi, (int)(len + this_ref_ext) - 2);
+            if(motif_lo < motif_hi) {
+                spliceScanMotifs(refbuf + 1 + motif_lo,
+                                 refbuf2 - 1 + motif_lo,
+                                 motif_hi - motif_lo,
+                                 temp_spldirs.ptr() + (motif_lo - bp_lo));
+            }
             for(i = i2_limit, i2 = i2_limit + 1;
                 i < i_limit && i2 < (int)len;
                 i++, i2++) {
                 int64_t tempscore = temp_scores[i] + temp_scores2[i2];
-                char donor = 0xff, acceptor = 0xff;
-                if((index_t)(i + 2) < len + this_ref_ext) {
-                    donor = refbuf[i + 1];
-                    donor = (donor << 4) | refbuf[i + 2];
-                }
-                if(i2 - 2 >= -other_ref_ext) {
-                    acceptor = refbuf2[i2 - 2];
-                    acceptor = (acceptor << 4) | refbuf2[i2 - 1];
-                }
-                bool canonical = false, semi_canonical = false;
-                uint32_t spldir = SPL_UNKNOWN;
-                if((donor == GT && acceptor == AG) /* || (donor == AT && acceptor == AC) */) {
-                    spldir = SPL_FW;
-                    canonical = true;
-                } else if((donor == AGrc && acceptor == GTrc) /* || (donor == ACrc && acceptor == ATrc) */) {
-                    spldir = SPL_RC;
-                    canonical = true;
-                } else if((donor == GC && acceptor == AG) || (donor == AT && acceptor == AC)) {
-                    spldir = SPL_SEMI_FW;
-                    semi_canonical = true;
-                } else if((donor == AGrc && acceptor == GCrc) || (donor == ACrc && acceptor == ATrc)) {
-                    spldir = SPL_SEMI_RC;
-                    semi_canonical = true;
-                }
+                uint32_t spldir = temp_spldirs[i - bp_lo];
+                bool canonical = (spldir == SPL_FW || spldir == SPL_RC);
+                bool semi_canonical = (spldir == SPL_SEMI_FW || spldir == SPL_SEMI_RC);
                 tempscore -= (canonical ? sc.canSpl() : sc.noncanSpl());
                 int64_t temp_donor_seq = 0, temp_acceptor_seq = 0;
                 float splscore = 0.0f;
@@ -1615,37 +1610,11 @@ bool GenomeHit<index_t>::combineWith(
                 gap_penalty = -(sc.readGapOpen() + sc.readGapExtend() * (dellen - 1));
             }
             if(gap_penalty < remainsc) return false;
-            int i;
-            for(i = 0; i < (int)len; i++) {
-                int rdc = seq[this_rdoff + i], rfc = refbuf[i];
-                if(i > 0) {
-                    temp_scores[i] = temp_scores[i-1];
-                } else {
-                    temp_scores[i] = 0;
-                }
-                if(rdc != rfc) {
-                    temp_scores[i] += sc.score(rdc, 1 << rfc, qual[this_rdoff + i] - 33);
-                }
-                if(temp_scores[i] + gap_penalty < remainsc) {
-                    break;
-                }
-            }
+            int i = spliceScanPrefix(seq.buf() + this_rdoff, qual.buf() + this_rdoff, refbuf,
+                                     (int)len, sc, remainsc - gap_penalty, temp_scores.ptr());
             int i_limit = min<int>(i, len);
-            int i2;
-            for(i2 = len - 1; i2 >= 0; i2--) {
-                int rdc = seq[this_rdoff + i2], rfc = refbuf2[i2];
-                if((index_t)(i2 + 1) < len) {
-                    temp_scores2[i2] = temp_scores2[i2+1];
-                } else {
-                    temp_scores2[i2] = 0;
-                }
-                if(rdc != rfc) {
-                    temp_scores2[i2] += sc.score(rdc, 1 << rfc, qual[this_rdoff + i2] - 33);
-                }
-                if(temp_scores2[i2] + gap_penalty < remainsc) {
-                    break;
-                }
-            }
+            int i2 = spliceScanSuffix(seq.buf() + this_rdoff, qual.buf() + this_rdoff, refbuf2,
+                                      (int)len, sc, remainsc - gap_penalty, temp_scores2.ptr());
             int i2_limit = (i2 < inslen ? 0 : i2 - inslen);
             for(i = i2_limit, i2 = i2_limit + 1 + inslen;
                 i < i_limit && i2 < (int)len;
@@ -1924,6 +1893,7 @@ bool GenomeHit<index_t>::extend(
     // extend the alignment further in the left direction
     // with 'mm' mismatches allowed
     const BTDnaString& seq = _fw ? rd.patFw : rd.patRc;
+    const PackedDnaString& seqpacked = _fw ? rd.patFwPacked : rd.patRcPacked;
     if(max_leftext > 0 && _rdoff > 0) {
         assert_gt(_rdoff, 0);
         index_t left_rdoff, left_len, left_toff;
@@ -1947,6 +1917,7 @@ bool GenomeHit<index_t>::extend(
                                          altdb.haplotype_maxrights(),
                                          this->_joinedOff,
                                          seq,
+                                         &seqpacked,
                                          this->_rdoff - 1,
                                          this->_rdoff - 1,
                                          this->_rdoff,
@@ -2028,6 +1999,7 @@ bool GenomeHit<index_t>::extend(
                                              altdb.haplotype_maxrights(),
                                              this->_joinedOff + ref_ext,
                                              seq,
+                                             &seqpacked,
                                              this->_rdoff,
                                              this->_rdoff + this->_len,
                                              rdlen - (this->_rdoff + this->_len),
@@ -2156,6 +2128,7 @@ bool GenomeHit<index_t>::adjustWithALT(
         findOffDiffs(gfm, altdb, (genomeHit._joinedOff >= width ? genomeHit._joinedOff - width : 0), genomeHit._joinedOff + width, offDiffs);
         
         const BTDnaString& seq = genomeHit._fw ? rd.patFw : rd.patRc;
+        const PackedDnaString& seqpacked = genomeHit._fw ? rd.patFwPacked : rd.patRcPacked;
         const EList<ALT<index_t> >& alts = altdb.alts();
         
         index_t orig_joinedOff = genomeHit._joinedOff;
@@ -2197,6 +2170,7 @@ bool GenomeHit<index_t>::adjustWithALT(
                                                altdb.haplotype_maxrights(),
                                                genomeHit._joinedOff,
                                                seq,
+                                               &seqpacked,
                                                genomeHit._rdoff,
                                                genomeHit._rdoff,
                                                genomeHit._len,
@@ -2265,6 +2239,7 @@ bool GenomeHit<index_t>::adjustWithALT(
     findOffDiffs(gfm, altdb, (this->_joinedOff >= width ? this->_joinedOff - width : 0), this->_joinedOff + width, offDiffs);
     
     const BTDnaString& seq = _fw ? rd.patFw : rd.patRc;
+    const PackedDnaString& seqpacked = _fw ? rd.patFwPacked : rd.patRcPacked;
     const EList<ALT<index_t> >& alts = altdb.alts();
     
     index_t orig_joinedOff = this->_joinedOff;
@@ -2303,6 +2278,7 @@ bool GenomeHit<index_t>::adjustWithALT(
                                            altdb.haplotype_maxrights(),
                                            this->_joinedOff,
                                            seq,
+                                           &seqpacked,
                                            this->_rdoff,
                                            this->_rdoff,
                                            this->_len,
@@ -2590,11 +2566,13 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
                                                 const EList<index_t>&             haplotype_maxrights,
                                                 index_t                           joinedOff,
                                                 const BTDnaString&                rdseq,
+                                                const PackedDnaString*            rdpacked,
                                                 index_t                           rdoff_add,
                                                 index_t                           rdoff,
                                                 index_t                           rdlen,
                                                 const BitPairReference&           ref,
                                                 EList<SStringExpandable<char> >&  raw_refbufs,
+                                                PackedDnaString&                  rfpacked,
                                                 ASSERT_ONLY(SStringExpandable<uint32_t> destU32,)
                                                 EList<Edit>&                      tmp_edits,
                                                 int&                              best_rdoff,
@@ -2629,18 +2607,14 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
         rflen = contig_len;
     }
     if(rflen == 0) return 0;
-    if(rfseq == NULL) {
-        SStringExpandable<char>& raw_refbuf = raw_refbufs[dep];
-        raw_refbuf.resize(rflen + 16 + 16);
-        raw_refbuf.fill(0x4);
-        int off = ref.getStretch(
-                                 reinterpret_cast<uint32_t*>(raw_refbuf.wbuf() + 16),
-                                 tidx,
-                                 max<int>(rfoff, 0),
-                                 rfoff > 0 ? rflen : rflen + rfoff
-                                 ASSERT_ONLY(, destU32));
-        assert_lt(off, 16);
-        rfseq = raw_refbuf.wbuf() + 16 + off + min<int>(rfoff, 0);
+    // Compare the read with the reference 32 bases at a time without
+    // unpacking the reference; it is only unpacked below if ALTs have to
+    // be tried
+    bool packed = (rfseq == NULL && rdpacked != NULL && rdpacked->length() == rdseq.length());
+    if(packed) {
+        ref.getPackedStretch(rfpacked, tidx, rfoff, rflen);
+    } else if(rfseq == NULL) {
+        rfseq = getRefStretch(ref, raw_refbufs[dep], tidx, rfoff, rflen ASSERT_ONLY(, destU32));
     }
     
     if(left) {
@@ -2648,25 +2622,65 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
         int min_rd_i = (int)rdoff;
         int mm_min_rd_i = (int)rdoff;
         index_t mm_tmp_numNs = 0;
-        for(int rf_i = (int)rflen - 1; rf_i >= 0 && mm_min_rd_i >= 0; rf_i--, mm_min_rd_i--) {
-            int rf_bp = rfseq[rf_i];
-            int rd_bp = rdseq[mm_min_rd_i];
-            if(rf_bp != rd_bp || rd_bp == 4) {
-                if(tmp_mm == 0) {
-                    min_rd_i = mm_min_rd_i;
+        if(packed) {
+            // Visit only the mismatches, from the right end leftwards:
+            // step k compares read position rdoff - k with reference
+            // position rflen - 1 - k
+            int n = min<int>((int)rflen, (int)rdoff + 1);
+            bool stop = false;
+            for(int k = 0; k < n && !stop; k += 32) {
+                int w = min<int>(32, n - k);
+                int rdlo = (int)rdoff - k - w + 1, rflo = (int)rflen - k - w;
+                uint64_t mms = PackedDnaString::mismatches(
+                                                           rdpacked->bases(rdlo), rdpacked->ns(rdlo),
+                                                           rfpacked.bases(rflo), rfpacked.ns(rflo),
+                                                           w);
+                while(mms != 0) {
+                    int bit = PackedDnaString::highestBit(mms);
+                    mms &= ~((uint64_t)1 << bit);
+                    mm_min_rd_i = rdlo + (bit >> 1);
+                    int rf_bp = rfpacked.get(rflo + (bit >> 1));
+                    int rd_bp = rdpacked->get(mm_min_rd_i);
+                    if(tmp_mm == 0) {
+                        min_rd_i = mm_min_rd_i;
+                    }
+                    if(tmp_mm >= mm) {
+                        stop = true;
+                        break;
+                    }
+                    tmp_mm++;
+                    Edit e(
+                           mm_min_rd_i,
+                           "ACGTN"[rf_bp],
+                           "ACGTN"[rd_bp],
+                           EDIT_TYPE_MM);
+                    tmp_edits.insert(e, 0);
+                    // A reference N is always a mismatch
+                    if(rf_bp == 4) mm_tmp_numNs++;
                 }
-                if(tmp_mm >= mm) break;
-                tmp_mm++;
-                Edit e(
-                       mm_min_rd_i,
-                       "ACGTN"[rf_bp],
-                       "ACGTN"[rd_bp],
-                       EDIT_TYPE_MM);
-                tmp_edits.insert(e, 0);
             }
-            if(rf_bp == 4) {
-                if(tmp_mm == 0) tmp_numNs++;
-                mm_tmp_numNs++;
+            if(!stop) mm_min_rd_i = (int)rdoff - n;
+        } else {
+            for(int rf_i = (int)rflen - 1; rf_i >= 0 && mm_min_rd_i >= 0; rf_i--, mm_min_rd_i--) {
+                int rf_bp = rfseq[rf_i];
+                int rd_bp = rdseq[mm_min_rd_i];
+                if(rf_bp != rd_bp || rd_bp == 4) {
+                    if(tmp_mm == 0) {
+                        min_rd_i = mm_min_rd_i;
+                    }
+                    if(tmp_mm >= mm) break;
+                    tmp_mm++;
+                    Edit e(
+                           mm_min_rd_i,
+                           "ACGTN"[rf_bp],
+                           "ACGTN"[rd_bp],
+                           EDIT_TYPE_MM);
+                    tmp_edits.insert(e, 0);
+                }
+                if(rf_bp == 4) {
+                    if(tmp_mm == 0) tmp_numNs++;
+                    mm_tmp_numNs++;
+                }
             }
         }
         if(tmp_mm == 0) {
@@ -2678,6 +2692,9 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
             if(numNs != NULL) *numNs = mm_tmp_numNs;
         }
         if(mm_min_rd_i < 0) return rdlen;
+        if(rfseq == NULL) {
+            rfseq = getRefStretch(ref, raw_refbufs[dep], tidx, rfoff, rflen ASSERT_ONLY(, destU32));
+        }
         if(tmp_mm > 0) {
             tmp_edits.erase(0, tmp_mm);
             tmp_mm = 0;
@@ -2958,11 +2975,13 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
                                                          haplotype_maxrights,
                                                          next_joinedOff,
                                                          rdseq,
+                                                         rdpacked,
                                                          rdoff_add,
                                                          next_rdoff,
                                                          next_rdlen,
                                                          ref,
                                                          raw_refbufs,
+                                                         rfpacked,
                                                          ASSERT_ONLY(destU32,)
                                                          tmp_edits,
                                                          best_rdoff,
@@ -2994,25 +3013,64 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
         index_t max_rd_i = 0;
         index_t mm_max_rd_i = 0;
         index_t mm_tmp_numNs = 0;
-        for(index_t rf_i = 0; rf_i < rflen && mm_max_rd_i < rdlen; rf_i++, mm_max_rd_i++) {
-            int rf_bp = rfseq[rf_i];
-            int rd_bp = rdseq[rdoff + mm_max_rd_i];
-            if(rf_bp != rd_bp || rd_bp == 4) {
-                if(tmp_mm == 0) {
-                    max_rd_i = mm_max_rd_i;
+        if(packed) {
+            // Visit only the mismatches, from the left end rightwards:
+            // step k compares read position rdoff + k with reference
+            // position k
+            index_t n = min<index_t>(rflen, rdlen);
+            bool stop = false;
+            for(index_t k = 0; k < n && !stop; k += 32) {
+                index_t w = min<index_t>(32, n - k);
+                uint64_t mms = PackedDnaString::mismatches(
+                                                           rdpacked->bases(rdoff + k), rdpacked->ns(rdoff + k),
+                                                           rfpacked.bases(k), rfpacked.ns(k),
+                                                           w);
+                while(mms != 0) {
+                    int bit = PackedDnaString::lowestBit(mms);
+                    mms &= mms - 1;
+                    mm_max_rd_i = k + (bit >> 1);
+                    int rf_bp = rfpacked.get(mm_max_rd_i);
+                    int rd_bp = rdpacked->get(rdoff + mm_max_rd_i);
+                    if(tmp_mm == 0) {
+                        max_rd_i = mm_max_rd_i;
+                    }
+                    if(tmp_mm >= mm) {
+                        stop = true;
+                        break;
+                    }
+                    tmp_mm++;
+                    Edit e(
+                           mm_max_rd_i + rdoff_add,
+                           "ACGTN"[rf_bp],
+                           "ACGTN"[rd_bp],
+                           EDIT_TYPE_MM);
+                    tmp_edits.push_back(e);
+                    // A reference N is always a mismatch
+                    if(rf_bp == 4) mm_tmp_numNs++;
                 }
-                if(tmp_mm >= mm) break;
-                tmp_mm++;
-                Edit e(
-                       mm_max_rd_i + rdoff_add,
-                       "ACGTN"[rf_bp],
-                       "ACGTN"[rd_bp],
-                       EDIT_TYPE_MM);
-                tmp_edits.push_back(e);
             }
-            if(rf_bp == 4) {
-                if(tmp_mm == 0) tmp_numNs++;
-                mm_tmp_numNs++;
+            if(!stop) mm_max_rd_i = n;
+        } else {
+            for(index_t rf_i = 0; rf_i < rflen && mm_max_rd_i < rdlen; rf_i++, mm_max_rd_i++) {
+                int rf_bp = rfseq[rf_i];
+                int rd_bp = rdseq[rdoff + mm_max_rd_i];
+                if(rf_bp != rd_bp || rd_bp == 4) {
+                    if(tmp_mm == 0) {
+                        max_rd_i = mm_max_rd_i;
+                    }
+                    if(tmp_mm >= mm) break;
+                    tmp_mm++;
+                    Edit e(
+                           mm_max_rd_i + rdoff_add,
+                           "ACGTN"[rf_bp],
+                           "ACGTN"[rd_bp],
+                           EDIT_TYPE_MM);
+                    tmp_edits.push_back(e);
+                }
+                if(rf_bp == 4) {
+                    if(tmp_mm == 0) tmp_numNs++;
+                    mm_tmp_numNs++;
+                }
             }
         }
         if(tmp_mm == 0) {
@@ -3067,6 +3125,9 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
             }
             if(!further_search) return mm_max_rd_i;
         }
+        if(rfseq == NULL) {
+            rfseq = getRefStretch(ref, raw_refbufs[dep], tidx, rfoff, rflen ASSERT_ONLY(, destU32));
+        }
         if(tmp_mm > 0) {
             tmp_edits.resize(tmp_edits.size() - tmp_mm);
             tmp_mm = 0;
@@ -3317,11 +3378,13 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
                                                          haplotype_maxrights,
                                                          next_joinedOff,
                                                          rdseq,
+                                                         rdpacked,
                                                          rdoff_add + rd_i,
                                                          next_rdoff,
                                                          next_rdlen,
                                                          ref,
                                                          raw_refbufs,
+                                                         rfpacked,
                                                          ASSERT_ONLY(destU32,)
                                                          tmp_edits,
                                                          best_rdoff,
@@ -3549,7 +3612,7 @@ int64_t GenomeHit<index_t>::calculateScore(
     index_t numsplices = 0;
     index_t mm = 0;
     const BTDnaString& seq = _fw ? rd.patFw : rd.patRc;
-    const BTString& qual = _fw ? rd.qual : rd.qualRev;
+    const BTString& qual = _fw ? rd.qual : rd.qualRev();
     index_t rdlen = (index_t)seq.length();
     int64_t toff_base = _toff;
     bool conflict_splicesites = false;
@@ -3721,6 +3784,7 @@ int64_t GenomeHit<index_t>::calculateScore(
 struct HIMetrics {
     
 	HIMetrics() : mutex_m() {
+	    LOCK_SITE(mutex_m, "HIMetrics");
 	    reset();
 	}
     
@@ -3732,6 +3796,8 @@ struct HIMetrics {
         localsearchrecur = 0;
         globalgenomecoords = 0;
         localgenomecoords = 0;
+        mateatts = 0;
+        stages.reset();
 	}
 	
 	void init(
@@ -3766,6 +3832,8 @@ struct HIMetrics {
         localsearchrecur += r.localsearchrecur;
         globalgenomecoords += r.globalgenomecoords;
         localgenomecoords += r.localgenomecoords;
+        mateatts += r.mateatts;
+        stages.merge(r.stages);
     }
 	   
     uint64_t localatts;      // # attempts of local search
@@ -3775,6 +3843,8 @@ struct HIMetrics {
     uint64_t localsearchrecur;
     uint64_t globalgenomecoords;
     uint64_t localgenomecoords;
+    uint64_t mateatts;       // # attempts of mate search (alignMate)
+    StageMetrics stages;     // ticks spent in each pipeline stage
 	
 	MUTEX_T mutex_m;
 };
@@ -3796,14 +3866,20 @@ public:
                bool anchorStop = true,
                bool secondary = false,
                bool local = false,
-               uint64_t threads_rids_mindist = 0) :
+               uint64_t threads_rids_mindist = 0,
+               uint64_t ss_epoch = 0) :
     _anchorStop(anchorStop),
     _secondary(secondary),
     _local(local),
     _gwstate(GW_CAT),
     _gwstate_local(GW_CAT),
-    _thread_rids_mindist(threads_rids_mindist)
+    _thread_rids_mindist(threads_rids_mindist),
+    _ss_epoch(ss_epoch)
     {
+        bwops_ = bwedits_ = 0;
+        _maxFmops = _maxExts = _maxUsecs = 0;
+        _overBudget = false;
+        _stageMet = NULL;
         index_t genomeLen = gfm.gh().len();
         _minK = 0;
         while(genomeLen > 0) {
@@ -3816,6 +3892,26 @@ public:
     HI_Aligner() {
     }
     
+    /**
+     * Limit the work done for each read or pair to 'maxFmops' FM index
+     * operations, 'maxExts' extension attempts and 'maxUsecs' microseconds
+     * (0: no limit).  A read or pair that runs out is reported with the
+     * alignments found so far.
+     */
+    void setBudget(uint64_t maxFmops, uint64_t maxExts, uint64_t maxUsecs) {
+        _maxFmops = maxFmops;
+        _maxExts = maxExts;
+        _maxUsecs = maxUsecs;
+    }
+    
+    /**
+     * Return the read id below which novel splice sites found by other
+     * reads may be used to align read 'rdid'.
+     */
+    uint64_t novelSpliceSiteBound(uint64_t rdid) const {
+        return ::novelSpliceSiteBound(rdid, _thread_rids_mindist, _ss_epoch);
+    }
+    
     /**
      */
     void initRead(Read *rd, bool nofw, bool norc, TAlScore minsc, TAlScore maxpen, bool rightendonly = false) {
@@ -3891,10 +3987,13 @@ public:
         index_t rdi;
         bool fw;
         bool found[2] = {true, this->_paired};
+        startBudget(him);
+        _stageMet = &him.stages;
         // given read and its reverse complement
         //  (and mate and the reverse complement of mate in case of pair alignment),
         // pick up one with best partial alignment
-        while(nextBWT(sc, pepol, tpol, gpol, gfm, altdb, ref, rdi, fw, wlm, prm, him, rnd, sink)) {
+        while(!overBudget(him) &&
+              nextBWT(sc, pepol, tpol, gpol, gfm, altdb, ref, rdi, fw, wlm, prm, him, rnd, sink)) {
             // given the partial alignment, try to extend it to full alignments
         	found[rdi] = align(sc, pepol, tpol, gpol, gfm, altdb, ref, swa, ssdb, rdi, fw, wlm, prm, swm, him, rnd, sink);
             if(!found[0] && !found[1]) {
@@ -3920,7 +4019,26 @@ public:
                 sink.getUnp2(rs[1]); assert(rs[1] != NULL);
                 index_t rs_size[2] = {(index_t)rs[0]->size(), (index_t)rs[1]->size()};
                 for(index_t i = 0; i < 2; i++) {
+                    // alignMate only looks at the reference, offset and
+                    // orientation of an alignment; skip alignments that
+                    // repeat an earlier one in all three
+                    _mateKeys.clear();
+                    for(index_t j = 0; j < rs_size[i]; j++) {
+                        const AlnRes& res = (*rs[i])[j];
+                        _mateKeys.push_back(make_pair(make_pair(res.refid(), res.refoff()),
+                                                      make_pair(res.orient() == 1, j)));
+                    }
+                    _mateKeys.sort();
+                    _mateSkip.resize(rs_size[i]);
+                    for(index_t k = 0; k < _mateKeys.size(); k++) {
+                        _mateSkip[_mateKeys[k].second.second] =
+                            (k > 0 &&
+                             _mateKeys[k].first == _mateKeys[k-1].first &&
+                             _mateKeys[k].second.first == _mateKeys[k-1].second.first);
+                    }
                     for(index_t j = 0; j < rs_size[i]; j++) {
+                        if(overBudget(him)) break;
+                        if(_mateSkip[j]) continue;
                         const AlnRes& res = (*rs[i])[j];
                         bool fw = (res.orient() == 1);
                         mate_found |= alignMate(
@@ -3952,9 +4070,51 @@ public:
             }
         }
         
+        if(_overBudget) {
+            prm.overBudget = true;
+            return EXTEND_EXCEEDED_HARD_LIMIT;
+        }
         return EXTEND_POLICY_FULFILLED;
     }
     
+    /**
+     * Return the number of FM index operations done so far.
+     */
+    uint64_t fmops() const { return bwops_; }
+    
+    /**
+     * Start counting the work done for a new read or pair against the
+     * budget.
+     */
+    void startBudget(const HIMetrics& him) {
+        _budgetFmops = bwops_;
+        _budgetExts = him.localsearchrecur;
+        _budgetChecks = 0;
+        _overBudget = false;
+        if(_maxUsecs > 0) gettimeofday(&_budgetStart, NULL);
+    }
+    
+    /**
+     * Return true iff the current read or pair has used up its budget (see
+     * setBudget).  Once it has, it stays over budget until the next
+     * initRead(s).  The clock is only read every few calls.
+     */
+    bool overBudget(const HIMetrics& him) {
+        if(_overBudget) return true;
+        if(_maxFmops > 0 && bwops_ - _budgetFmops >= _maxFmops) {
+            _overBudget = true;
+        } else if(_maxExts > 0 && him.localsearchrecur - _budgetExts >= _maxExts) {
+            _overBudget = true;
+        } else if(_maxUsecs > 0 && (++_budgetChecks & 15) == 0) {
+            struct timeval tv;
+            gettimeofday(&tv, NULL);
+            uint64_t usecs = (uint64_t)(tv.tv_sec - _budgetStart.tv_sec) * 1000000 +
+                             (tv.tv_usec - _budgetStart.tv_usec);
+            _overBudget = (usecs >= _maxUsecs);
+        }
+        return _overBudget;
+    }
+    
     /**
      * Given a read or its reverse complement (or mate),
      * align the unmapped portion using the global FM index
@@ -4500,6 +4660,10 @@ public:
     void addSearched(const GenomeHit<index_t>&       hit,
                      index_t                         rdi);
     
+    /**
+     * Pool that the edits of reported alignments are allocated from
+     **/
+    LinkedEList<EList<Edit> >& rawEdits() { return _rawEdits; }
     
 protected:
   
@@ -4543,6 +4707,15 @@ protected:
     
     EList<pair<index_t, index_t> >  _concordantPairs;
     
+    // temporary, for pairReads
+    EList<pair<pair<TRefId, TRefOff>, index_t> > _pairSorted;
+    EList<pair<index_t, index_t> >               _pairFound;
+    EList<index_t>                               _pairCands;
+    
+    // temporary, for the alignMate calls in go
+    EList<pair<pair<TRefId, TRefOff>, pair<bool, index_t> > > _mateKeys;
+    EList<bool>                                               _mateSkip;
+    
     size_t _minK; // log4 of the size of a genome
     size_t _minK_local; // log4 of the size of a local index (8)
 
@@ -4553,10 +4726,23 @@ protected:
 	uint64_t bwops_;                    // Burrows-Wheeler operations
 	uint64_t bwedits_;                  // Burrows-Wheeler edits
     
+    // per-read budget (0: no limit) and what the current read has used
+    uint64_t       _maxFmops;
+    uint64_t       _maxExts;
+    uint64_t       _maxUsecs;
+    uint64_t       _budgetFmops;   // bwops_ when the read started
+    uint64_t       _budgetExts;    // him.localsearchrecur when the read started
+    struct timeval _budgetStart;
+    uint32_t       _budgetChecks;
+    bool           _overBudget;
+    
+    StageMetrics*  _stageMet;      // where to charge per-stage ticks
+    
     //
     EList<GenomeHit<index_t> >     _hits_searched[2];
 
     uint64_t   _thread_rids_mindist;
+    uint64_t   _ss_epoch;           // reads per splice site epoch; 0 = none
     
     //
     EList<pair<index_t, index_t> > _node_iedge_count;
@@ -4714,6 +4900,8 @@ bool HI_Aligner<index_t, local_index_t>::alignMate(
                                                    index_t                          tidx,
                                                    index_t                          toff)
 {
+    StageTimer stageTimer(_stageMet, STAGE_EXTEND);
+    him.mateatts++;
     assert_lt(rdi, 2);
     index_t ordi = 1 - rdi;
     bool ofw = (fw == gMate2fw ? gMate1fw : gMate2fw);
@@ -4896,6 +5084,7 @@ bool HI_Aligner<index_t, local_index_t>::getGenomeCoords(
                                                          bool                       rejectStraddle,
                                                          bool&                      straddled)
 {
+    StageTimer stageTimer(_stageMet, STAGE_RESOLVE);
     straddled = false;
     assert_gt(bot, top);
     assert_leq(node_bot - node_top, bot - top);
@@ -4979,6 +5168,7 @@ bool HI_Aligner<index_t, local_index_t>::getGenomeCoords_local(
                                                                bool                         rejectStraddle,
                                                                bool&                        straddled)
 {
+    StageTimer stageTimer(_stageMet, STAGE_RESOLVE);
     straddled = false;
     assert_gt(bot, top);
     assert_leq(node_bot - node_top, bot - top);
@@ -5061,21 +5251,54 @@ bool HI_Aligner<index_t, local_index_t>::pairReads(
                                                    RandomSource&              rnd,
                                                    AlnSinkWrap<index_t>&      sink)
 {
+    StageTimer stageTimer(_stageMet, STAGE_PAIR);
     assert(_paired);
     const EList<AlnRes> *rs1 = NULL, *rs2 = NULL;
     sink.getUnp1(rs1); assert(rs1 != NULL);
     sink.getUnp2(rs2); assert(rs2 != NULL);
+    if(rs1->empty() || rs2->empty()) return true;
+    // Sort mate 2's alignments by reference and leftmost offset, so that each
+    // alignment of mate 1 is only compared with those that lie close enough
+    // to pair with it.  Mate 2 may lie to the left of mate 1 by at most its
+    // own extent plus the maximum intron length, and to the right of mate
+    // 1's right end by at most the maximum intron length.
+    _pairSorted.clear();
+    TRefOff maxExt2 = 0;
+    for(index_t j = 0; j < rs2->size(); j++) {
+        const AlnRes& r2 = (*rs2)[j];
+        _pairSorted.push_back(make_pair(make_pair(r2.refid(), r2.refoff()), j));
+        maxExt2 = max<TRefOff>(maxExt2, (TRefOff)r2.refExtent());
+    }
+    _pairSorted.sort();
+    // Pairs found by earlier calls; those found by this call are never
+    // looked at again
+    _pairFound.clear();
+    for(index_t k = 0; k < _concordantPairs.size(); k++) {
+        _pairFound.push_back(_concordantPairs[k]);
+    }
+    _pairFound.sort();
+    const TRefOff maxIntronLen = (TRefOff)tpol.maxIntronLen();
     for(index_t i = 0; i < rs1->size(); i++) {
-        for(index_t j = 0; j < rs2->size(); j++) {
-            bool exists = false;
-            for(index_t k = 0; k < _concordantPairs.size(); k++) {
-                const pair<index_t, index_t>& p = _concordantPairs[k];
-                if(i == p.first && j == p.second) {
-                    exists = true;
-                    break;
-                }
+        const AlnRes& r1i = (*rs1)[i];
+        TRefOff lo = r1i.refoff() - maxExt2 - maxIntronLen;
+        TRefOff hi = r1i.refoff() + (TRefOff)r1i.refExtent() + maxIntronLen;
+        size_t k = _pairSorted.bsearchLoBound(make_pair(make_pair(r1i.refid(), lo), (index_t)0));
+        // Visit the candidates in the order of mate 2's alignments, as
+        // that decides which pairs are reported
+        _pairCands.clear();
+        for(; k < _pairSorted.size(); k++) {
+            const pair<TRefId, TRefOff>& key = _pairSorted[k].first;
+            if(key.first != r1i.refid() || key.second > hi) break;
+            _pairCands.push_back(_pairSorted[k].second);
+        }
+        _pairCands.sort();
+        for(index_t c = 0; c < _pairCands.size(); c++) {
+            index_t j = _pairCands[c];
+            if(!_pairFound.empty()) {
+                pair<index_t, index_t> ij(i, j);
+                size_t f = _pairFound.bsearchLoBound(ij);
+                if(f < _pairFound.size() && _pairFound[f] == ij) continue;
             }
-            if(exists) continue;
             if(sink.state().doneConcordant()) return true;
             const AlnRes& r1 = (*rs1)[i];
             Coord left = r1.refcoord(), right = r1.refcoord_right();
@@ -5196,7 +5419,8 @@ bool HI_Aligner<index_t, local_index_t>::reportHit(
                                                 right,
                                                 left,
                                                 right,
-                                                true); // include novel splice sites
+                                                true, // include novel splice sites
+                                                _ss_epoch > 0 ? novelSpliceSiteBound(rd.rdid) : std::numeric_limits<uint64_t>::max());
             if(altdb.hasExons()) {
                 spliced.second = ssdb.insideExon(hit.ref(), hit.refoff(), hit.refoff() + hit.len() - 1);
             }
@@ -5445,6 +5669,7 @@ index_t HI_Aligner<index_t, local_index_t>::partialSearch(
                                                           bool&                     pseudogeneStop,
                                                           bool&                     anchorStop)
 {
+    StageTimer stageTimer(_stageMet, STAGE_GLOBAL);
     bool pseudogeneStop_ = pseudogeneStop, anchorStop_ = anchorStop;
     pseudogeneStop = anchorStop = false;
 	const index_t ftabLen = gfm.gh().ftabChars();
@@ -5839,6 +6064,7 @@ index_t HI_Aligner<index_t, local_index_t>::localGFMSearch(
                                                            local_index_t                    minUniqueLen,
                                                            local_index_t                    maxHitLen)
 {
+    StageTimer stageTimer(_stageMet, STAGE_LOCAL);
     bool uniqueStop_ = uniqueStop;
     uniqueStop = false;
     const local_index_t ftabLen = (local_index_t)gfm.gh().ftabChars();
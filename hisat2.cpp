@@ -27,6 +27,7 @@
 #include <math.h>
 #include <utility>
 #include <limits>
+#include <memory>
 #include "alphabet.h"
 #include "assert_helpers.h"
 #include "endian_swap.h"
@@ -55,6 +56,12 @@
 #include "presets.h"
 #include "opts.h"
 #include "outq.h"
+#include "read_dump.h"
+#include "aligner_dup.h"
+#include "slow_reads.h"
+#include "live_status.h"
+#include "cpu_affinity.h"
+#include "read_epoch.h"
 
 using namespace std;
 
@@ -276,6 +283,7 @@ static size_t extra_opts_cur;
 static EList<uint64_t> thread_rids;
 static MUTEX_T         thread_rids_mutex;
 static uint64_t        thread_rids_mindist;
+static uint64_t        thread_rids_epoch; // reads per splice site epoch; 0 = none
 
 static bool rmChrName;  // remove "chr" from reference names (e.g., chr18 to 18)
 static bool addChrName; // add "chr" to reference names (e.g., 18 to chr18)
@@ -287,6 +295,23 @@ static bool enable_codis;
 static bool templateLenAdjustment;
 static string alignSumFile; // write alignment summary stat. to this file
 static bool newAlignSummary;
+static string readDumpFiles[READ_DUMP_NCAT]; // --un/--al/--un-conc/--al-conc/--al-conc-disc paths
+static int readDumpCompress[READ_DUMP_NCAT]; // READ_DUMP_PLAIN/GZIP/BZIP2
+static size_t dupCacheSlots; // # slots in the duplicate read cache; 0 = off
+static uint64_t maxReadFmops; // per-read budget of FM index ops; 0 = no limit
+static uint64_t maxReadExts;  // per-read budget of extension attempts; 0 = no limit
+static uint64_t maxReadUsecs; // per-read budget of microseconds; 0 = no limit
+static string slowReadsFile;  // write the slowest reads/pairs to this file
+static size_t slowReadsN;     // # slowest reads/pairs to keep
+static uint64_t slowReadsUsecs; // only keep reads/pairs that took at least this long
+static string statusFile;     // write a JSON progress snapshot to this file
+static int statusIval;        // seconds between progress snapshots
+static bool cpuPin;           // pin worker threads to CPUs
+static string cpuList;        // CPUs to pin worker threads to, in order; empty = by topology
+static CpuPlacement cpuPlacement;
+static bool deterministic;    // output independent of thread count and timing
+static uint64_t deterministicEpoch; // reads per splice site epoch with --deterministic
+static ReadEpochBarrier readEpochs;
 
 #define DMAX std::numeric_limits<double>::max()
 
@@ -513,6 +538,23 @@ static void resetOptions() {
     templateLenAdjustment = true;
     alignSumFile = "";
     newAlignSummary = false;
+	for(int i = 0; i < READ_DUMP_NCAT; i++) {
+		readDumpFiles[i].clear();
+		readDumpCompress[i] = READ_DUMP_PLAIN;
+	}
+	dupCacheSlots = 0;
+	maxReadFmops = 0;
+	maxReadExts = 0;
+	maxReadUsecs = 0;
+	slowReadsFile = "";
+	slowReadsN = 100;
+	slowReadsUsecs = 0;
+	statusFile = "";
+	statusIval = 10;
+	cpuPin = false;
+	cpuList = "";
+	deterministic = false;
+	deterministicEpoch = 10000;
 }
 
 static const char *short_options = "fF:qbzhcu:rv:s:aP:t3:5:w:p:k:M:1:2:I:X:CQ:N:i:L:U:x:S:g:O:D:R:";
@@ -734,6 +776,34 @@ static struct option long_options[] = {
     {(char*)"enable-codis",    no_argument,        0,        ARG_CODIS},
     {(char*)"summary-file",    required_argument,  0,        ARG_SUMMARY_FILE},
     {(char*)"new-summary",     no_argument,        0,        ARG_NEW_SUMMARY},
+    {(char*)"un",              required_argument,  0,        ARG_UN},
+    {(char*)"un-gz",           required_argument,  0,        ARG_UN_GZ},
+    {(char*)"un-bz2",          required_argument,  0,        ARG_UN_BZ2},
+    {(char*)"al",              required_argument,  0,        ARG_AL},
+    {(char*)"al-gz",           required_argument,  0,        ARG_AL_GZ},
+    {(char*)"al-bz2",          required_argument,  0,        ARG_AL_BZ2},
+    {(char*)"un-conc",         required_argument,  0,        ARG_UN_CONC},
+    {(char*)"un-conc-gz",      required_argument,  0,        ARG_UN_CONC_GZ},
+    {(char*)"un-conc-bz2",     required_argument,  0,        ARG_UN_CONC_BZ2},
+    {(char*)"al-conc",         required_argument,  0,        ARG_AL_CONC},
+    {(char*)"al-conc-gz",      required_argument,  0,        ARG_AL_CONC_GZ},
+    {(char*)"al-conc-bz2",     required_argument,  0,        ARG_AL_CONC_BZ2},
+    {(char*)"al-conc-disc",    required_argument,  0,        ARG_AL_CONC_DISC},
+    {(char*)"al-conc-disc-gz", required_argument,  0,        ARG_AL_CONC_DISC_GZ},
+    {(char*)"al-conc-disc-bz2",required_argument,  0,        ARG_AL_CONC_DISC_BZ2},
+    {(char*)"dup-cache",       required_argument,  0,        ARG_DUP_CACHE},
+    {(char*)"max-read-fmops",  required_argument,  0,        ARG_MAX_READ_FMOPS},
+    {(char*)"max-read-exts",   required_argument,  0,        ARG_MAX_READ_EXTS},
+    {(char*)"max-read-usecs",  required_argument,  0,        ARG_MAX_READ_USECS},
+    {(char*)"slow-reads",      required_argument,  0,        ARG_SLOW_READS},
+    {(char*)"slow-reads-n",    required_argument,  0,        ARG_SLOW_READS_N},
+    {(char*)"slow-reads-usecs",required_argument,  0,        ARG_SLOW_READS_USECS},
+    {(char*)"status-file",     required_argument,  0,        ARG_STATUS_FILE},
+    {(char*)"status-ival",     required_argument,  0,        ARG_STATUS_IVAL},
+    {(char*)"pin",             no_argument,        0,        ARG_CPU_PIN},
+    {(char*)"cpu-list",        required_argument,  0,        ARG_CPU_LIST},
+    {(char*)"deterministic",   no_argument,        0,        ARG_DETERMINISTIC},
+    {(char*)"deterministic-epoch", required_argument, 0,     ARG_DETERMINISTIC_EPOCH},
 	{(char*)0, 0, 0, 0} // terminator
 };
 
@@ -907,14 +977,12 @@ static void printUsage(ostream& out) {
 	//	out << "  --bam              output directly to BAM (by piping through 'samtools view')" << endl;
 	//}
 	out << "  -t/--time          print wall-clock time taken by search phases" << endl;
-	if(wrapper == "basic-0") {
 	out << "  --un <path>           write unpaired reads that didn't align to <path>" << endl
 	    << "  --al <path>           write unpaired reads that aligned at least once to <path>" << endl
 	    << "  --un-conc <path>      write pairs that didn't align concordantly to <path>" << endl
 	    << "  --al-conc <path>      write pairs that aligned concordantly at least once to <path>" << endl
 	    << "  (Note: for --un, --al, --un-conc, or --al-conc, add '-gz' to the option name, e.g." << endl
 		<< "  --un-gz <path>, to gzip compress output, or add '-bz2' to bzip2 compress output.)" << endl;
-	}
     out << "  --summary-file <path> print alignment summary to this file." << endl
         << "  --new-summary         print alignment summary in a new style, which is more machine-friendly." << endl
         << "  --quiet               print nothing to stderr except serious errors" << endl
@@ -922,8 +990,12 @@ static void printUsage(ostream& out) {
 		<< "  --met-file <path>     send metrics to file at <path> (off)" << endl
 		<< "  --met-stderr          send metrics to stderr (off)" << endl
 		<< "  --met <int>           report internal counters & metrics every <int> secs (1)" << endl
-	// Following is supported in the wrapper instead
-	//  << "  --no-unal             suppress SAM records for unaligned reads" << endl
+		<< "  --slow-reads <path>   write the slowest reads/pairs and their work to <path> (off)" << endl
+		<< "  --slow-reads-n <int>  # slowest reads/pairs to keep (100)" << endl
+		<< "  --slow-reads-usecs <int> only keep reads/pairs taking >= <int> microseconds (0)" << endl
+		<< "  --status-file <path>  write a JSON progress snapshot to <path> periodically (off)" << endl
+		<< "  --status-ival <int>   write the progress snapshot every <int> secs (10)" << endl
+	    << "  --no-unal             suppress SAM records for unaligned reads" << endl
 	    << "  --no-head             suppress header lines, i.e. lines starting with @" << endl
 	    << "  --no-sq               suppress @SQ header lines" << endl
 	    << "  --rg-id <text>        set read group id, reflected in @RG line and RG:Z: opt field" << endl
@@ -934,7 +1006,15 @@ static void printUsage(ostream& out) {
 	    << " Performance:" << endl
 	    << "  -o/--offrate <int> override offrate of index; must be >= index's offrate" << endl
 	    << "  -p/--threads <int> number of alignment threads to launch (1)" << endl
+	    << "  --pin              pin threads to CPUs, physical cores of one NUMA node first" << endl
+	    << "  --cpu-list <list>  pin threads to these CPUs in order, e.g. 0-3,8 (implies --pin)" << endl
 	    << "  --reorder          force SAM output order to match order of input reads" << endl
+	    << "  --deterministic    same output for any -p; novel splice sites used in epochs of reads" << endl
+	    << "  --deterministic-epoch <int>  reads per epoch with --deterministic (10000)" << endl
+	    << "  --dup-cache <int>  reuse alignments of exact duplicate reads/pairs; <int> slots (0: off)" << endl
+	    << "  --max-read-fmops <int>  stop searching a read/pair after <int> FM index ops (0: no limit)" << endl
+	    << "  --max-read-exts <int>   stop searching a read/pair after <int> extension attempts (0: no limit)" << endl
+	    << "  --max-read-usecs <int>  stop searching a read/pair after <int> microseconds (0: no limit)" << endl
 #ifdef BOWTIE_MM
 	    << "  --mm               use memory-mapped I/O for index; many 'hisat2's can share" << endl
 #endif
@@ -1714,6 +1794,73 @@ static void parseOption(int next_option, const char *arg) {
         case ARG_NEW_SUMMARY: {
             newAlignSummary = true;
             break;
+        }
+        case ARG_UN:
+        case ARG_UN_GZ:
+        case ARG_UN_BZ2:
+        case ARG_AL:
+        case ARG_AL_GZ:
+        case ARG_AL_BZ2:
+        case ARG_UN_CONC:
+        case ARG_UN_CONC_GZ:
+        case ARG_UN_CONC_BZ2:
+        case ARG_AL_CONC:
+        case ARG_AL_CONC_GZ:
+        case ARG_AL_CONC_BZ2:
+        case ARG_AL_CONC_DISC:
+        case ARG_AL_CONC_DISC_GZ:
+        case ARG_AL_CONC_DISC_BZ2: {
+            // Options come in groups of three: plain, -gz and -bz2
+            int cat = (next_option - ARG_UN) / 3;
+            readDumpFiles[cat] = arg;
+            readDumpCompress[cat] = (next_option - ARG_UN) % 3;
+            break;
+        }
+        case ARG_DUP_CACHE: {
+            dupCacheSlots = (size_t)parseInt(0, "--dup-cache arg must be at least 0", arg);
+            break;
+        }
+        case ARG_MAX_READ_FMOPS: {
+            maxReadFmops = (uint64_t)parseInt(0, "--max-read-fmops arg must be at least 0", arg);
+            break;
+        }
+        case ARG_MAX_READ_EXTS: {
+            maxReadExts = (uint64_t)parseInt(0, "--max-read-exts arg must be at least 0", arg);
+            break;
+        }
+        case ARG_MAX_READ_USECS: {
+            maxReadUsecs = (uint64_t)parseInt(0, "--max-read-usecs arg must be at least 0", arg);
+            break;
+        }
+        case ARG_SLOW_READS: slowReadsFile = arg; break;
+        case ARG_SLOW_READS_N: {
+            slowReadsN = (size_t)parseInt(1, "--slow-reads-n arg must be at least 1", arg);
+            break;
+        }
+        case ARG_SLOW_READS_USECS: {
+            slowReadsUsecs = (uint64_t)parseInt(0, "--slow-reads-usecs arg must be at least 0", arg);
+            break;
+        }
+        case ARG_STATUS_FILE: statusFile = arg; break;
+        case ARG_STATUS_IVAL: {
+            statusIval = parseInt(1, "--status-ival arg must be at least 1", arg);
+            break;
+        }
+        case ARG_CPU_PIN: cpuPin = true; break;
+        case ARG_CPU_LIST: {
+            EList<int> cpus;
+            if(!parseCpuList(arg, cpus)) {
+                cerr << "Error: --cpu-list arg must be a list of CPUs like 0-3,8; got \"" << arg << "\"" << endl;
+                throw 1;
+            }
+            cpuList = arg;
+            cpuPin = true;
+            break;
+        }
+        case ARG_DETERMINISTIC: deterministic = true; break;
+        case ARG_DETERMINISTIC_EPOCH: {
+            deterministicEpoch = (uint64_t)parseInt(1, "--deterministic-epoch arg must be at least 1", arg);
+            break;
         }
 		default:
 			printUsage(cerr);
@@ -1866,6 +2013,17 @@ static void parseOptions(int argc, const char **argv) {
 	if(qUpto + skipReads > qUpto) {
 		qUpto += skipReads;
 	}
+	if(deterministic) {
+		reorder = true;
+		if(arbitraryRandom && !gQuiet) {
+			cerr << "Warning: --non-deterministic was specified with --deterministic; "
+			     << "alignments will still vary from run to run" << endl;
+		}
+		if((dupCacheSlots > 0 || maxReadUsecs > 0) && !gQuiet) {
+			cerr << "Warning: --dup-cache and --max-read-usecs make the output depend on "
+			     << "timing, even with --deterministic" << endl;
+		}
+	}
 	if(useShmem && useMm && !gQuiet) {
 		cerr << "Warning: --shmem overrides --mm..." << endl;
 		useMm = false;
@@ -1919,6 +2077,9 @@ static SpliceSiteDB*                     ssdb;
 static ALTDB<index_t>*                   altdb;
 static TranscriptomePolicy*              multiseed_tpol;
 static GraphPolicy*                      gpol;
+static DupReadCache*                     dupCache;
+static SlowReadLog*                      slowReads;
+static LiveStatus<index_t>*              liveStatus;
 
 /**
  * Metrics for measuring the work done by the outer read alignment
@@ -1975,7 +2136,15 @@ struct OuterLoopMetrics {
  */
 struct PerfMetrics {
 
-	PerfMetrics() : first(true) { reset(); }
+	/**
+	 * If perThread is true, the allocation columns count only the
+	 * allocations made by the thread that calls reset() and
+	 * reportInterval(), as needed for per-read records.
+	 */
+	PerfMetrics(bool perThread_ = false) : perThread(perThread_), first(true) {
+		LOCK_SITE(mutex_m, "PerfMetrics");
+		reset();
+	}
 
 	/**
 	 * Set all counters to 0.
@@ -2010,6 +2179,22 @@ struct PerfMetrics {
 		nbtfiltdo_u = 0;
         
         him.reset();
+		allocs0 = allocsu0 = allocs();
+		allocBytes0 = allocBytesu0 = allocBytes();
+	}
+
+	/**
+	 * Return the allocation count the allocation columns are based on.
+	 */
+	uint64_t allocs() const {
+		return perThread ? MemoryTally::threadAllocs() : gMemTally.allocs();
+	}
+
+	/**
+	 * Return the allocated byte count the allocation columns are based on.
+	 */
+	uint64_t allocBytes() const {
+		return perThread ? MemoryTally::threadAllocBytes() : gMemTally.allocBytes();
 	}
 
 	/**
@@ -2239,9 +2424,11 @@ struct PerfMetrics {
                 /* 135 */ "GlobalGenomeCoords"  "\t"
                 /* 136 */ "LocalGenomeCoords"   "\t"
             
+                /* 137 */ "Allocs"              "\t"
+                /* 138 */ "AllocBytes"          "\t"
+                /* 139 */ "AllocsPerRead"       "\t"
+                /* 140 */ "AllocBytesPerRead"   "\t";
             
-				"\n";
-			
 			if(name != NULL) {
 				if(o != NULL) o->writeChars("Name\t");
 				if(metricsStderr) stderrSs << "Name\t";
@@ -2249,6 +2436,16 @@ struct PerfMetrics {
 			
 			if(o != NULL) o->writeChars(str);
 			if(metricsStderr) stderrSs << str;
+			// 141-158. Microseconds and calls for each pipeline stage
+			for(int i = 0; i < STAGE_NUM; i++) {
+				snprintf(buf, sizeof(buf), "%sUsecs\t%sCalls\t",
+				         stageNames[i], stageNames[i]);
+				if(o != NULL) o->writeChars(buf);
+				if(metricsStderr) stderrSs << buf;
+			}
+			// 159
+			if(o != NULL) o->writeChars("MateSearch\n");
+			if(metricsStderr) stderrSs << "MateSearch\n";
 			first = false;
 		}
 		
@@ -2833,8 +3030,48 @@ struct PerfMetrics {
 		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
         // 136
         itoa10<size_t>(him.localgenomecoords, buf);
+        if(metricsStderr) stderrSs << buf << '\t';
+		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
+        
+        // 137-140. Heap allocations tallied by gMemTally (by this thread,
+        // if perThread) since alignment started (total) or since the last
+        // report
+        uint64_t nallocs = allocs(), nallocBytes = allocBytes();
+        uint64_t ivalAllocs = nallocs - (total ? allocs0 : allocsu0);
+        uint64_t ivalAllocBytes = nallocBytes - (total ? allocBytes0 : allocBytesu0);
+        allocsu0 = nallocs;
+        allocBytesu0 = nallocBytes;
+        // 137
+        itoa10<uint64_t>(ivalAllocs, buf);
+        if(metricsStderr) stderrSs << buf << '\t';
+		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
+        // 138
+        itoa10<uint64_t>(ivalAllocBytes, buf);
+        if(metricsStderr) stderrSs << buf << '\t';
+		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
+        // 139
+        snprintf(buf, sizeof(buf), "%.3f", ol.reads == 0 ? 0.0 : (double)ivalAllocs / ol.reads);
+        if(metricsStderr) stderrSs << buf << '\t';
+		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
+        // 140
+        snprintf(buf, sizeof(buf), "%.1f", ol.reads == 0 ? 0.0 : (double)ivalAllocBytes / ol.reads);
         if(metricsStderr) stderrSs << buf;
 		if(o != NULL) { o->writeChars(buf); }
+        
+        // 141-158. Microseconds (exclusive of nested stages) and calls per
+        // stage
+        for(int i = 0; i < STAGE_NUM; i++) {
+            itoa10<uint64_t>(ticksToUsecs(him.stages.ticks[i]), buf);
+            if(metricsStderr) stderrSs << '\t' << buf;
+            if(o != NULL) { o->write('\t'); o->writeChars(buf); }
+            itoa10<uint64_t>(him.stages.calls[i], buf);
+            if(metricsStderr) stderrSs << '\t' << buf;
+            if(o != NULL) { o->write('\t'); o->writeChars(buf); }
+        }
+        // 159
+        itoa10<uint64_t>(him.mateatts, buf);
+        if(metricsStderr) stderrSs << '\t' << buf;
+        if(o != NULL) { o->write('\t'); o->writeChars(buf); }
 
 		if(o != NULL) { o->write('\n'); }
 		if(metricsStderr) cerr << stderrSs.str().c_str() << endl;
@@ -2902,6 +3139,13 @@ struct PerfMetrics {
     
     //
     HIMetrics         him;
+    
+	// allocation counters at reset() and at the last report
+	bool              perThread; // count only the calling thread's allocations
+	uint64_t          allocs0;
+	uint64_t          allocBytes0;
+	uint64_t          allocsu0;
+	uint64_t          allocBytesu0;
 
 	MUTEX_T           mutex_m;  // lock for when one ob
 	bool              first; // yet to print first line?
@@ -2992,6 +3236,7 @@ static inline void printEEScoreMsg(
 
 #define MERGE_METRICS(met, sync) { \
 	msink.mergeMetrics(rpm); \
+	him.stages.charge(); \
 	met.merge( \
 		&olm, \
 		&sdm, \
@@ -3052,6 +3297,7 @@ static void multiseedSearchWorker_hisat2(void *vp) {
 	int tid = *((int*)vp);
 	assert(multiseed_gfm != NULL);
 	assert(multiseedMms == 0);
+	cpuPlacement.pinWorker(tid - 1);
 	PairedPatternSource&             patsrc   = *multiseed_patsrc;
 	const HGFM<index_t>&             gfm      = *multiseed_gfm;
 	const Scoring&                   sc       = *multiseed_sc;
@@ -3092,14 +3338,22 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                                    (size_t)tid,   // thread id
                                    secondary,     // secondary alignments
                                    no_spliced_alignment ? NULL : ssdb,
-                                   thread_rids_mindist);
+                                   thread_rids_mindist,
+                                   thread_rids_epoch);
     
     SplicedAligner<index_t, local_index_t> splicedAligner(
                                                           gfm,
                                                           anchorStop,
                                                           secondary,
                                                           localAlign,
-                                                          thread_rids_mindist);
+                                                          thread_rids_mindist,
+                                                          thread_rids_epoch);
+    splicedAligner.setBudget(maxReadFmops, maxReadExts, maxReadUsecs);
+	// Alignments rebuilt from the duplicate read cache; declared after
+	// splicedAligner since their edits live in its pool
+	AlnRes dupRes1, dupRes2;
+	DupReadEntry dupEnt;
+	BTString dupKey;
 	SwAligner sw;
 	OuterLoopMetrics olm;
 	SeedSearchMetrics sdm;
@@ -3116,6 +3370,12 @@ static void multiseedSearchWorker_hisat2(void *vp) {
 	uint64_t nbtfiltsc = 0; // TODO: find a new home for these
 	uint64_t nbtfiltdo = 0; // TODO: find a new home for these
     HIMetrics him;
+    msinkwrap.setStageMetrics(&him.stages);
+    // This thread's slowest reads; merged into slowReads at the end
+    std::unique_ptr<SlowReadLog> slowLog(slowReads != NULL ? new SlowReadLog(slowReadsN, slowReadsUsecs) : NULL);
+    LiveStatusSlot* liveSlot = (liveStatus != NULL ? &liveStatus->slot(tid - 1) : NULL);
+    SlowRead slowBeg;
+    struct timeval slowTv;
     
 	ASSERT_ONLY(BTDnaString tmp);
     
@@ -3142,7 +3402,7 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                           gOlapMatesOK,
                           gExpandToFrag);
     
-  	PerfMetrics metricsPt; // per-thread metrics object; for read-level metrics
+  	PerfMetrics metricsPt(true); // per-thread metrics object; for read-level metrics
 	BTString nametmp;
 	
 	PerReadMetrics prm;
@@ -3170,18 +3430,38 @@ static void multiseedSearchWorker_hisat2(void *vp) {
 	int mergeival = 16;
 	while(true) {
 		bool success = false, done = false, paired = false;
-		ps->nextReadPair(success, done, paired, outType != OUTPUT_SAM);
+		{
+			StageTimer stageTimer(&him.stages, STAGE_PARSE);
+			ps->nextReadPair(success, done, paired, outType != OUTPUT_SAM);
+		}
 		if(!success && done) {
 			break;
 		} else if(!success) {
 			continue;
 		}
 		TReadId rdid = ps->rdid();
-        if(nthreads > 1 && useTempSpliceSite) {
+        if(nthreads > 1 && useTempSpliceSite && thread_rids_epoch > 0) {
+            // Wait, without spinning, for the reads whose splice sites
+            // this read may use
+#ifdef LOCK_PROFILE
+            static LockSite readEpochsSite("read_epochs");
+            uint64_t waitBeg = cpuTicks();
+            bool waited = readEpochs.begin(tid - 1, rdid);
+            readEpochsSite.record(waited, cpuTicks() - waitBeg, 0);
+#else
+            readEpochs.begin(tid - 1, rdid);
+#endif
+        } else if(nthreads > 1 && useTempSpliceSite) {
             assert_gt(tid, 0);
             assert_leq(tid, thread_rids.size());
             assert(thread_rids[tid - 1] == 0 || rdid > thread_rids[tid - 1]);
             thread_rids[tid - 1] = (rdid > 0 ? rdid - 1 : 0);
+#ifdef LOCK_PROFILE
+            // Not a mutex, but threads wait here for the slowest one
+            static LockSite threadRidsSite("thread_rids");
+            uint64_t spinBeg = cpuTicks();
+            bool spun = false;
+#endif
             while(true) {
                 uint64_t min_rdid = thread_rids[0];
                 {
@@ -3193,6 +3473,9 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                 }
                 
                 if(min_rdid + thread_rids_mindist < rdid) {
+#ifdef LOCK_PROFILE
+                    spun = true;
+#endif
 #if defined(_TTHREAD_WIN32_)
                     Sleep(0);
 #elif defined(_TTHREAD_POSIX_)
@@ -3200,6 +3483,9 @@ static void multiseedSearchWorker_hisat2(void *vp) {
 #endif
                 } else break;
             }
+#ifdef LOCK_PROFILE
+            threadRidsSite.record(spun, cpuTicks() - spinBeg, 0);
+#endif
         }
         
 		bool sample = true;
@@ -3217,17 +3503,19 @@ static void multiseedSearchWorker_hisat2(void *vp) {
 			//
 			// Check if there is metrics reporting for us to do.
 			//
-			if(metricsIval > 0 &&
-			   (metricsOfb != NULL || metricsStderr) &&
-			   !metricsPerRead &&
+			bool reportMetrics = metricsIval > 0 &&
+			                     (metricsOfb != NULL || metricsStderr) &&
+			                     !metricsPerRead;
+			if((reportMetrics || liveStatus != NULL) &&
 			   ++mergei == mergeival)
 			{
 				// Do a periodic merge.  Update global metrics, in a
-				// synchronized manner if needed.
+				// synchronized manner if needed.  The status file takes its
+				// alignment rates from the merged reporting metrics.
 				MERGE_METRICS(metrics, nthreads > 1);
 				mergei = 0;
 				// Check if a progress message should be printed
-				if(tid == 0) {
+				if(tid == 0 && reportMetrics) {
 					// Only thread 1 prints progress messages
 					time_t curTime = time(0);
 					if(curTime - iTime >= metricsIval) {
@@ -3236,11 +3524,22 @@ static void multiseedSearchWorker_hisat2(void *vp) {
 					}
 				}
 			}
+			if(liveSlot != NULL) liveSlot->beginRead();
 			prm.reset(); // per-read metrics
 			prm.doFmString = false;
 			if(sam_print_xt) {
 				gettimeofday(&prm.tv_beg, &prm.tz_beg);
 			}
+			if(slowLog.get() != NULL) {
+				gettimeofday(&slowTv, NULL);
+				slowBeg.setCounters(
+					splicedAligner.fmops(),
+					him.globalgenomecoords + him.localgenomecoords,
+					him.localindexatts,
+					him.localsearchrecur,
+					him.mateatts,
+					him.stages);
+			}
 			// Try to align this read
 			while(retry) {
 				retry = false;
@@ -3424,14 +3723,37 @@ static void multiseedSearchWorker_hisat2(void *vp) {
 				// Whether we're done with mate1 / mate2
                 bool done[2] = { !filt[0], !filt[1] };
 				// size_t nelt[2] = {0, 0};
-                if(filt[0] && filt[1]) {
+                // Answer exact duplicates of earlier reads/pairs from the cache
+                bool dupHit = false;
+                if(dupCache != NULL && (filt[0] || filt[1])) {
+                    DupReadCache::makeKey(*rds[0], pair ? rds[1] : NULL, filt, dupKey);
+                    rpm.ndup_lookup++;
+                    dupHit = dupCache->lookup(dupKey, dupEnt);
+                }
+                if(dupHit) {
+                    rpm.ndup_hit++;
+                    LinkedEList<EList<Edit> >* rawEdits = &splicedAligner.rawEdits();
+                    for(size_t i = 0, ai = 0; i < dupEnt.kinds.size(); i++) {
+                        if(dupEnt.kinds[i] == ALN_REP_PAIR) {
+                            dupEnt.get(ai++, rdid, dupRes1, rawEdits);
+                            dupEnt.get(ai++, rdid, dupRes2, rawEdits);
+                            msinkwrap.report(0, &dupRes1, &dupRes2);
+                        } else if(dupEnt.kinds[i] == ALN_REP_MATE1) {
+                            dupEnt.get(ai++, rdid, dupRes1, rawEdits);
+                            msinkwrap.report(0, &dupRes1, NULL);
+                        } else {
+                            dupEnt.get(ai++, rdid, dupRes2, rawEdits);
+                            msinkwrap.report(0, NULL, &dupRes2);
+                        }
+                    }
+                } else if(filt[0] && filt[1]) {
                     splicedAligner.initReads(rds, nofw, norc, minsc, maxpen);
                 } else if(filt[0]) {
                     splicedAligner.initRead(rds[0], nofw[0], norc[0], minsc[0], maxpen[0], false);
                 } else if(filt[1]) {
                     splicedAligner.initRead(rds[1], nofw[1], norc[1], minsc[1], maxpen[1], true);
                 }
-                if(filt[0] || filt[1]) {
+                if(!dupHit && (filt[0] || filt[1])) {
                     int ret = splicedAligner.go(sc, pepol, *multiseed_tpol, *gpol, gfm, *altdb, ref, sw, *ssdb, wlm, prm, swmSeed, him, rnd, msinkwrap);
                     MERGE_SW(sw);
                     // daehwan
@@ -3469,6 +3791,19 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                             done[mate] = true;
                         }
                     }
+                    if(prm.overBudget) {
+                        rpm.nbudget++;
+                    }
+                    // Don't let duplicates inherit a search that was cut short
+                    if(dupCache != NULL && !prm.overBudget) {
+                        dupCache->insert(
+                                         dupKey,
+                                         msinkwrap.repOrder(),
+                                         msinkwrap.rs1(),
+                                         msinkwrap.rs2(),
+                                         msinkwrap.rs1u(),
+                                         msinkwrap.rs2u());
+                    }
                 }
 
                 for(size_t i = 0; i < 2; i++) {
@@ -3483,6 +3818,7 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                 }
                 
 				// Commit and report paired-end/unpaired alignments
+				StageTimer stageTimer(&him.stages, STAGE_SAM);
 				msinkwrap.finishRead(
                                      NULL,
                                      NULL,
@@ -3506,6 +3842,25 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                                      templateLenAdjustment);
 				assert(!retry || msinkwrap.empty());
 			} // while(retry)
+			if(slowLog.get() != NULL) {
+				struct timeval tv;
+				gettimeofday(&tv, NULL);
+				uint64_t usecs = (uint64_t)(tv.tv_sec - slowTv.tv_sec) * 1000000 +
+				                 (tv.tv_usec - slowTv.tv_usec);
+				if(slowLog->wants(usecs)) {
+					SlowRead& r = slowLog->add(usecs);
+					r.setRead(ps->bufa(), paired ? &ps->bufb() : NULL, rdid);
+					r.setCounters(
+						splicedAligner.fmops(),
+						him.globalgenomecoords + him.localgenomecoords,
+						him.localindexatts,
+						him.localsearchrecur,
+						him.mateatts,
+						him.stages);
+					r.subtract(slowBeg);
+				}
+			}
+			if(liveSlot != NULL) liveSlot->finishRead();
 		} // if(rdid >= skipReads && rdid < qUpto)
 		else if(rdid >= qUpto) {
 			break;
@@ -3518,9 +3873,15 @@ static void multiseedSearchWorker_hisat2(void *vp) {
 			metricsPt.reset();
 		}
 	} // while(true)
+	if(nthreads > 1 && useTempSpliceSite && thread_rids_epoch > 0) {
+		readEpochs.finish(tid - 1);
+	}
 	
 	// One last metrics merge
 	MERGE_METRICS(metrics, nthreads > 1);
+	if(slowLog.get() != NULL) {
+		slowReads->merge(*slowLog);
+	}
     
 	return;
 }
@@ -3546,17 +3907,31 @@ static void multiseedSearch(
 	multiseed_sc           = &sc;
     multiseed_tpol         = &tpol;
     gpol                   = &gp;
+	std::unique_ptr<DupReadCache> dupCacheAp(dupCacheSlots > 0 ? new DupReadCache(dupCacheSlots) : NULL);
+	dupCache               = dupCacheAp.get();
+	std::unique_ptr<SlowReadLog> slowReadsAp(!slowReadsFile.empty() ? new SlowReadLog(slowReadsN, slowReadsUsecs) : NULL);
+	slowReads              = slowReadsAp.get();
+	std::unique_ptr<LiveStatus<index_t> > liveStatusAp(!statusFile.empty() ?
+		new LiveStatus<index_t>(statusFile, statusIval, nthreads, patsrc, msink) : NULL);
+	liveStatus             = liveStatusAp.get();
 	multiseed_metricsOfb   = metricsOfb;
 	multiseed_refs = refs;
 	AutoArray<tthread::thread*> threads(nthreads);
 	AutoArray<int> tids(nthreads);	
+	// Count only the allocations made while aligning
+	metrics.reset();
 	// Start the metrics thread
+	if(liveStatus != NULL) {
+		liveStatus->start();
+	}
 	{
 		Timer _t(cerr, "Multiseed full-index search: ", timing);
         
         thread_rids.resize(nthreads);
         thread_rids.fill(0);
         thread_rids_mindist = (nthreads == 1 || !useTempSpliceSite ? 0 : 1000 * nthreads);        
+        thread_rids_epoch = (deterministic && useTempSpliceSite ? deterministicEpoch : 0);
+        readEpochs.init(nthreads, thread_rids_epoch);
 		for(int i = 0; i < nthreads; i++) {
 			// Thread IDs start at 1
 			tids[i] = i+1;
@@ -3567,13 +3942,89 @@ static void multiseedSearch(
             threads[i]->join();
 
 	}
+	if(liveStatus != NULL) {
+		liveStatus->stop();
+	}
 	if(!metricsPerRead && (metricsOfb != NULL || metricsStderr)) {
 		metrics.reportInterval(metricsOfb, metricsStderr, true, false, NULL);
 	}
+	if(slowReads != NULL) {
+		slowReads->write(slowReadsFile);
+	}
+#ifdef LOCK_PROFILE
+	lockProfileReport(cerr);
+#endif
 }
 
 static string argstr;
 
+/**
+ * Parameters for loading the reference on a thread of its own while the
+ * index is being loaded.
+ */
+struct RefLoadParam {
+	BitPairReference* ref;
+	bool              failed;
+};
+
+static void refLoad_worker(void *vp) {
+	RefLoadParam& p = *(RefLoadParam*)vp;
+	try {
+		Timer _t(cerr, "Time loading reference: ", timing, gVerbose || startVerbose);
+		p.ref = new BitPairReference(
+		                             adjIdxBase,
+		                             false,
+		                             sanityCheck,
+		                             NULL,
+		                             NULL,
+		                             false,
+		                             useMm,
+		                             useShmem,
+		                             mmSweep,
+		                             gVerbose,
+		                             startVerbose);
+	} catch(...) {
+		p.failed = true;
+	}
+}
+
+/**
+ * Loads the reference on a thread of its own, or on the calling thread
+ * when asked to wait for it without one.  The thread is joined when this
+ * goes out of scope, so an exception thrown while the index is loading
+ * does not leave it running against a RefLoadParam that no longer exists.
+ */
+class RefLoadThread {
+public:
+	RefLoadThread(RefLoadParam& p, bool spawn) : p_(p), thread_(NULL) {
+		if(spawn) thread_ = new tthread::thread(refLoad_worker, (void*)&p_);
+	}
+
+	~RefLoadThread() {
+		if(thread_ != NULL) {
+			thread_->join();
+			delete thread_;
+		}
+	}
+
+	/**
+	 * Wait until the reference is loaded.
+	 */
+	void wait() {
+		if(thread_ != NULL) {
+			thread_->join();
+			delete thread_;
+			thread_ = NULL;
+		} else {
+			refLoad_worker((void*)&p_);
+		}
+	}
+
+private:
+	RefLoadParam&    p_;
+	tthread::thread* thread_;
+};
+
 extern void initializeCntLut();
 extern void initializeCntBit();
 
@@ -3646,6 +4097,17 @@ static void driver(
 	}
     altdb = new ALTDB<index_t>();
 	adjIdxBase = adjustEbwtBase(argv0, bt2indexBase, gVerbose);
+	// Keep the index and everything loading it on the home CPUs
+	if(cpuPin && cpuPlacement.init(cpuList, gVerbose || startVerbose)) {
+		cpuPlacement.confineToHome();
+	}
+	// With more than one thread, the reference, the global index and the
+	// local indexes are loaded at the same time
+	RefLoadParam refParam;
+	refParam.ref = NULL;
+	refParam.failed = false;
+	RefLoadThread refThread(refParam, nthreads > 1);
+	Timer *_tHdr = new Timer(cerr, "Time loading index header and ALTs: ", timing, gVerbose || startVerbose);
 	HGFM<index_t, local_index_t> gfm(
                                      adjIdxBase,
                                      altdb,
@@ -3666,6 +4128,7 @@ static void driver(
                                      false /*passMemExc*/,
                                      sanityCheck,
                                      use_haplotype); //use haplotypes?
+	delete _tHdr;
 	if(sanityCheck && !os.empty()) {
 		// Sanity check number of patterns and pattern lengths in GFM
 		// against original strings
@@ -3689,14 +4152,16 @@ static void driver(
     {
         // Load the other half of the index into memory
         assert(!gfm.isInMemory());
-        Timer _t(cerr, "Time loading forward index: ", timing);
+        Timer _t(cerr, "Time loading forward index: ", timing, gVerbose || startVerbose);
         gfm.loadIntoMemory(
                            -1, // not the reverse index
                            true,         // load SA samp? (yes, need forward index's SA samp)
                            true,         // load ftab (in forward index)
                            true,         // load rstarts (in forward index)
                            !noRefNames,  // load names?
-                           startVerbose);
+                           startVerbose,
+                           nthreads,     // # loader threads
+                           timing != 0); // print time taken by each part?
     }
     if(!saw_k) {
         if(gfm.gh().linearFM()) khits = 5;
@@ -3822,22 +4287,9 @@ static void driver(
 		// then instruct the sink to "retain" hits in a vector in
 		// memory so that we can easily sanity check them later on
 		AlnSink<index_t> *mssink = NULL;
-        Timer *_tRef = new Timer(cerr, "Time loading reference: ", timing);
-        auto_ptr<BitPairReference> refs(
-                                        new BitPairReference(
-                                                             adjIdxBase,
-                                                             false,
-                                                             sanityCheck,
-                                                             NULL,
-                                                             NULL,
-                                                             false,
-                                                             useMm,
-                                                             useShmem,
-                                                             mmSweep,
-                                                             gVerbose,
-                                                             startVerbose)
-                                        );
-        delete _tRef;
+        refThread.wait();
+        if(refParam.failed) throw 1;
+        auto_ptr<BitPairReference> refs(refParam.ref);
         if(!refs->loaded()) throw 1;
         
         bool xsOnly = (tranAssm_program == "cufflinks");
@@ -3859,6 +4311,7 @@ static void driver(
         init_junction_prob();
         bool write = novelSpliceSiteOutfile != "" || useTempSpliceSite;
         bool read = knownSpliceSiteInfile != "" || novelSpliceSiteInfile != "" || useTempSpliceSite || altdb->hasSpliceSites();
+        Timer *_tSs = new Timer(cerr, "Time loading splice sites: ", timing, gVerbose || startVerbose);
         ssdb = new SpliceSiteDB(
                                 *(refs.get()),
                                 refnames,
@@ -3882,6 +4335,7 @@ static void driver(
                 ssdb_file.close();
             }
         }
+        delete _tSs;
 		switch(outType) {
 			case OUTPUT_SAM: {
 				mssink = new AlnSinkSam<index_t>(
@@ -3903,6 +4357,21 @@ static void driver(
 				cerr << "Invalid output type: " << outType << endl;
 				throw 1;
 		}
+		// Open the files that --un/--al/--un-conc/--al-conc reads go to
+		ReadDump readDump;
+		for(int i = 0; i < READ_DUMP_NCAT; i++) {
+			if(!readDumpFiles[i].empty()) {
+				readDump.open(i, readDumpFiles[i], readDumpCompress[i]);
+			}
+		}
+		if(!readDump.empty()) {
+			if(reorder) {
+				// Write the reads in input order, alongside the SAM records
+				readDump.setOrdered(true);
+				oq.setReadDump(&readDump);
+			}
+			mssink->setReadDump(&readDump);
+		}
 		if(gVerbose || startVerbose) {
 			cerr << "Dispatching to search driver: "; logTime(cerr, true);
 		}
@@ -3963,6 +4432,9 @@ static void driver(
 		oq.flush(true);
 		assert_eq(oq.numStarted(), oq.numFinished());
 		assert_eq(oq.numStarted(), oq.numFlushed());
+		if(!readDump.close()) {
+			throw 1;
+		}
 		delete patsrc;
 		delete mssink;
         delete altdb;
@@ -0,0 +1,959 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * hisat2-bench: times the hot kernels of the aligner in isolation against a
+ * real index, with reads sampled from the reference using a fixed seed, so
+ * that kernel-level changes can be measured and checked for regressions.
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "assert_helpers.h"
+#include "endian_swap.h"
+#include "hgfm.h"
+#include "reference.h"
+#include "ds.h"
+#include "alt.h"
+#include "sstring.h"
+#include "random_source.h"
+#include "splice_site.h"
+#include "formats.h"
+#include "pat.h"
+#include "util.h"
+#include "scoring.h"
+#include "tp.h"
+#include "gp.h"
+#include "hi_aligner.h"
+#include "outq.h"
+#include "sam.h"
+#include "aln_sink.h"
+#include "unique.h"
+
+using namespace std;
+
+typedef TIndexOffU index_t;
+typedef uint16_t local_index_t;
+
+MemoryTally gMemTally;
+
+// Globals the pattern sources refer to; set as hisat2 does by default
+bool gColor = false;
+int gTrim5 = 0;
+int gTrim3 = 0;
+
+static bool showVersion = false; // just print version and quit?
+static int verbose      = 0;     // be talkative
+static uint32_t seed    = 0;     // seed for sampling reads
+static int nreads       = 100000; // # reads to sample from the reference
+static int readLen      = 100;   // length of sampled reads
+static int mmRate       = 1;     // % of bases in sampled reads that are changed
+static int reps         = 3;     // # times each kernel is run; best time is reported
+static string kernel;            // only run this kernel
+static string readsFile;         // FASTQ file for the parsing kernel
+static const char *short_options = "vhU:n:l:r:s:k:";
+static char *argv0 = NULL;
+
+enum {
+	ARG_VERSION = 256,
+	ARG_USAGE,
+	ARG_MM_RATE,
+};
+
+static struct option long_options[] = {
+	{(char*)"verbose",  no_argument,        0, 'v'},
+	{(char*)"version",  no_argument,        0, ARG_VERSION},
+	{(char*)"usage",    no_argument,        0, ARG_USAGE},
+	{(char*)"help",     no_argument,        0, 'h'},
+	{(char*)"reads",    required_argument,  0, 'n'},
+	{(char*)"length",   required_argument,  0, 'l'},
+	{(char*)"reps",     required_argument,  0, 'r'},
+	{(char*)"seed",     required_argument,  0, 's'},
+	{(char*)"kernel",   required_argument,  0, 'k'},
+	{(char*)"mm-rate",  required_argument,  0, ARG_MM_RATE},
+	{(char*)0, 0, 0, 0} // terminator
+};
+
+/**
+ * Print a summary usage message to the provided output stream.
+ */
+static void printUsage(ostream& out) {
+	out << "HISAT2 version " << string(HISAT2_VERSION).c_str() << " by Daehwan Kim (infphilo@gmail.com, http://www.ccb.jhu.edu/people/infphilo)" << endl;
+	out
+	<< "Usage: hisat2-bench [options]* <ht2_base>" << endl
+	<< "  <ht2_base>         ht2 filename minus trailing .1." << gfm_ext << "/.2." << gfm_ext << endl
+	<< endl
+	<< "  Times the aligner's core kernels on reads sampled from the indexed" << endl
+	<< "  reference and prints ns/op and Mops/s for each." << endl
+	<< endl
+	<< "Options:" << endl
+	<< "  -n/--reads <int>   # reads to sample from the reference (100000)" << endl
+	<< "  -l/--length <int>  length of sampled reads (100)" << endl
+	<< "  --mm-rate <int>    % of bases changed in sampled reads (1)" << endl
+	<< "  -s/--seed <int>    seed for sampling reads (0)" << endl
+	<< "  -r/--reps <int>    # times to run each kernel; the best run is reported (3)" << endl
+	<< "  -k/--kernel <name> only run kernel <name>: ftab, fm-search, sa-resolve," << endl
+	<< "                     ref-stretch, ref-packed, ss-lookup, extend, combine," << endl
+	<< "                     fastq-parse, sam-format" << endl
+	<< "  -U <path>          FASTQ file for fastq-parse (default: the sampled reads)" << endl
+	<< "  -v/--verbose       verbose output" << endl
+	<< "  -h/--help          print this usage message" << endl
+	;
+}
+
+/**
+ * Parse an int out of optarg and enforce that it be at least 'lower';
+ * if it is less than 'lower', than output the given error message and
+ * exit with an error and a usage message.
+ */
+static int parseInt(int lower, const char *errmsg) {
+	long l;
+	char *endPtr= NULL;
+	l = strtol(optarg, &endPtr, 10);
+	if (endPtr != NULL) {
+		if (l < lower) {
+			cerr << errmsg << endl;
+			printUsage(cerr);
+			throw 1;
+		}
+		return (int32_t)l;
+	}
+	cerr << errmsg << endl;
+	printUsage(cerr);
+	throw 1;
+	return -1;
+}
+
+/**
+ * Read command-line arguments
+ */
+static void parseOptions(int argc, char **argv) {
+	int option_index = 0;
+	int next_option;
+	do {
+		next_option = getopt_long(argc, argv, short_options, long_options, &option_index);
+		switch (next_option) {
+			case ARG_USAGE:
+			case 'h':
+				printUsage(cout);
+				throw 0;
+				break;
+			case 'v': verbose = true; break;
+			case ARG_VERSION: showVersion = true; break;
+			case 'n': nreads = parseInt(1, "-n/--reads arg must be at least 1"); break;
+			case 'l': readLen = parseInt(32, "-l/--length arg must be at least 32"); break;
+			case 'r': reps = parseInt(1, "-r/--reps arg must be at least 1"); break;
+			case 's': seed = (uint32_t)parseInt(0, "-s/--seed arg must be at least 0"); break;
+			case 'k': kernel = optarg; break;
+			case 'U': readsFile = optarg; break;
+			case ARG_MM_RATE: mmRate = parseInt(0, "--mm-rate arg must be at least 0"); break;
+			case -1: break; /* Done with options. */
+			case 0:
+				if (long_options[option_index].flag != 0)
+					break;
+			default:
+				printUsage(cerr);
+				throw 1;
+		}
+	} while(next_option != -1);
+}
+
+/**
+ * Everything the kernels work on.  The sampled reads and the positions
+ * they came from are fixed before any kernel runs, so every run of a
+ * kernel does the same work.
+ */
+struct BenchContext {
+	const GFM<index_t>*      gfm;
+	const BitPairReference*  ref;
+	ALTDB<index_t>*          altdb;
+	SpliceSiteDB*            ssdb;
+	const EList<string>*     refnames;
+	const Scoring*           sc;
+	const TranscriptomePolicy* tpol;
+	const GraphPolicy*       gpol;
+	const SamConfig<index_t>* samc;
+	const Mapq*              mapq;
+	TAlScore                 minsc;   // minimum score for a read of length readLen
+	EList<BTDnaString>       reads;   // sampled reads (with changes)
+	EList<BTString>          quals;
+	EList<uint32_t>          tidxs;   // reference each read came from
+	EList<uint32_t>          toffs;   // offset each read came from
+	EList<bool>              fws;     // strand each read came from
+	ELList<Edit>             edits;   // changes made to each read, reference orientation
+	EList<Read>              rds;     // sampled reads, finalized as the aligner sees them
+	SharedTempVars<index_t>  sharedVars; // shared by the hits below; must outlive them
+	EList<GenomeHit<index_t> > seeds; // exact hit in the middle of a read, for extend
+	EList<size_t>            seedRds; // read each seed belongs to
+	EList<Read>              srds;    // spliced reads, for combine
+	EList<GenomeHit<index_t> > lefts; // anchor on the left exon of each spliced read
+	EList<GenomeHit<index_t> > rights;// anchor on the right exon of each spliced read
+	EList<pair<index_t, index_t> > rows; // unique (row, node) pairs found by fm-search
+	string                   fqFile;  // FASTQ for fastq-parse
+	uint64_t                 check;   // folded results, so no kernel is optimized away
+};
+
+typedef uint64_t (*BenchKernel)(BenchContext& c);
+
+static double wallSecs() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/**
+ * Total length of the windows of length 'len' that fit in the reference.
+ */
+static uint64_t windowSpan(const BitPairReference& ref, size_t len) {
+	uint64_t totlen = 0;
+	for(index_t i = 0; i < ref.numRefs(); i++) {
+		if(ref.approxLen(i) > len) totlen += ref.approxLen(i) - len;
+	}
+	return totlen;
+}
+
+/**
+ * Pick a window of length 'len' uniformly from the reference, so that
+ * each reference sequence is chosen in proportion to its length.
+ */
+static void pickWindow(
+	const BitPairReference& ref,
+	RandomSource& rnd,
+	size_t len,
+	uint64_t totlen,
+	uint32_t& tidx,
+	uint32_t& toff)
+{
+	uint64_t r = (((uint64_t)rnd.nextU32() << 32) | rnd.nextU32()) % totlen;
+	index_t t = 0;
+	for(; t < ref.numRefs(); t++) {
+		if(ref.approxLen(t) <= len) continue;
+		uint64_t span = ref.approxLen(t) - len;
+		if(r < span) break;
+		r -= span;
+	}
+	assert_lt(t, ref.numRefs());
+	tidx = (uint32_t)t;
+	toff = (uint32_t)r;
+}
+
+/**
+ * Append 'len' bases of reference 'tidx' starting at 'toff' to 'seq',
+ * changing 'rate'% of them and recording each change in 'edits' at its
+ * offset in 'seq'.  Returns false if the stretch contains an N.
+ */
+static bool appendStretch(
+	const BitPairReference& ref,
+	RandomSource& rnd,
+	uint32_t *buf,
+	uint32_t tidx,
+	uint32_t toff,
+	size_t len,
+	int rate,
+	BTDnaString& seq,
+	EList<Edit>& edits
+	ASSERT_ONLY(, SStringExpandable<uint32_t>& destU32))
+{
+	int off = ref.getStretch(buf, tidx, toff, len ASSERT_ONLY(, destU32));
+	const uint8_t *cb = ((const uint8_t*)buf) + off;
+	for(size_t j = 0; j < len; j++) {
+		int b = cb[j];
+		if(b > 3) return false;
+		if((int)(rnd.nextU32() % 100) < rate) {
+			int rb = b;
+			b = (b + 1 + rnd.nextU32() % 3) & 3;
+			edits.push_back(Edit((uint32_t)seq.length(), "ACGT"[rb], "ACGT"[b], EDIT_TYPE_MM));
+		}
+		seq.append(b);
+	}
+	return true;
+}
+
+/**
+ * Sample reads from the reference: pick a reference sequence weighted by
+ * length, an offset free of Ns, a strand, and change mmRate% of the bases.
+ */
+static void sampleReads(BenchContext& c) {
+	const BitPairReference& ref = *c.ref;
+	RandomSource rnd(seed);
+	uint64_t totlen = windowSpan(ref, readLen);
+	if(totlen == 0) {
+		cerr << "Error: no reference sequence is longer than " << readLen << endl;
+		throw 1;
+	}
+	uint32_t *buf = new uint32_t[(readLen + 64) / 4 + 4];
+	ASSERT_ONLY(SStringExpandable<uint32_t> destU32);
+	c.reads.resize(nreads);
+	c.quals.resize(nreads);
+	c.tidxs.resize(nreads);
+	c.toffs.resize(nreads);
+	c.fws.resize(nreads);
+	c.edits.resize(nreads);
+	for(int i = 0; i < nreads; i++) {
+		BTDnaString& seq = c.reads[i];
+		for(int tries = 0; ; tries++) {
+			if(tries == 1000) {
+				cerr << "Error: could not sample a read free of Ns from the reference" << endl;
+				throw 1;
+			}
+			pickWindow(ref, rnd, readLen, totlen, c.tidxs[i], c.toffs[i]);
+			seq.clear();
+			c.edits[i].clear();
+			if(appendStretch(ref, rnd, buf, c.tidxs[i], c.toffs[i], readLen, mmRate,
+			                 seq, c.edits[i] ASSERT_ONLY(, destU32))) break;
+		}
+		c.fws[i] = (rnd.nextU32() & 1) == 0;
+		if(!c.fws[i]) seq.reverseComp();
+		c.quals[i].resize(readLen);
+		c.quals[i].fill('I');
+	}
+	delete[] buf;
+}
+
+/**
+ * Make a Read the aligner would see from the given sequence.
+ */
+static void makeRead(Read& rd, TReadId rdid, const BTDnaString& seq, const BTString& qual) {
+	char buf[32];
+	rd.reset();
+	rd.rdid = rdid;
+	rd.patFw = seq;
+	rd.qual = qual;
+	rd.name.install("read");
+	rd.name.append(buf, itoa10<TReadId>(rdid, buf) - buf);
+	rd.finalize();
+}
+
+/**
+ * Set up the inputs of extend, combine and sam-format.  For extend, each
+ * read gets an exact 20-base seed hit as near its middle as its changes
+ * allow, found the way the aligner finds its anchors.  For combine, reads
+ * are made of two exons separated by an intron of 50-2000 bases, each
+ * with an exact anchor ending 10 bases short of the junction, so that
+ * combineWith has to find the splice site.
+ */
+static void prepareHits(BenchContext& c) {
+	const GFM<index_t>& gfm = *c.gfm;
+	const BitPairReference& ref = *c.ref;
+	const index_t seedLen = 20;
+	EList<GenomeHit<index_t> > hits;
+	c.rds.resize(c.reads.size());
+	for(size_t i = 0; i < c.reads.size(); i++) {
+		makeRead(c.rds[i], i, c.reads[i], c.quals[i]);
+		// offsets below are in reference orientation
+		const EList<Edit>& edits = c.edits[i];
+		index_t mid = (readLen - seedLen) / 2, rdoff = (index_t)INDEX_MAX;
+		for(index_t d = 0; d <= mid && rdoff == (index_t)INDEX_MAX; d++) {
+			for(int side = 0; side < 2; side++) {
+				index_t p = (side == 0) ? mid - d : mid + d;
+				if(p + seedLen > (index_t)readLen) continue;
+				bool exact = true;
+				for(size_t e = 0; e < edits.size(); e++) {
+					if(edits[e].pos >= p && edits[e].pos < p + seedLen) exact = false;
+				}
+				if(exact) { rdoff = p; break; }
+			}
+		}
+		index_t joinedOff = 0;
+		if(rdoff == (index_t)INDEX_MAX ||
+		   !gfm.textOffToJoined(c.tidxs[i], c.toffs[i] + rdoff, joinedOff)) {
+			continue;
+		}
+		hits.clear();
+		Coord coord(c.tidxs[i], c.toffs[i] + rdoff, c.fws[i], joinedOff);
+		if(!GenomeHit<index_t>::adjustWithALT(rdoff, seedLen, coord, c.sharedVars, hits,
+		                                      c.rds[i], gfm, *c.altdb, ref, *c.gpol)) {
+			continue;
+		}
+		c.seeds.push_back(hits[0]);
+		c.seedRds.push_back(i);
+	}
+
+	const index_t maxIntron = 2000, anchorGap = 10;
+	const index_t half = readLen / 2;
+	RandomSource rnd(seed + 1);
+	uint64_t totlen = windowSpan(ref, readLen + maxIntron);
+	if(totlen == 0) return;
+	uint32_t *buf = new uint32_t[(readLen + 64) / 4 + 4];
+	ASSERT_ONLY(SStringExpandable<uint32_t> destU32);
+	BTDnaString seq;
+	EList<Edit> edits;
+	c.srds.resize(c.reads.size());
+	size_t nspliced = 0;
+	for(size_t i = 0; i < c.reads.size(); i++) {
+		uint32_t tidx = 0, toff = 0;
+		index_t intron = 50 + rnd.nextU32() % (maxIntron - 50 + 1);
+		pickWindow(ref, rnd, readLen + maxIntron, totlen, tidx, toff);
+		seq.clear();
+		if(!appendStretch(ref, rnd, buf, tidx, toff, half, 0, seq, edits ASSERT_ONLY(, destU32)) ||
+		   !appendStretch(ref, rnd, buf, tidx, toff + half + intron, readLen - half, 0,
+		                  seq, edits ASSERT_ONLY(, destU32))) {
+			continue;
+		}
+		index_t leftJoined = 0, rightJoined = 0;
+		index_t rightRdoff = half + anchorGap;
+		index_t rightToff = toff + intron + rightRdoff;
+		if(!gfm.textOffToJoined(tidx, toff, leftJoined) ||
+		   !gfm.textOffToJoined(tidx, rightToff, rightJoined)) {
+			continue;
+		}
+		Read& rd = c.srds[nspliced];
+		makeRead(rd, nspliced, seq, c.quals[0]);
+		hits.clear();
+		if(!GenomeHit<index_t>::adjustWithALT(0, half - anchorGap, Coord(tidx, toff, true, leftJoined),
+		                                      c.sharedVars, hits, rd, gfm, *c.altdb, ref, *c.gpol) ||
+		   !GenomeHit<index_t>::adjustWithALT(rightRdoff, readLen - rightRdoff,
+		                                      Coord(tidx, rightToff, true, rightJoined),
+		                                      c.sharedVars, hits, rd, gfm, *c.altdb, ref, *c.gpol)) {
+			continue;
+		}
+		GenomeHit<index_t>& left = hits[0];
+		GenomeHit<index_t>& right = hits.back();
+		if(left.rdoff() != 0 || right.rdoff() != rightRdoff ||
+		   !left.compatibleWith(right, (index_t)c.tpol->minIntronLen(), (index_t)c.tpol->maxIntronLen())) {
+			continue;
+		}
+		c.lefts.push_back(left);
+		c.rights.push_back(right);
+		nspliced++;
+	}
+	c.srds.resize(nspliced);
+	delete[] buf;
+}
+
+/**
+ * ftab lookups at every offset of every read.
+ */
+static uint64_t benchFtab(BenchContext& c) {
+	const GFM<index_t>& gfm = *c.gfm;
+	const index_t ftabChars = gfm.gh().ftabChars();
+	uint64_t ops = 0;
+	for(size_t i = 0; i < c.reads.size(); i++) {
+		const BTDnaString& seq = c.reads[i];
+		for(index_t off = 0; off + ftabChars <= seq.length(); off++) {
+			index_t top = 0, bot = 0;
+			if(gfm.ftabLoHi(seq, off, false, top, bot)) {
+				c.check += bot - top;
+			}
+			ops++;
+		}
+	}
+	return ops;
+}
+
+/**
+ * Backward search of each read from its 3' end, starting from the ftab,
+ * until the range empties: the same steps as HI_Aligner::partialSearch.
+ * Counts LF operations.  If 'collect' is set, remembers the first unique
+ * row of each read for sa-resolve.
+ */
+static uint64_t fmSearch(BenchContext& c, bool collect) {
+	const GFM<index_t>& gfm = *c.gfm;
+	const GFMParams<index_t>& gh = gfm.gh();
+	const index_t ftabChars = gh.ftabChars();
+	uint64_t ops = 0;
+	for(size_t i = 0; i < c.reads.size(); i++) {
+		const BTDnaString& seq = c.reads[i];
+		const index_t len = (index_t)seq.length();
+		pair<index_t, index_t> range(0, 0), node_range(0, 0);
+		if(!gfm.ftabLoHi(seq, len - ftabChars, false, range.first, range.second) ||
+		   range.first >= range.second) {
+			continue;
+		}
+		SideLocus<index_t> tloc, bloc;
+		if(range.second - range.first == 1) {
+			tloc.initFromRow(range.first, gh, gfm.gfm());
+			bloc.invalidate();
+		} else {
+			SideLocus<index_t>::initFromTopBot(range.first, range.second, gh, gfm.gfm(), tloc, bloc);
+		}
+		bool found = false;
+		for(index_t dep = ftabChars; dep < len; dep++) {
+			int nt = seq[len - dep - 1];
+			if(nt > 3) break;
+			pair<index_t, index_t> rangeTemp;
+			if(bloc.valid()) {
+				ops += 2;
+				rangeTemp = gfm.mapGLF(tloc, bloc, nt, &node_range);
+			} else {
+				ops++;
+				rangeTemp = gfm.mapGLF1(range.first, tloc, nt, &node_range);
+			}
+			if(rangeTemp.first == (index_t)INDEX_MAX || rangeTemp.first >= rangeTemp.second) {
+				break;
+			}
+			range = rangeTemp;
+			if(range.second - range.first == 1) {
+				if(collect && !found && node_range.second - node_range.first == 1) {
+					c.rows.push_back(make_pair(range.first, node_range.first));
+					found = true;
+				}
+				tloc.initFromRow(range.first, gh, gfm.gfm());
+				bloc.invalidate();
+			} else {
+				SideLocus<index_t>::initFromTopBot(range.first, range.second, gh, gfm.gfm(), tloc, bloc);
+			}
+		}
+		c.check += range.first;
+	}
+	return ops;
+}
+
+static uint64_t benchFmSearch(BenchContext& c) {
+	return fmSearch(c, false);
+}
+
+/**
+ * Resolve the rows collected by fmSearch to reference offsets by walking
+ * left to a sampled row.  The rows are collected before timing starts.
+ */
+static uint64_t benchSaResolve(BenchContext& c) {
+	const GFM<index_t>& gfm = *c.gfm;
+	for(size_t i = 0; i < c.rows.size(); i++) {
+		c.check += gfm.getOffset(c.rows[i].first, c.rows[i].second);
+	}
+	return c.rows.size();
+}
+
+/**
+ * Unpack each read's reference window, padded as the aligner does for
+ * dynamic programming.
+ */
+static uint64_t benchRefStretch(BenchContext& c) {
+	const BitPairReference& ref = *c.ref;
+	const size_t count = readLen + 30;
+	uint32_t *buf = new uint32_t[(count + 64) / 4 + 4];
+	ASSERT_ONLY(SStringExpandable<uint32_t> destU32);
+	for(size_t i = 0; i < c.reads.size(); i++) {
+		size_t toff = c.toffs[i] >= 15 ? c.toffs[i] - 15 : 0;
+		size_t len = min<size_t>(count, ref.approxLen(c.tidxs[i]) - toff);
+		int off = ref.getStretch(buf, c.tidxs[i], toff, len ASSERT_ONLY(, destU32));
+		c.check += ((const uint8_t*)buf)[off];
+	}
+	delete[] buf;
+	return c.reads.size();
+}
+
+/**
+ * Same windows as ref-stretch, loaded in packed form.
+ */
+static uint64_t benchRefPacked(BenchContext& c) {
+	const BitPairReference& ref = *c.ref;
+	const size_t count = readLen + 30;
+	PackedDnaString dest;
+	for(size_t i = 0; i < c.reads.size(); i++) {
+		ref.getPackedStretch(dest, c.tidxs[i], (int64_t)c.toffs[i] - 15, count);
+		c.check += dest.get(0);
+	}
+	return c.reads.size();
+}
+
+/**
+ * Look up splice sites to the left and right of each read's origin.
+ */
+static uint64_t benchSsLookup(BenchContext& c) {
+	const SpliceSiteDB& ssdb = *c.ssdb;
+	EList<SpliceSite> sites;
+	for(size_t i = 0; i < c.reads.size(); i++) {
+		sites.clear();
+		ssdb.getLeftSpliceSites(c.tidxs[i], c.toffs[i] + readLen, readLen, sites);
+		ssdb.getRightSpliceSites(c.tidxs[i], c.toffs[i], readLen, sites);
+		c.check += sites.size();
+	}
+	return 2 * c.reads.size();
+}
+
+/**
+ * Extend each seed hit to the ends of its read with GenomeHit::extend, as
+ * the aligner does with the anchors it finds.
+ */
+static uint64_t benchExtend(BenchContext& c) {
+	SwAligner swa;
+	SwMetrics swm;
+	PerReadMetrics prm;
+	RandomSource rnd(seed);
+	GenomeHit<index_t> hit;
+	for(size_t i = 0; i < c.seeds.size(); i++) {
+		hit = c.seeds[i];
+		index_t leftext = (index_t)INDEX_MAX, rightext = (index_t)INDEX_MAX;
+		hit.extend(c.rds[c.seedRds[i]], *c.gfm, *c.ref, *c.altdb, *c.ssdb, swa, swm, prm,
+		           *c.sc, c.minsc, rnd, 8 /* minK_local */, *c.tpol, *c.gpol,
+		           leftext, rightext);
+		c.check += hit.len() + (uint64_t)hit.score();
+	}
+	return c.seeds.size();
+}
+
+/**
+ * Join the two anchors of each spliced read with GenomeHit::combineWith,
+ * which has to search the gap between them for the splice site.
+ */
+static uint64_t benchCombine(BenchContext& c) {
+	SwAligner swa;
+	SwMetrics swm;
+	RandomSource rnd(seed);
+	GenomeHit<index_t> hit;
+	const TranscriptomePolicy& tpol = *c.tpol;
+	for(size_t i = 0; i < c.lefts.size(); i++) {
+		hit = c.lefts[i];
+		if(hit.combineWith(c.rights[i], c.srds[i], *c.gfm, *c.ref, *c.altdb, *c.ssdb,
+		                   swa, swm, *c.sc, c.minsc, rnd, 8 /* minK_local */,
+		                   (index_t)tpol.minIntronLen(), (index_t)tpol.maxIntronLen(),
+		                   tpol.minAnchorLen(), tpol.minAnchorLen_noncan(),
+		                   (index_t)c.gpol->maxAltsTried())) {
+			c.check += hit.len() + (uint64_t)hit.score();
+		}
+	}
+	return c.lefts.size();
+}
+
+/**
+ * Parse the FASTQ file through the same pattern source the aligner uses.
+ */
+static uint64_t benchFastqParse(BenchContext& c) {
+	EList<string> empty, singles;
+	singles.push_back(c.fqFile);
+	PatternParams pp(FASTQ, false, seed, false, false, false, false, false, 10, 1, 0);
+	PairedPatternSource *patsrc = PairedPatternSource::setupPatternSources(
+		singles, empty, empty, empty,
+#ifdef USE_SRA
+		empty,
+#endif
+		empty, empty, empty, pp, 1, false);
+	uint64_t ops = 0;
+	{
+		WrappedPatternSourcePerThread ps(*patsrc);
+		while(true) {
+			bool success = false, done = false, paired = false;
+			ps.nextReadPair(success, done, paired, false);
+			if(!success && done) break;
+			if(!success) continue;
+			c.check += ps.bufa().length();
+			ops++;
+		}
+	}
+	delete patsrc;
+	return ops;
+}
+
+/**
+ * Format a SAM record for each read with AlnSinkSam, from an ungapped
+ * alignment at the position the read was sampled from.  This includes
+ * building the CIGAR and MD:Z strings and the optional fields.
+ */
+static uint64_t benchSamFormat(BenchContext& c) {
+	OutFileBuf obuf;
+	OutputQueue oq(obuf, false, 1, false);
+	AlnSinkSam<index_t> sink(oq, *c.samc, *c.refnames, true, c.altdb);
+	LinkedEList<EList<Edit> > rawEdits;
+	EList<Edit> edits;
+	StackedAln staln;
+	SeedAlSumm ssm;
+	PerReadMetrics prm;
+	AlnFlags flags(
+		ALN_FLAG_PAIR_UNPAIRED,
+		false,  // canMax
+		false,  // maxed
+		false,  // maxedPair
+		true,   // nfilt
+		true,   // scfilt
+		true,   // lenfilt
+		true,   // qcfilt
+		false,  // mixedMode
+		true,   // primary
+		false,  // oppAligned
+		true);  // oppFw
+	BTString o;
+	for(size_t i = 0; i < c.rds.size(); i++) {
+		const Read& rd = c.rds[i];
+		edits = c.edits[i];
+		TAlScore score = 0;
+		for(size_t e = 0; e < edits.size(); e++) {
+			score -= c.sc->mm(asc2dna[(int)edits[e].qchr], rd.qual[0] - 33);
+		}
+		if(!c.fws[i]) Edit::invertPoss(edits, rd.length(), false);
+		AlnScore asc(score, 0, 0);
+		AlnRes rs;
+		rs.init(
+			rd.length(),                      // # chars after hard trimming
+			rd.rdid,                          // read ID
+			asc,                              // alignment score
+			&edits,                           // nucleotide edits array
+			0,                                // nucleotide edits first pos
+			edits.size(),                     // nucleotide edits last pos
+			NULL,                             // ambig base array
+			0,                                // ambig base first pos
+			0,                                // ambig base last pos
+			Coord(c.tidxs[i], c.toffs[i], c.fws[i]), // leftmost aligned char in ref
+			c.gfm->plen()[c.tidxs[i]],        // length of reference aligned to
+			&rawEdits);
+		rs.setMateParams(ALN_RES_TYPE_UNPAIRED, NULL, flags);
+		AlnSetSumm summ(
+			asc, AlnScore(), AlnScore(), AlnScore(), AlnScore(), AlnScore(),
+			0,      // other1
+			0,      // other2
+			false,  // paired
+			true,   // exhausted1
+			true,   // exhausted2
+			-1,     // orefid
+			-1,     // orefoff
+			1,      // numAlns1
+			0,      // numAlns2
+			0);     // numAlnsPaired
+		o.clear();
+		sink.append(o, staln, 0, &rd, NULL, rd.rdid, &rs, NULL, summ, ssm, ssm,
+		            &flags, NULL, prm, *c.mapq, *c.sc, false);
+		c.check += o.length();
+	}
+	return c.rds.size();
+}
+
+/**
+ * Run 'fn' 'reps' times and print the best time.
+ */
+static void runKernel(const char *name, BenchKernel fn, BenchContext& c) {
+	if(!kernel.empty() && kernel != name) return;
+	double best = 0.0;
+	uint64_t ops = 0;
+	for(int r = 0; r < reps; r++) {
+		double t = wallSecs();
+		ops = fn(c);
+		t = wallSecs() - t;
+		if(r == 0 || t < best) best = t;
+	}
+	double nsPerOp = ops == 0 ? 0.0 : best * 1e9 / ops;
+	double mops = best <= 0.0 ? 0.0 : ops / best / 1e6;
+	cout << name << '\t' << ops << '\t'
+	     << fixed << setprecision(3) << best << '\t'
+	     << setprecision(2) << nsPerOp << '\t'
+	     << setprecision(3) << mops << endl;
+}
+
+/**
+ * Write the sampled reads as FASTQ for fastq-parse when no file is given.
+ */
+static string writeSampledReads(const BenchContext& c) {
+	char fname[] = "/tmp/hisat2-bench.XXXXXX";
+	int fd = mkstemp(fname);
+	if(fd < 0) {
+		cerr << "Error: could not create a temporary FASTQ file" << endl;
+		throw 1;
+	}
+	close(fd);
+	ofstream out(fname);
+	for(size_t i = 0; i < c.reads.size(); i++) {
+		out << "@read" << i << '\n' << c.reads[i] << "\n+\n" << c.quals[i] << '\n';
+	}
+	out.close();
+	return string(fname);
+}
+
+extern void initializeCntLut();
+extern void initializeCntBit();
+
+static void driver(const string& ebwtFileBase) {
+	initializeCntLut();
+	initializeCntBit();
+
+	string adjustedEbwtFileBase = adjustEbwtBase(argv0, ebwtFileBase, verbose);
+	double t = wallSecs();
+	ALTDB<index_t> altdb;
+	HGFM<index_t, local_index_t> gfm(
+	                                 adjustedEbwtFileBase,
+	                                 &altdb,
+	                                 -1,       // don't care about entire-reverse
+	                                 true,     // index is for the forward direction
+	                                 -1,       // offrate (-1 = index default)
+	                                 0,        // offrate-plus (0 = index default)
+	                                 false,    // use memory-mapped IO
+	                                 false,    // use shared memory
+	                                 false,    // sweep memory-mapped memory
+	                                 true,     // load names?
+	                                 true,     // load SA sample?
+	                                 true,     // load ftab?
+	                                 true,     // load rstarts?
+	                                 true,     // load splice sites?
+	                                 verbose,  // be talkative?
+	                                 false,    // be talkative at startup?
+	                                 false,    // pass up memory exceptions?
+	                                 false,    // sanity check?
+	                                 false);   // use haplotypes?
+	gfm.loadIntoMemory(
+	                   -1,     // need entire reverse
+	                   true,   // load SA sample
+	                   true,   // load ftab
+	                   true,   // load rstarts
+	                   true,   // load names
+	                   verbose);
+	BitPairReference ref(
+	                     adjustedEbwtFileBase,
+	                     false,    // not colorspace
+	                     false,    // sanity check
+	                     NULL,
+	                     NULL,
+	                     false,
+	                     false,    // use memory-mapped IO
+	                     false,    // use shared memory
+	                     false,    // sweep memory-mapped memory
+	                     verbose,
+	                     verbose);
+	if(!ref.loaded()) throw 1;
+	EList<string> refnames;
+	readEbwtRefnames<index_t>(adjustedEbwtFileBase, refnames);
+	init_junction_prob();
+	SpliceSiteDB ssdb(ref, refnames, false, false, altdb.hasSpliceSites());
+	ssdb.read(gfm, altdb.alts());
+	if(kernel == "ss-lookup" && !altdb.hasSpliceSites()) {
+		cerr << "Error: the index has no splice sites; build it with --ss to run ss-lookup" << endl;
+		throw 1;
+	}
+	cerr << "Loaded index and reference in " << fixed << setprecision(2)
+	     << (wallSecs() - t) << " s" << endl;
+
+	// Scoring and policies as hisat2 sets them by default
+	SimpleFunc scoreMin, nCeil, penCanIntronLen, penNoncanIntronLen;
+	scoreMin.init(SIMPLE_FUNC_LINEAR, 0.0f, -0.2f);
+	nCeil.init(SIMPLE_FUNC_LINEAR, 0.0f, std::numeric_limits<double>::max(), 2.0f, 0.1f);
+	penCanIntronLen.init(SIMPLE_FUNC_LOG, -8, 1);
+	penNoncanIntronLen.init(SIMPLE_FUNC_LOG, -8, 1);
+	Scoring sc(
+	           DEFAULT_MATCH_BONUS,     // constant reward for match
+	           DEFAULT_MM_PENALTY_TYPE, // how to penalize mismatches
+	           DEFAULT_MM_PENALTY_MAX,  // max mm penalty
+	           DEFAULT_MM_PENALTY_MIN,  // min mm penalty
+	           DEFAULT_SC_PENALTY_MAX,  // max sc penalty
+	           DEFAULT_SC_PENALTY_MIN,  // min sc penalty
+	           scoreMin,                // min score as function of read len
+	           nCeil,                   // max # Ns as function of read len
+	           DEFAULT_N_PENALTY_TYPE,  // how to penalize Ns in the read
+	           DEFAULT_N_PENALTY,       // constant if N pelanty is a constant
+	           DEFAULT_N_CAT_PAIR,      // whether to concat mates before N filtering
+	           DEFAULT_READ_GAP_CONST,  // constant coeff for read gap cost
+	           DEFAULT_REF_GAP_CONST,   // constant coeff for ref gap cost
+	           DEFAULT_READ_GAP_LINEAR, // linear coeff for read gap cost
+	           DEFAULT_REF_GAP_LINEAR,  // linear coeff for ref gap cost
+	           4,                       // # rows at top/bot only entered diagonally
+	           0,                       // canonical splicing penalty
+	           12,                      // non-canonical splicing penalty
+	           1000000,                 // conflicting splice site penalty
+	           &penCanIntronLen,        // penalty as to intron length
+	           &penNoncanIntronLen);    // penalty as to intron length
+	TranscriptomePolicy tpol(20, 500000);
+	GraphPolicy gpol(16, false, false, false);
+	EList<size_t> reflens;
+	for(size_t i = 0; i < gfm.nPat(); i++) {
+		reflens.push_back(gfm.plen()[i]);
+	}
+	SamConfig<index_t> samc(
+		refnames, reflens,
+		false,                  // truncate QNAME to 255 chars
+		false,                  // omit SEQ/QUAL for 2ndary alignments
+		false,                  // omit unaligned-read records
+		string("hisat2"), string("hisat2"), string(HISAT2_VERSION),
+		string(""),             // command-line
+		string(""),             // read-group string
+		RNA_STRANDNESS_UNKNOWN,
+		// optional fields hisat2 prints by default
+		true,  false, false, false, true,  false, false, // AS XS Xs YN XN CS CQ
+		true,  true,  true,  true,  true,  true,  true,  // X0 X1 XM XO XG NM MD
+		true,  false, false, false, true,  true,  false, // YF YI YM YP YT YS ZS
+		false, false, false, false, false, false, false, // XR XT XD XU YE YL YU
+		false, false, false, false, false, false, false, // XP YR ZB ZR ZF ZM ZI
+		false, false, true,  true);                      // ZP ZU XS:A NH
+	Mapq *mapq = new_mapq(2, scoreMin, sc);
+
+	BenchContext c;
+	c.gfm = &gfm;
+	c.ref = &ref;
+	c.altdb = &altdb;
+	c.ssdb = &ssdb;
+	c.refnames = &refnames;
+	c.sc = &sc;
+	c.tpol = &tpol;
+	c.gpol = &gpol;
+	c.samc = &samc;
+	c.mapq = mapq;
+	c.minsc = scoreMin.f<TAlScore>((double)readLen);
+	c.check = 0;
+	sampleReads(c);
+	prepareHits(c);
+	if(kernel.empty() || kernel == "sa-resolve") {
+		fmSearch(c, true);
+	}
+	bool tmpFq = readsFile.empty();
+	c.fqFile = tmpFq ? writeSampledReads(c) : readsFile;
+
+	cout << "Kernel\tOps\tSecs\tNsPerOp\tMopsPerSec" << endl;
+	runKernel("ftab",        benchFtab,       c);
+	runKernel("fm-search",   benchFmSearch,   c);
+	runKernel("sa-resolve",  benchSaResolve,  c);
+	runKernel("ref-stretch", benchRefStretch, c);
+	runKernel("ref-packed",  benchRefPacked,  c);
+	if(altdb.hasSpliceSites()) {
+		runKernel("ss-lookup", benchSsLookup, c);
+	} else if(kernel.empty()) {
+		cerr << "Warning: skipping ss-lookup; the index has no splice sites" << endl;
+	}
+	runKernel("extend",      benchExtend,     c);
+	runKernel("combine",     benchCombine,    c);
+	runKernel("fastq-parse", benchFastqParse, c);
+	runKernel("sam-format",  benchSamFormat,  c);
+	if(verbose) cerr << "Check: " << c.check << endl;
+	if(tmpFq) unlink(c.fqFile.c_str());
+	delete mapq;
+}
+
+/**
+ * main function.  Parses command-line arguments.
+ */
+int main(int argc, char **argv) {
+	try {
+		argv0 = argv[0];
+		parseOptions(argc, argv);
+		if(showVersion) {
+			cout << argv0 << " version " << HISAT2_VERSION << endl;
+			cout << "Built on " << BUILD_HOST << endl;
+			cout << BUILD_TIME << endl;
+			cout << "Compiler: " << COMPILER_VERSION << endl;
+			cout << "Options: " << COMPILER_OPTIONS << endl;
+			return 0;
+		}
+		if(optind >= argc) {
+			cerr << "No index name given!" << endl;
+			printUsage(cerr);
+			return 1;
+		}
+		driver(argv[optind]);
+		return 0;
+	} catch(std::exception& e) {
+		cerr << "Error: Encountered exception: '" << e.what() << "'" << endl;
+		return 1;
+	} catch(int e) {
+		if(e != 0) {
+			cerr << "Error: Encountered internal HISAT2 exception (#" << e << ")" << endl;
+		}
+		return e;
+	}
+}
@@ -34,6 +34,7 @@
 #include "ds.h"
 #include "gfm.h"
 #include "hgfm.h"
+#include "build_mem.h"
 
 /**
  * \file Driver for the bowtie-build indexing tool.
@@ -54,6 +55,9 @@ static TIndexOffU bmax;
 static TIndexOffU bmaxMultSqrt;
 static uint32_t bmaxDivN;
 static int dcv;
+static bool bmax_provided;
+static bool dcv_provided;
+static uint64_t maxMemory;
 static int noDc;
 static int entireSA;
 static int seed;
@@ -89,6 +93,9 @@ static void resetOptions() {
 	bmaxMultSqrt   = OFF_MASK; // same, as multplier of sqrt(n)
 	bmaxDivN       = 4;          // same, as divisor of n
 	dcv            = 1024;  // bwise SA difference-cover sample sz
+	bmax_provided  = false;
+	dcv_provided   = false;
+	maxMemory      = 0;     // no memory budget
 	noDc           = 0;     // disable difference-cover sample
 	entireSA       = 0;     // 1 = disable blockwise SA
 	seed           = 0;     // srandom seed
@@ -138,6 +145,7 @@ enum {
     ARG_SPLICESITE,
     ARG_EXON,
     ARG_SV,
+    ARG_MAX_MEMORY,
 };
 
 /**
@@ -170,6 +178,7 @@ static void printUsage(ostream& out) {
 	    << "    --bmax <int>            max bucket sz for blockwise suffix-array builder" << endl
 	    << "    --bmaxdivn <int>        max bucket sz as divisor of ref len (default: 4)" << endl
 	    << "    --dcv <int>             diff-cover period for blockwise (default: 1024)" << endl
+	    << "    --max-memory <size>     pick -p/--bmaxdivn/--dcv to fit in <size> (e.g. 16G)" << endl
 	    << "    --nodc                  disable diff-cover (algorithm becomes quadratic)" << endl
 	    << "    -r/--noref              don't build .3/.4.ht2 (packed reference) portion" << endl
 	    << "    -3/--justref            just build .3/.4.ht2 (packed reference) portion" << endl
@@ -226,6 +235,7 @@ static struct option long_options[] = {
     {(char*)"ss",             required_argument, 0,            ARG_SPLICESITE},
     {(char*)"exon",           required_argument, 0,            ARG_EXON},
     {(char*)"sv",             required_argument, 0,            ARG_SV},
+    {(char*)"max-memory",     required_argument, 0,            ARG_MAX_MEMORY},
 	{(char*)"help",           no_argument,       0,            'h'},
 	{(char*)"ntoa",           no_argument,       0,            ARG_NTOA},
 	{(char*)"justref",        no_argument,       0,            '3'},
@@ -326,24 +336,36 @@ static void parseOptions(int argc, const char **argv) {
                 break;
             case ARG_SV:
                 sv_fname = optarg;
+                break;
+            case ARG_MAX_MEMORY:
+                maxMemory = parseMemSize(optarg);
+                if(maxMemory == 0) {
+                    cerr << "--max-memory arg must be a size such as 16G or 512M" << endl;
+                    printUsage(cerr);
+                    throw 1;
+                }
                 break;
 			case ARG_BMAX:
 				bmax = parseNumber<TIndexOffU>(1, "--bmax arg must be at least 1");
+				bmax_provided = true;
 				bmaxMultSqrt = OFF_MASK; // don't use multSqrt
 				bmaxDivN = 0xffffffff;     // don't use multSqrt
 				break;
 			case ARG_BMAX_MULT:
 				bmaxMultSqrt = parseNumber<TIndexOffU>(1, "--bmaxmultsqrt arg must be at least 1");
+				bmax_provided = true;
 				bmax = OFF_MASK;     // don't use bmax
 				bmaxDivN = 0xffffffff; // don't use multSqrt
 				break;
 			case ARG_BMAX_DIV:
 				bmaxDivN = parseNumber<uint32_t>(1, "--bmaxdivn arg must be at least 1");
+				bmax_provided = true;
 				bmax = OFF_MASK;         // don't use bmax
 				bmaxMultSqrt = OFF_MASK; // don't use multSqrt
 				break;
 			case ARG_DCV:
 				dcv = parseNumber<int>(3, "--dcv arg must be at least 3");
+				dcv_provided = true;
 				break;
 			case ARG_SEED:
 				seed = parseNumber<int>(0, "--seed arg must be at least 0");
@@ -399,6 +421,104 @@ static void deleteIdxFiles(
 extern void initializeCntLut();
 extern void initializeCntBit();
 
+/**
+ * Return the size in bytes of the given file, or 0 if it is not given or
+ * cannot be opened.
+ */
+static uint64_t fileSize(const string& fname) {
+	if(fname == "") return 0;
+	ifstream f(fname.c_str(), ios::binary | ios::ate);
+	if(!f.good()) return 0;
+	return (uint64_t)f.tellg();
+}
+
+/**
+ * Choose -p, --bmaxdivn and --dcv so that the predicted peak memory of
+ * the build fits in --max-memory.  Settings given explicitly on the
+ * command line are left alone; the number of threads is only ever
+ * lowered, with a warning, and only if that makes the build fit.  A graph
+ * index (--snp/--ss/--exon) can only be fitted by using fewer threads,
+ * since the size of the PathGraph is set by the input.
+ */
+static void fitMemoryBudget(
+	TIndexOffU jlen,
+	const EList<RefRecord>& szs,
+	const string& snpfile,
+	const string& ssfile,
+	const string& exonfile)
+{
+	BuildMemModel m;
+	m.jlen = jlen;
+	for(size_t i = 0, seqlen = 0; i < szs.size(); i++) {
+		if(szs[i].first) seqlen = 0;
+		seqlen += szs[i].off + szs[i].len;
+		m.maxSeqLen = max<uint64_t>(m.maxSeqLen, seqlen);
+	}
+	// Lines of --snp files are rarely shorter than 24 bytes, and lines
+	// of --ss/--exon files than 12 bytes
+	m.nalts = fileSize(snpfile) / 24 + fileSize(ssfile) / 12 + fileSize(exonfile) / 12;
+	m.graph = (m.nalts > 0);
+	m.nthreads = nthreads;
+	if(bmax != OFF_MASK) {
+		m.bmaxDivN = max<uint64_t>(jlen / bmax, 1);
+	} else if(bmaxMultSqrt != OFF_MASK) {
+		m.bmaxDivN = max<uint64_t>(jlen / ((uint64_t)sqrt((double)jlen) * bmaxMultSqrt), 1);
+	} else {
+		m.bmaxDivN = bmaxDivN;
+	}
+	m.dcv = noDc ? 0 : dcv;
+	m.ftabChars = ftabChars;
+	m.indexSz = sizeof(TIndexOffU);
+	const bool fitBmax = !bmax_provided;
+	const bool fitDcv = !dcv_provided && !noDc;
+	while(m.peak() > maxMemory) {
+		if(!m.graph) {
+			if(fitDcv && m.dcv < 4096 && m.dcSample() > maxMemory) {
+				m.dcv <<= 1;
+				continue;
+			}
+			if(fitBmax && m.bmaxDivN < 1024) {
+				m.bmaxDivN <<= 1;
+				continue;
+			}
+			if(fitDcv && m.dcv < 4096) {
+				m.dcv <<= 1;
+				continue;
+			}
+		}
+		break;
+	}
+	if(m.peak() > maxMemory && m.nthreads > 1) {
+		// Use fewer threads only if that is enough to fit
+		BuildMemModel m1 = m;
+		m1.nthreads = 1;
+		if(m1.peak() <= maxMemory) {
+			while(m.peak() > maxMemory) m.nthreads--;
+		}
+	}
+	if(verbose) {
+		cerr << "Fitting index construction into --max-memory of " << (maxMemory >> 20) << " MB" << endl;
+		m.print(cerr);
+	}
+	if(m.peak() > maxMemory) {
+		cerr << "Warning: predicted peak memory (" << (m.peak() >> 20) << " MB) exceeds --max-memory ("
+		     << (maxMemory >> 20) << " MB) even with the most economical settings" << endl;
+	}
+	if(fitBmax && m.bmaxDivN != bmaxDivN) {
+		bmaxDivN = (uint32_t)m.bmaxDivN;
+		if(verbose) cerr << "  Using --bmaxdivn " << bmaxDivN << endl;
+	}
+	if(fitDcv && m.dcv != dcv) {
+		dcv = m.dcv;
+		if(verbose) cerr << "  Using --dcv " << dcv << endl;
+	}
+	if(m.nthreads != nthreads) {
+		cerr << "Warning: using -p " << m.nthreads << " instead of -p " << nthreads
+		     << " to fit into --max-memory" << endl;
+		nthreads = m.nthreads;
+	}
+}
+
 /**
  * Drive the index construction process and optionally sanity-check the
  * result.
@@ -482,6 +602,9 @@ static void driver(
 	assert_gt(sztot.first, 0);
 	assert_gt(sztot.second, 0);
 	assert_gt(szs.size(), 0);
+	if(maxMemory > 0) {
+		fitMemoryBudget((TIndexOffU)sztot.first, szs, snpfile, ssfile, exonfile);
+	}
     
 	// Construct index from input strings and parameters	
     filesWritten.push_back(outfile + ".5." + gfm_ext);
@@ -523,6 +646,9 @@ static void driver(
     // Note that the Ebwt is *not* resident in memory at this time.  To
     // load it into memory, call ebwt.loadIntoMemory()
 	if(verbose) {
+		cerr << "Peak memory: " << (peakRss() >> 20) << " MB";
+		if(maxMemory > 0) cerr << " (--max-memory " << (maxMemory >> 20) << " MB)";
+		cerr << endl;
 		// Print Ebwt's vital stats
 		hGFM.gh().print(cerr);
 	}
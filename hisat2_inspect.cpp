@@ -19,6 +19,10 @@
 
 #include <string>
 #include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <stdio.h>
+#include <unistd.h>
 #include <getopt.h>
 #include <stdexcept>
 
@@ -41,6 +45,8 @@ static int splicesite_only = 0;
 static int splicesite_all_only = 0;
 static int exon_only = 0;
 static int summarize_only = 0; // just print summary of index and quit
+static int footprint_only = 0; // just print memory footprint of index and quit
+static string footprint_reads; // replay these reads for the footprint access profile
 static int across       = 60; // number of characters across in FASTA output
 static bool refFromGFM  = false; // true -> when printing reference, decode it from Gbwt instead of reading it from BitPairReference
 static string wrapper;
@@ -54,6 +60,8 @@ enum {
     ARG_SPLICESITE,
     ARG_SPLICESITE_ALL,
     ARG_EXON,
+    ARG_FOOTPRINT,
+    ARG_FOOTPRINT_READS,
 };
 
 static struct option long_options[] = {
@@ -65,6 +73,8 @@ static struct option long_options[] = {
     {(char*)"ss",       no_argument,        0, ARG_SPLICESITE},
     {(char*)"ss-all",   no_argument,        0, ARG_SPLICESITE_ALL},
     {(char*)"exon",     no_argument,        0, ARG_EXON},
+    {(char*)"footprint", no_argument,       0, ARG_FOOTPRINT},
+    {(char*)"footprint-reads", required_argument, 0, ARG_FOOTPRINT_READS},
 	{(char*)"summary",  no_argument,        0, 's'},
 	{(char*)"help",     no_argument,        0, 'h'},
 	{(char*)"across",   required_argument,  0, 'a'},
@@ -98,6 +108,10 @@ static void printUsage(ostream& out) {
     << "  --ss               Print splice sites" << endl
     << "  --ss-all           Print splice sites including those not in the global index" << endl
     << "  --exon             Print exons" << endl
+    << "  --footprint        Print the memory taken by each part of the index and" << endl
+    << "                     the RSS when loaded onto the heap and with --mm" << endl
+    << "  --footprint-reads <path> With --footprint, also report which pages of the" << endl
+    << "                     index searching the reads in <path> (FASTA/FASTQ) touches" << endl
 	<< "  -e/--ht2-ref       Reconstruct reference from ." << gfm_ext << " (slow, preserves colors)" << endl
 	<< "  -v/--verbose       Verbose output (for debugging)" << endl
 	<< "  -h/--help          print detailed description of tool and its options" << endl
@@ -160,6 +174,8 @@ static void parseOptions(int argc, char **argv) {
             case ARG_SPLICESITE: splicesite_only = true; break;
             case ARG_SPLICESITE_ALL: splicesite_all_only = true; break;
             case ARG_EXON: exon_only = true; break;
+            case ARG_FOOTPRINT: footprint_only = true; break;
+            case ARG_FOOTPRINT_READS: footprint_reads = optarg; break;
 			case 's': summarize_only = true; break;
 			case 'a': across = parseInt(-1, "-a/--across arg must be at least 1"); break;
 			case -1: break; /* Done with options. */
@@ -634,6 +650,382 @@ static void print_index_summary(
     cout << "Num. Exons: " << numExons << endl;
 }
 
+/**
+ * Resident set size of this process in bytes, from /proc/self/statm, or 0
+ * where that isn't available.
+ */
+static uint64_t footprint_rss() {
+	uint64_t rss = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+	if(f != NULL) {
+		unsigned long sz = 0, res = 0;
+		if(fscanf(f, "%lu %lu", &sz, &res) == 2) {
+			rss = (uint64_t)res * (uint64_t)sysconf(_SC_PAGESIZE);
+		}
+		fclose(f);
+	}
+	return rss;
+}
+
+// Parts of a GFM that are counted separately in the footprint
+enum {
+	FP_GBWT = 0,
+	FP_OFFS,
+	FP_FTAB,
+	FP_EFTAB,
+	FP_RSTARTS,
+	FP_OTHER,
+	FP_NUM
+};
+
+static const char* const fp_names[FP_NUM] = {
+	"GBWT", "Offs", "FTab", "EFTab", "RStarts", "Other"
+};
+
+/**
+ * Add the bytes taken by each part of 'gfm' when loaded to 'bytes' and
+ * return the total.
+ */
+template <typename T>
+static uint64_t footprint_gfm_bytes(const GFM<T>& gfm, uint64_t* bytes) {
+	const GFMParams<T>& gh = gfm.gh();
+	uint64_t b[FP_NUM];
+	b[FP_GBWT]    = gh.gbwtTotSz();
+	b[FP_OFFS]    = gh.offsSz();
+	b[FP_FTAB]    = gh.ftabSz();
+	b[FP_EFTAB]   = gh.eftabSz();
+	b[FP_RSTARTS] = (uint64_t)gfm.nFrag() * 3 * sizeof(T);
+	b[FP_OTHER]   = (uint64_t)gfm.nPat() * sizeof(T) +    // plen
+	                5 * sizeof(T) +                        // fchr
+	                gfm._zOffs.size() * (2 * sizeof(T) + sizeof(int));
+	for(size_t i = 0; i < gfm._refnames.size(); i++) {
+		b[FP_OTHER] += gfm._refnames[i].length();
+	}
+	uint64_t tot = 0;
+	for(int i = 0; i < FP_NUM; i++) {
+		bytes[i] += b[i];
+		tot += b[i];
+	}
+	return tot;
+}
+
+/**
+ * Pages of one index component touched while replaying reads, counted
+ * both for 4 KB pages and for 2 MB huge pages.
+ */
+struct FootprintPages {
+
+	void init(const char* name_, uint64_t bytes_) {
+		name = name_;
+		bytes = bytes_;
+		small.resize((size_t)(bytes / (1 << 12) + 1));
+		small.fill(false);
+		huge.resize((size_t)(bytes / (1 << 21) + 1));
+		huge.fill(false);
+		nsmall = nhuge = 0;
+	}
+
+	void touch(uint64_t off) {
+		size_t s = (size_t)(off >> 12), h = (size_t)(off >> 21);
+		if(s < small.size() && !small[s]) { small[s] = true; nsmall++; }
+		if(h < huge.size() && !huge[h]) { huge[h] = true; nhuge++; }
+	}
+
+	void print(ostream& fout) const {
+		fout << name << '\t' << bytes
+		     << '\t' << small.size() << '\t' << nsmall << '\t'
+		     << fixed << setprecision(2) << (100.0 * nsmall / small.size())
+		     << '\t' << huge.size() << '\t' << nhuge << '\t'
+		     << (100.0 * nhuge / huge.size()) << endl;
+	}
+
+	const char*  name;
+	uint64_t     bytes;
+	EList<bool>  small;
+	EList<bool>  huge;
+	size_t       nsmall;
+	size_t       nhuge;
+};
+
+/**
+ * Resolve the offset of 'row' the way GFM::getOffset does, recording the
+ * GBWT sides and SA samples read.
+ */
+template <typename index_t>
+static index_t footprint_resolve(
+	const GFM<index_t>& gfm,
+	index_t row,
+	index_t node,
+	FootprintPages& gbwtPages,
+	FootprintPages& offsPages)
+{
+	const GFMParams<index_t>& gh = gfm.gh();
+	for(index_t i = 0; i < gfm._zOffs.size(); i++) {
+		if(row == gfm._zOffs[i]) return 0;
+	}
+	if((node & gh.offMask()) == node) {
+		offsPages.touch((uint64_t)(node >> gh.offRate()) * sizeof(index_t));
+		index_t off = gfm.offs()[node >> gh.offRate()];
+		if(off != (index_t)INDEX_MAX) return off;
+	}
+	index_t jumps = 0;
+	SideLocus<index_t> l;
+	l.initFromRow(row, gh, gfm.gfm());
+	while(true) {
+		gbwtPages.touch(l._sideByteOff);
+		pair<index_t, index_t> node_range(0, 0);
+		pair<index_t, index_t> range = gfm.mapGLF1(row, l, &node_range ASSERT_ONLY(, false));
+		row = range.first;
+		jumps++;
+		for(index_t i = 0; i < gfm._zOffs.size(); i++) {
+			if(row == gfm._zOffs[i]) return jumps;
+		}
+		if((node_range.first & gh.offMask()) == node_range.first) {
+			offsPages.touch((uint64_t)(node_range.first >> gh.offRate()) * sizeof(index_t));
+			index_t off = gfm.offs()[node_range.first >> gh.offRate()];
+			if(off != (index_t)INDEX_MAX) return jumps + off;
+		}
+		l.initFromRow(row, gh, gfm.gfm());
+	}
+}
+
+/**
+ * Backward-search 'seq' from its 3' end through the global index as the
+ * aligner's exact-match search does, recording the ftab entries and GBWT
+ * sides read.  Once the range narrows to a single row, resolve its offset
+ * and return true with the joined offset in 'off'.
+ */
+template <typename index_t>
+static bool footprint_search(
+	const GFM<index_t>& gfm,
+	const BTDnaString& seq,
+	FootprintPages& gbwtPages,
+	FootprintPages& ftabPages,
+	FootprintPages& offsPages,
+	index_t& off)
+{
+	const GFMParams<index_t>& gh = gfm.gh();
+	const index_t ftabChars = gh.ftabChars();
+	const index_t len = (index_t)seq.length();
+	if(len <= ftabChars) return false;
+	for(index_t i = len - ftabChars; i < len; i++) {
+		if(seq[i] > 3) return false;
+	}
+	ftabPages.touch((uint64_t)gfm.ftabSeqToInt(seq, len - ftabChars, false) * sizeof(index_t));
+	pair<index_t, index_t> range(0, 0), node_range(0, 0);
+	if(!gfm.ftabLoHi(seq, len - ftabChars, false, range.first, range.second) ||
+	   range.first >= range.second) {
+		return false;
+	}
+	SideLocus<index_t> tloc, bloc;
+	for(index_t dep = ftabChars; dep < len; dep++) {
+		int nt = seq[len - dep - 1];
+		if(nt > 3) return false;
+		if(range.second - range.first == 1) {
+			tloc.initFromRow(range.first, gh, gfm.gfm());
+			bloc.invalidate();
+		} else {
+			SideLocus<index_t>::initFromTopBot(range.first, range.second, gh, gfm.gfm(), tloc, bloc);
+		}
+		gbwtPages.touch(tloc._sideByteOff);
+		pair<index_t, index_t> rangeTemp;
+		if(bloc.valid()) {
+			gbwtPages.touch(bloc._sideByteOff);
+			rangeTemp = gfm.mapGLF(tloc, bloc, nt, &node_range);
+		} else {
+			rangeTemp = gfm.mapGLF1(range.first, tloc, nt, &node_range ASSERT_ONLY(, false));
+		}
+		if(rangeTemp.first == (index_t)INDEX_MAX || rangeTemp.first >= rangeTemp.second) {
+			return false;
+		}
+		range = rangeTemp;
+		if(range.second - range.first == 1 && node_range.second - node_range.first == 1) {
+			off = footprint_resolve(gfm, range.first, node_range.first, gbwtPages, offsPages);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Read the next sequence from a FASTA or FASTQ file into 'seq'.  Returns
+ * false at the end of the file.
+ */
+static bool footprint_next_read(istream& in, BTDnaString& seq) {
+	string line;
+	while(getline(in, line)) {
+		if(line.empty()) continue;
+		if(line[0] == '>' || line[0] == '@') {
+			bool fastq = (line[0] == '@');
+			if(!getline(in, line)) return false;
+			seq.installChars(line.c_str(), line.length());
+			if(fastq) {
+				getline(in, line); // +
+				getline(in, line); // qualities
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Print the bytes each part of the index takes once loaded, the resident
+ * set size that results from loading it onto the heap and with --mm, and,
+ * if 'readsFile' is given, the fraction of each part's 4 KB and 2 MB pages
+ * that searching and resolving the reads in it touches.
+ */
+template <typename index_t>
+static void print_index_footprint(
+	const string& fname,
+	const string& readsFile,
+	ostream& fout)
+{
+	uint64_t rssHeap = 0, rssMm = 0, rssMmSwept = 0;
+	for(int pass = 0; pass < 3; pass++) {
+		// Pass 0 loads onto the heap and does the accounting; passes 1 and
+		// 2 only measure RSS with memory-mapped files, without and with
+		// touching every page
+		bool useMm = (pass > 0), sweep = (pass == 2);
+		uint64_t rss0 = footprint_rss();
+		ALTDB<index_t> altdb;
+		HGFM<index_t, uint16_t> gfm(
+		                            fname,
+		                            &altdb,
+		                            -1,       // don't care about entire-reverse
+		                            true,     // index is for the forward direction
+		                            -1,       // offrate (-1 = index default)
+		                            0,        // offrate-plus (0 = index default)
+		                            useMm,    // use memory-mapped IO
+		                            false,    // use shared memory
+		                            sweep,    // sweep memory-mapped memory
+		                            true,     // load names?
+		                            true,     // load SA sample?
+		                            true,     // load ftab?
+		                            true,     // load rstarts?
+		                            true,     // load splice sites?
+		                            verbose,  // be talkative?
+		                            verbose,  // be talkative at startup?
+		                            false,    // pass up memory exceptions?
+		                            false,    // sanity check?
+		                            true);    // use haplotypes?
+		gfm.loadIntoMemory(
+		                   -1,     // need entire reverse
+		                   true,   // load SA sample
+		                   true,   // load ftab
+		                   true,   // load rstarts
+		                   true,   // load names
+		                   verbose);  // verbose
+		BitPairReference ref(
+		                     fname,
+		                     false,    // not colorspace
+		                     false,    // sanity check
+		                     NULL,
+		                     NULL,
+		                     false,
+		                     useMm,    // use memory-mapped IO
+		                     false,    // use shared memory
+		                     sweep,    // sweep memory-mapped memory
+		                     verbose,
+		                     verbose);
+		uint64_t rss = footprint_rss() - rss0;
+		if(pass == 1) { rssMm = rss; continue; }
+		if(pass == 2) { rssMmSwept = rss; continue; }
+		rssHeap = rss;
+
+		uint64_t global[FP_NUM] = { 0 }, local[FP_NUM] = { 0 };
+		uint64_t globalTot = footprint_gfm_bytes(gfm, global);
+		EList<uint64_t> localSizes;
+		for(size_t t = 0; t < gfm._localGFMs.size(); t++) {
+			for(size_t i = 0; i < gfm._localGFMs[t].size(); i++) {
+				localSizes.push_back(footprint_gfm_bytes(*gfm._localGFMs[t][i], local));
+			}
+		}
+		localSizes.sort();
+		uint64_t localTot = 0;
+		for(size_t i = 0; i < localSizes.size(); i++) localTot += localSizes[i];
+		uint64_t altBytes = altdb.alts().size() * sizeof(ALT<index_t>);
+		uint64_t haplotypeBytes = altdb.haplotypes().size() * sizeof(Haplotype<index_t>);
+		for(size_t i = 0; i < altdb.haplotypes().size(); i++) {
+			haplotypeBytes += altdb.haplotypes()[i].alts.size() * sizeof(index_t);
+		}
+		uint64_t altnameBytes = 0;
+		for(size_t i = 0; i < altdb.altnames().size(); i++) {
+			altnameBytes += altdb.altnames()[i].length();
+		}
+		uint64_t refBytes = ref.bufAllocSz();
+
+		fout << "Component\tBytes" << endl;
+		for(int i = 0; i < FP_NUM; i++) {
+			fout << "Global-" << fp_names[i] << '\t' << global[i] << endl;
+		}
+		fout << "Global-Total\t" << globalTot << endl;
+		fout << "Local-GFMs\t" << localSizes.size() << endl;
+		for(int i = 0; i < FP_NUM; i++) {
+			fout << "Local-" << fp_names[i] << '\t' << local[i] << endl;
+		}
+		if(!localSizes.empty()) {
+			fout << "Local-Min\t" << localSizes[0] << endl
+			     << "Local-Median\t" << localSizes[localSizes.size() / 2] << endl
+			     << "Local-Max\t" << localSizes.back() << endl;
+		}
+		fout << "Local-Total\t" << localTot << endl
+		     << "ALTs\t" << altBytes << endl
+		     << "Haplotypes\t" << haplotypeBytes << endl
+		     << "ALT-Names\t" << altnameBytes << endl
+		     << "Reference\t" << refBytes << endl
+		     << "Total\t" << (globalTot + localTot + altBytes + haplotypeBytes + altnameBytes + refBytes) << endl;
+
+		if(readsFile.empty()) continue;
+		ifstream in(readsFile.c_str());
+		if(!in.good()) {
+			cerr << "Error: could not open " << readsFile.c_str() << endl;
+			throw 1;
+		}
+		FootprintPages gbwtPages, ftabPages, offsPages, refPages;
+		gbwtPages.init("Global-GBWT", global[FP_GBWT]);
+		ftabPages.init("Global-FTab", global[FP_FTAB]);
+		offsPages.init("Global-Offs", global[FP_OFFS]);
+		refPages.init("Reference", refBytes);
+		EList<const void*> locals;
+		BTDnaString seq;
+		size_t nreads = 0, nresolved = 0;
+		while(footprint_next_read(in, seq)) {
+			nreads++;
+			for(int fw = 0; fw < 2; fw++) {
+				if(fw == 1) seq.reverseComp();
+				index_t off = 0;
+				if(!footprint_search(gfm, seq, gbwtPages, ftabPages, offsPages, off)) continue;
+				nresolved++;
+				index_t tidx = 0, toff = 0, tlen = 0;
+				bool straddled = false;
+				gfm.joinedToTextOff(1, off, tidx, toff, tlen, true, straddled);
+				if(tidx == (index_t)INDEX_MAX) continue;
+				refPages.touch(((uint64_t)ref.pastedOffset(tidx) + toff) >> 2);
+				const void* lgfm = gfm.getLocalGFM(tidx, toff);
+				if(lgfm != NULL) locals.push_back(lgfm);
+			}
+		}
+		locals.sort();
+		size_t nlocals = 0;
+		for(size_t i = 0; i < locals.size(); i++) {
+			if(i == 0 || locals[i] != locals[i-1]) nlocals++;
+		}
+		fout << endl
+		     << "Access profile of " << nreads << " reads (" << nresolved << " strands resolved)" << endl
+		     << "Component\tBytes\tPages-4K\tTouched-4K\tTouched-4K%\tPages-2M\tTouched-2M\tTouched-2M%" << endl;
+		gbwtPages.print(fout);
+		ftabPages.print(fout);
+		offsPages.print(fout);
+		refPages.print(fout);
+		fout << "Local-GFMs touched\t" << nlocals << " of " << localSizes.size() << endl;
+	}
+	fout << endl
+	     << "RSS-Heap\t" << rssHeap << endl
+	     << "RSS-MM\t" << rssMm << endl
+	     << "RSS-MM-Swept\t" << rssMmSwept << endl;
+}
+
 extern void initializeCntLut();
 extern void initializeCntBit();
 
@@ -657,6 +1049,8 @@ static void driver(
         print_splicesites<TIndexOffU>(adjustedEbwtFileBase, cout);
     } else if(exon_only) {
         print_exons<TIndexOffU>(adjustedEbwtFileBase, cout);
+    } else if(footprint_only) {
+        print_index_footprint<TIndexOffU>(adjustedEbwtFileBase, footprint_reads, cout);
     } else {
         // Initialize Ebwt object
         ALTDB<TIndexOffU> altdb;
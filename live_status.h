@@ -0,0 +1,331 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIVE_STATUS_H_
+#define LIVE_STATUS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <new>
+#include "ds.h"
+#include "ticks.h"
+#include "tinythread.h"
+#include "pat.h"
+#include "aln_sink.h"
+
+/**
+ * Progress counters for one worker thread.  Only the owning worker writes
+ * them and the status thread reads them without locking, so each slot
+ * gets a cache line to itself; LiveStatus allocates them 64-byte aligned.
+ */
+struct LiveStatusSlot {
+
+	LiveStatusSlot() { reset(); }
+
+	void reset() {
+		reads = busy = beg = 0;
+	}
+
+	/**
+	 * The worker is starting on a read or pair.
+	 */
+	void beginRead() {
+		beg = cpuTicks();
+	}
+
+	/**
+	 * The worker is done with the read or pair it started on.
+	 */
+	void finishRead() {
+		busy = busy + (cpuTicks() - beg);
+		reads = reads + 1;
+	}
+
+	volatile uint64_t reads; // reads/pairs finished
+	volatile uint64_t busy;  // ticks spent between beginRead and finishRead
+	uint64_t beg;            // tick count at the last beginRead
+	char pad[64 - 3 * sizeof(uint64_t)];
+};
+
+/**
+ * Writes a JSON snapshot of the progress of an alignment job to a file
+ * every few seconds from a thread of its own, so that a workflow manager
+ * can follow a long run and notice when it stalls.  The file is written
+ * to a temporary name and renamed into place, so readers never see a
+ * partial snapshot.  A last snapshot with "done": true is written when
+ * the job finishes.
+ *
+ * Workers only touch their own LiveStatusSlot; alignment rates are taken
+ * from the global reporting metrics, which workers merge into every few
+ * reads while the status file is on.
+ */
+template<typename index_t>
+class LiveStatus {
+
+public:
+
+	LiveStatus(
+		const std::string& fname,
+		int ival,
+		size_t nthreads,
+		PairedPatternSource& patsrc,
+		AlnSink<index_t>& msink) :
+		fname_(fname),
+		ival_(ival),
+		slotsBuf_(NULL),
+		slots_(NULL),
+		nslots_(nthreads),
+		last_(nthreads, MISC_CAT),
+		lastBusy_(nthreads, MISC_CAT),
+		lastChange_(nthreads, MISC_CAT),
+		patsrc_(patsrc),
+		msink_(msink),
+		thread_(NULL),
+		done_(false)
+	{
+		// EList doesn't align its buffer, so align the slots by hand
+		assert_eq(0, sizeof(LiveStatusSlot) % 64);
+		slotsBuf_ = new char[slotsBytes()];
+		gMemTally.add(MISC_CAT, slotsBytes());
+		size_t addr = ((size_t)slotsBuf_ + 63) & ~(size_t)63;
+		slots_ = reinterpret_cast<LiveStatusSlot*>(addr);
+		for(size_t i = 0; i < nslots_; i++) {
+			new(slots_ + i) LiveStatusSlot();
+		}
+		last_.resize(nthreads);
+		last_.fill(0);
+		lastBusy_.resize(nthreads);
+		lastBusy_.fill(0);
+		lastChange_.resize(nthreads);
+		lastChange_.fill(0.0);
+	}
+
+	~LiveStatus() {
+		stop();
+		delete[] slotsBuf_;
+		gMemTally.del(MISC_CAT, slotsBytes());
+	}
+
+	/**
+	 * Return the slot for worker 'tid' (0-based).
+	 */
+	LiveStatusSlot& slot(size_t tid) {
+		return slots_[tid];
+	}
+
+	/**
+	 * Write the first snapshot and start the status thread.
+	 */
+	void start() {
+		start_ = lastTime_ = now();
+		lastTicks_ = cpuTicks();
+		lastReads_ = 0;
+		lastChange_.fill(start_);
+		write(false);
+		thread_ = new tthread::thread(LiveStatus<index_t>::run, (void*)this);
+	}
+
+	/**
+	 * Stop the status thread and write the final snapshot.
+	 */
+	void stop() {
+		if(thread_ == NULL) return;
+		done_ = true;
+		thread_->join();
+		delete thread_;
+		thread_ = NULL;
+		write(true);
+	}
+
+protected:
+
+	static void run(void *vp) {
+		LiveStatus<index_t>* st = (LiveStatus<index_t>*)vp;
+		double next = st->start_ + st->ival_;
+		while(!st->done_) {
+			tthread::this_thread::sleep_for(tthread::chrono::milliseconds(100));
+			if(!st->done_ && now() >= next) {
+				st->write(false);
+				next += st->ival_;
+			}
+		}
+	}
+
+	size_t slotsBytes() const {
+		return nslots_ * sizeof(LiveStatusSlot) + 63;
+	}
+
+	static double now() {
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		return tv.tv_sec + tv.tv_usec / 1e6;
+	}
+
+	/**
+	 * Resident set size in bytes, from /proc/self/statm, or 0 where that
+	 * isn't available.
+	 */
+	static uint64_t rssBytes() {
+		uint64_t rss = 0;
+		FILE *f = fopen("/proc/self/statm", "r");
+		if(f != NULL) {
+			unsigned long sz = 0, res = 0;
+			if(fscanf(f, "%lu %lu", &sz, &res) == 2) {
+				rss = (uint64_t)res * (uint64_t)sysconf(_SC_PAGESIZE);
+			}
+			fclose(f);
+		}
+		return rss;
+	}
+
+	static uint64_t peakRssBytes() {
+		struct rusage ru;
+		if(getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+		return (uint64_t)ru.ru_maxrss;
+#else
+		return (uint64_t)ru.ru_maxrss * 1024;
+#endif
+	}
+
+	static double pct(uint64_t num, uint64_t denom) {
+		return denom == 0 ? 0.0 : 100.0 * num / denom;
+	}
+
+	/**
+	 * Write a snapshot.  Only called from one thread at a time: by start()
+	 * and stop() before and after the status thread runs, and by the
+	 * status thread in between.
+	 */
+	void write(bool done) {
+		double t = now();
+		uint64_t ticks = cpuTicks();
+		double dt = t - lastTime_;
+		uint64_t dticks = ticks - lastTicks_;
+		ReportingMetrics met;
+		msink_.snapshotMetrics(met);
+		uint64_t reads = 0;
+		for(size_t i = 0; i < nslots_; i++) {
+			reads += slots_[i].reads;
+		}
+		// Reads taken from the input so far; read without locking, so it
+		// may lag the workers' counts slightly
+		pair<TReadId, TReadId> cnt = patsrc_.readCnt();
+		int64_t parsedSigned = (int64_t)cnt.first + (int64_t)cnt.second;
+		uint64_t parsed = parsedSigned < (int64_t)reads ? reads : (uint64_t)parsedSigned;
+		size_t outBuffered = 0;
+		TReadId outFlushed = 0;
+		msink_.outq().snapshot(outBuffered, outFlushed);
+		uint64_t totAlCand = met.nunpaired + met.npaired * 2;
+		uint64_t totAl = (met.nconcord_uni + met.nconcord_rep) * 2 + met.ndiscord * 2 +
+		                 met.nunp_0_uni + met.nunp_0_rep + met.nunp_uni + met.nunp_rep;
+		uint64_t unpMates = met.nunpaired + (met.nconcord_0 - met.ndiscord) * 2;
+		uint64_t unpMatesAl = met.nunp_0_uni + met.nunp_0_rep + met.nunp_uni + met.nunp_rep;
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(3);
+		os << "{\n"
+		   << "  \"time\": " << (uint64_t)t << ",\n"
+		   << "  \"elapsed_secs\": " << (t - start_) << ",\n"
+		   << "  \"done\": " << (done ? "true" : "false") << ",\n"
+		   << "  \"reads\": {\n"
+		   << "    \"input\": " << parsed << ",\n"
+		   << "    \"processed\": " << reads << ",\n"
+		   << "    \"per_sec\": " << (dt > 0 ? (reads - lastReads_) / dt : 0.0) << ",\n"
+		   << "    \"per_sec_avg\": " << (t > start_ ? reads / (t - start_) : 0.0) << "\n"
+		   << "  },\n"
+		   << "  \"alignment\": {\n"
+		   << "    \"reported_reads\": " << met.nread << ",\n"
+		   << "    \"pairs\": " << met.npaired << ",\n"
+		   << "    \"unpaired_reads\": " << met.nunpaired << ",\n"
+		   << "    \"concordant_pct\": " << pct(met.nconcord_uni + met.nconcord_rep, met.npaired) << ",\n"
+		   << "    \"discordant_pct\": " << pct(met.ndiscord, met.npaired) << ",\n"
+		   << "    \"unpaired_mates_aligned_pct\": " << pct(unpMatesAl, unpMates) << ",\n"
+		   << "    \"overall_pct\": " << pct(totAl, totAlCand) << "\n"
+		   << "  },\n"
+		   << "  \"memory\": {\n"
+		   << "    \"rss_bytes\": " << rssBytes() << ",\n"
+		   << "    \"peak_rss_bytes\": " << peakRssBytes() << ",\n"
+		   << "    \"tracked_bytes\": " << gMemTally.total() << "\n"
+		   << "  },\n"
+		   << "  \"queues\": {\n"
+		   << "    \"in_flight\": " << (parsed - reads) << ",\n"
+		   << "    \"output_buffered\": " << outBuffered << ",\n"
+		   << "    \"output_flushed\": " << (uint64_t)outFlushed << "\n"
+		   << "  },\n"
+		   << "  \"threads\": [";
+		for(size_t i = 0; i < nslots_; i++) {
+			uint64_t r = slots_[i].reads, busy = slots_[i].busy;
+			if(r != last_[i]) lastChange_[i] = t;
+			double util = dticks > 0 ? (double)(busy - lastBusy_[i]) / dticks : 0.0;
+			if(util > 1.0) util = 1.0;
+			os << (i == 0 ? "\n" : ",\n")
+			   << "    {\"id\": " << (i + 1)
+			   << ", \"reads\": " << r
+			   << ", \"per_sec\": " << (dt > 0 ? (r - last_[i]) / dt : 0.0)
+			   << ", \"utilization\": " << util
+			   << ", \"idle_secs\": " << (t - lastChange_[i]) << "}";
+			last_[i] = r;
+			lastBusy_[i] = busy;
+		}
+		os << "\n  ]\n}\n";
+		lastTime_ = t;
+		lastTicks_ = ticks;
+		lastReads_ = reads;
+
+		std::string tmp = fname_ + ".tmp";
+		FILE *f = fopen(tmp.c_str(), "w");
+		if(f == NULL) {
+			std::cerr << "Warning: could not open " << tmp.c_str() << " for writing" << std::endl;
+			return;
+		}
+		std::string s = os.str();
+		bool ok = fwrite(s.c_str(), 1, s.length(), f) == s.length();
+		ok = (fclose(f) == 0) && ok;
+		if(!ok || rename(tmp.c_str(), fname_.c_str()) != 0) {
+			std::cerr << "Warning: could not write " << fname_.c_str() << std::endl;
+		}
+	}
+
+	std::string             fname_;      // status file
+	int                     ival_;       // seconds between snapshots
+	char*                   slotsBuf_;   // holds slots_, with room to align it
+	LiveStatusSlot*         slots_;      // one per worker, 64-byte aligned
+	size_t                  nslots_;
+	EList<uint64_t>         last_;       // per-worker reads at the last snapshot
+	EList<uint64_t>         lastBusy_;   // per-worker busy ticks at the last snapshot
+	EList<double>           lastChange_; // time each worker's read count last changed
+	PairedPatternSource&    patsrc_;
+	AlnSink<index_t>&       msink_;
+	tthread::thread*        thread_;
+	volatile bool           done_;
+	double                  start_;      // time of the first snapshot
+	double                  lastTime_;   // time of the last snapshot
+	uint64_t                lastTicks_;  // tick count at the last snapshot
+	uint64_t                lastReads_;  // reads/pairs finished at the last snapshot
+};
+
+#endif /*ndef LIVE_STATUS_H_*/
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOCK_PROFILE_H_
+#define LOCK_PROFILE_H_
+
+/*
+ * Lock contention profiling, compiled in with -DLOCK_PROFILE (make
+ * LOCK_PROFILE=1).  MUTEX_T then becomes a ProfiledMutex, which counts
+ * acquisitions, contended acquisitions, ticks spent waiting and ticks spent
+ * holding the lock, and charges them to the LockSite the mutex was named
+ * after with LOCK_SITE().  Mutexes that were never named are charged to
+ * "(unnamed)".  lockProfileReport() prints one line per site.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <iomanip>
+#include "ticks.h"
+#include "tinythread.h"
+#include "fast_mutex.h"
+
+#ifdef NO_SPINLOCK
+#   define LOCK_PROFILE_BASE_T tthread::mutex
+#else
+#   define LOCK_PROFILE_BASE_T tthread::fast_mutex
+#endif
+
+/**
+ * Counters for one named lock site.  Several mutexes (e.g. one per
+ * metrics object) may share a site, and so may several threads.  To keep
+ * the profiler from adding contention of its own, each thread counts into
+ * its own cache-line-sized slot; the slots are summed when the profile is
+ * reported.  Threads beyond the first NSLOTS-1 share the last slot and
+ * update it atomically.  Sites link themselves into a global list when
+ * constructed.
+ */
+class LockSite {
+public:
+	static const int NSLOTS = 64;
+
+	struct Slot {
+		uint64_t acq;   // # acquisitions
+		uint64_t cont;  // # acquisitions that found the lock taken
+		uint64_t wait;  // ticks spent waiting in contended acquisitions
+		uint64_t hold;  // ticks between acquisition and release
+	} __attribute__((aligned(64)));
+
+	LockSite(const char* name) : name_(name) {
+		memset(slots_, 0, sizeof(slots_));
+		LockSite* head;
+		do {
+			head = sites();
+			next_ = head;
+		} while(!__sync_bool_compare_and_swap(&sites(), head, this));
+	}
+
+	/**
+	 * Record one acquisition.
+	 */
+	void record(bool contended, uint64_t wait, uint64_t hold) {
+		int t = thread();
+		Slot& s = slots_[t];
+		if(t < NSLOTS - 1) {
+			s.acq++;
+			if(contended) {
+				s.cont++;
+				s.wait += wait;
+			}
+			s.hold += hold;
+		} else {
+			__sync_fetch_and_add(&s.acq, 1);
+			if(contended) {
+				__sync_fetch_and_add(&s.cont, 1);
+				__sync_fetch_and_add(&s.wait, wait);
+			}
+			if(hold > 0) __sync_fetch_and_add(&s.hold, hold);
+		}
+	}
+
+	void addHold(uint64_t hold) {
+		int t = thread();
+		if(t < NSLOTS - 1) {
+			slots_[t].hold += hold;
+		} else {
+			__sync_fetch_and_add(&slots_[t].hold, hold);
+		}
+	}
+
+	/**
+	 * Sum the counters of all threads into 'tot'.  Only meaningful once
+	 * the threads are done.
+	 */
+	void total(Slot& tot) const {
+		memset(&tot, 0, sizeof(tot));
+		for(int i = 0; i < NSLOTS; i++) {
+			tot.acq  += slots_[i].acq;
+			tot.cont += slots_[i].cont;
+			tot.wait += slots_[i].wait;
+			tot.hold += slots_[i].hold;
+		}
+	}
+
+	/**
+	 * Head of the list of all sites.
+	 */
+	static LockSite*& sites() {
+		static LockSite* head = NULL;
+		return head;
+	}
+
+	/**
+	 * Site charged for mutexes that were never named.
+	 */
+	static LockSite* unnamed() {
+		static LockSite site("(unnamed)");
+		return &site;
+	}
+
+	const char* name_;
+	LockSite* next_;
+
+private:
+	/**
+	 * Return the calling thread's slot, numbering threads in the order
+	 * they first take a profiled lock.
+	 */
+	static int thread() {
+		static int nthreads = 0;
+		static thread_local int t = -1;
+		if(t < 0) {
+			t = __sync_fetch_and_add(&nthreads, 1);
+			if(t > NSLOTS - 1) t = NSLOTS - 1;
+		}
+		return t;
+	}
+
+	Slot slots_[NSLOTS];
+};
+
+/**
+ * Drop-in replacement for MUTEX_T that reports to a LockSite.
+ */
+class ProfiledMutex {
+public:
+	ProfiledMutex() : site_(NULL), acquired_(0) { }
+
+	/// Copies get a fresh lock but stay on the same site; mutexes are
+	/// copied when they are pushed onto lists
+	ProfiledMutex(const ProfiledMutex& o) : site_(o.site_), acquired_(0) { }
+
+	ProfiledMutex& operator=(const ProfiledMutex& o) {
+		site_ = o.site_;
+		return *this;
+	}
+
+	void setSite(LockSite* site) { site_ = site; }
+
+	inline void lock() {
+		bool contended = false;
+		uint64_t beg = 0;
+		if(!m_.try_lock()) {
+			contended = true;
+			beg = cpuTicks();
+			m_.lock();
+		}
+		acquired_ = cpuTicks();
+		site()->record(contended, contended ? acquired_ - beg : 0, 0);
+	}
+
+	inline bool try_lock() {
+		if(!m_.try_lock()) return false;
+		acquired_ = cpuTicks();
+		site()->record(false, 0, 0);
+		return true;
+	}
+
+	inline void unlock() {
+		site()->addHold(cpuTicks() - acquired_);
+		m_.unlock();
+	}
+
+private:
+	LockSite* site() { return site_ != NULL ? site_ : LockSite::unnamed(); }
+
+	LOCK_PROFILE_BASE_T m_;
+	LockSite* site_;
+	uint64_t acquired_; // tick count at acquisition
+};
+
+/**
+ * Name the site mutex 'm' reports to.  Every use of the macro is its own
+ * site, so name a lock in one place only (typically the constructor of the
+ * class that owns it).
+ */
+#define LOCK_SITE(m, name) { \
+	static LockSite lockSite_(name); \
+	(m).setSite(&lockSite_); \
+}
+
+/**
+ * Print a table of all lock sites that saw any acquisitions.
+ */
+static inline void lockProfileReport(std::ostream& os) {
+	os << "Lock profile (ticks):" << std::endl
+	   << "Site\tAcquired\tContended\tContended%\tWaitTicks\tHoldTicks" << std::endl;
+	for(LockSite* s = LockSite::sites(); s != NULL; s = s->next_) {
+		LockSite::Slot tot;
+		s->total(tot);
+		if(tot.acq == 0) continue;
+		os << s->name_ << '\t' << tot.acq << '\t' << tot.cont << '\t'
+		   << std::fixed << std::setprecision(2) << (100.0 * tot.cont / tot.acq) << '\t'
+		   << tot.wait << '\t' << tot.hold << std::endl;
+	}
+}
+
+#endif /*ndef LOCK_PROFILE_H_*/
@@ -183,7 +183,35 @@ enum {
     ARG_CODIS,
     ARG_NO_TEMPLATELEN_ADJUSTMENT,
     ARG_SUMMARY_FILE,
-    ARG_NEW_SUMMARY
+    ARG_NEW_SUMMARY,
+    ARG_UN,                     // --un
+    ARG_UN_GZ,                  // --un-gz
+    ARG_UN_BZ2,                 // --un-bz2
+    ARG_AL,                     // --al
+    ARG_AL_GZ,                  // --al-gz
+    ARG_AL_BZ2,                 // --al-bz2
+    ARG_UN_CONC,                // --un-conc
+    ARG_UN_CONC_GZ,             // --un-conc-gz
+    ARG_UN_CONC_BZ2,            // --un-conc-bz2
+    ARG_AL_CONC,                // --al-conc
+    ARG_AL_CONC_GZ,             // --al-conc-gz
+    ARG_AL_CONC_BZ2,            // --al-conc-bz2
+    ARG_AL_CONC_DISC,           // --al-conc-disc
+    ARG_AL_CONC_DISC_GZ,        // --al-conc-disc-gz
+    ARG_AL_CONC_DISC_BZ2,       // --al-conc-disc-bz2
+    ARG_DUP_CACHE,              // --dup-cache
+    ARG_MAX_READ_FMOPS,         // --max-read-fmops
+    ARG_MAX_READ_EXTS,          // --max-read-exts
+    ARG_MAX_READ_USECS,         // --max-read-usecs
+    ARG_SLOW_READS,             // --slow-reads
+    ARG_SLOW_READS_N,           // --slow-reads-n
+    ARG_SLOW_READS_USECS,       // --slow-reads-usecs
+    ARG_STATUS_FILE,            // --status-file
+    ARG_STATUS_IVAL,            // --status-ival
+    ARG_CPU_PIN,                // --pin
+    ARG_CPU_LIST,               // --cpu-list
+    ARG_DETERMINISTIC,          // --deterministic
+    ARG_DETERMINISTIC_EPOCH     // --deterministic-epoch
 };
 
 #endif
@@ -34,10 +34,12 @@ void OutputQueue::beginRead(TReadId rdid, size_t threadId) {
 			// Make sure there's enough room in lines_, started_ and finished_
 			size_t oldsz = lines_.size();
 			lines_.resize(rdid - cur_ + 1);
+			dumps_.resize(rdid - cur_ + 1);
 			started_.resize(rdid - cur_ + 1);
 			finished_.resize(rdid - cur_ + 1);
 			for(size_t i = oldsz; i < lines_.size(); i++) {
 				started_[i] = finished_[i] = false;
+				dumps_[i].clear();
 			}
 		}
 		started_[rdid - cur_] = true;
@@ -48,7 +50,12 @@ void OutputQueue::beginRead(TReadId rdid, size_t threadId) {
 /**
  * Writer is finished writing to 
  */
-void OutputQueue::finishRead(const BTString& rec, TReadId rdid, size_t threadId) {
+void OutputQueue::finishRead(
+	const BTString& rec,
+	TReadId rdid,
+	size_t threadId,
+	ReadDumpRec* dumpRec)
+{
 	ThreadSafe t(&mutex_m, threadSafe_);
 	if(reorder_) {
 		assert_geq(rdid, cur_);
@@ -58,12 +65,22 @@ void OutputQueue::finishRead(const BTString& rec, TReadId rdid, size_t threadId)
 		assert(started_[rdid - cur_]);
 		assert(!finished_[rdid - cur_]);
 		lines_[rdid - cur_] = rec;
+		if(dumpRec != NULL) {
+			dumps_[rdid - cur_] = *dumpRec;
+			dumpRec->clear();
+		}
 		nfinished_++;
 		finished_[rdid - cur_] = true;
 		flush(false, false); // don't force; already have lock
 	} else {
 		// obuf_ is the OutFileBuf for the output file
 		obuf_.writeString(rec);
+		if(dumpRec != NULL) {
+			if(dumpRec->cats != 0 && dump_ != NULL) {
+				dump_->writeOrdered(*dumpRec);
+			}
+			dumpRec->clear();
+		}
 		nfinished_++;
 		nflushed_++;
 	}
@@ -89,8 +106,12 @@ void OutputQueue::flush(bool force, bool getLock) {
 			assert(started_[i]);
 			assert(finished_[i]);
 			obuf_.writeString(lines_[i]);
+			if(dumps_[i].cats != 0 && dump_ != NULL) {
+				dump_->writeOrdered(dumps_[i]);
+			}
 		}
 		lines_.erase(0, nflush);
+		dumps_.erase(0, nflush);
 		started_.erase(0, nflush);
 		finished_.erase(0, nflush);
 		cur_ += nflush;
@@ -98,6 +119,16 @@ void OutputQueue::flush(bool force, bool getLock) {
 	}
 }
 
+/**
+ * Return the number of records buffered and flushed, taken together under
+ * the lock.
+ */
+void OutputQueue::snapshot(size_t& nbuffered, TReadId& nflushed) {
+	ThreadSafe t(&mutex_m, threadSafe_);
+	nbuffered = lines_.size();
+	nflushed = nflushed_;
+}
+
 #ifdef OUTQ_MAIN
 
 #include <iostream>
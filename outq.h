@@ -26,6 +26,8 @@
 #include "read.h"
 #include "threading.h"
 #include "mem_ids.h"
+#include "stage_timer.h"
+#include "read_dump.h"
 
 /**
  * Encapsulates a list of lines of output.  If the earliest as-yet-unreported
@@ -47,11 +49,13 @@ public:
 		bool threadSafe,
 		TReadId rdid = 0) :
 		obuf_(obuf),
+		dump_(NULL),
 		cur_(rdid),
 		nstarted_(0),
 		nfinished_(0),
 		nflushed_(0),
 		lines_(RES_CAT),
+		dumps_(RES_CAT),
 		started_(RES_CAT),
 		finished_(RES_CAT),
 		reorder_(reorder),
@@ -59,6 +63,7 @@ public:
         mutex_m()
 	{
 		assert(nthreads <= 1 || threadSafe);
+		LOCK_SITE(mutex_m, "OutputQueue");
 	}
 
 	/**
@@ -70,7 +75,19 @@ public:
 	/**
 	 * Writer is finished writing to 
 	 */
-	void finishRead(const BTString& rec, TReadId rdid, size_t threadId);
+	void finishRead(
+		const BTString& rec,
+		TReadId rdid,
+		size_t threadId,
+		ReadDumpRec* dumpRec = NULL);
+
+	/**
+	 * Set the ReadDump that --un/--al records passed to finishRead() are
+	 * written to, in the same order as the SAM records.
+	 */
+	void setReadDump(ReadDump* dump) {
+		dump_ = dump;
+	}
 	
 	/**
 	 * Return the number of records currently being buffered.
@@ -86,6 +103,12 @@ public:
 		return nflushed_;
 	}
 
+	/**
+	 * Return size() and numFlushed() as of one moment, under the lock, for
+	 * threads other than the workers to read while the queue is in use.
+	 */
+	void snapshot(size_t& nbuffered, TReadId& nflushed);
+
 	/**
 	 * Return the number of records that have been started so far.
 	 */
@@ -108,11 +131,13 @@ public:
 protected:
 
 	OutFileBuf&     obuf_;
+	ReadDump*       dump_;     // where --un/--al records go, if anywhere
 	TReadId         cur_;
 	TReadId         nstarted_;
 	TReadId         nfinished_;
 	TReadId         nflushed_;
 	EList<BTString> lines_;
+	EList<ReadDumpRec> dumps_; // --un/--al records parallel to lines_
 	EList<bool>     started_;
 	EList<bool>     finished_;
 	bool            reorder_;
@@ -126,17 +151,23 @@ public:
 		OutputQueue& q,
 		const BTString& rec,
 		TReadId rdid,
-		size_t threadId) :
+		size_t threadId,
+		StageMetrics* stageMet = NULL,
+		ReadDumpRec* dumpRec = NULL) :
 		q_(q),
 		rec_(rec),
 		rdid_(rdid),
-		threadId_(threadId)
+		threadId_(threadId),
+		stageMet_(stageMet),
+		dumpRec_(dumpRec)
 	{
+		StageTimer t(stageMet_, STAGE_OUTPUT);
 		q_.beginRead(rdid, threadId);
 	}
 	
 	~OutputQueueMark() {
-		q_.finishRead(rec_, rdid_, threadId_);
+		StageTimer t(stageMet_, STAGE_OUTPUT);
+		q_.finishRead(rec_, rdid_, threadId_, dumpRec_);
 	}
 	
 protected:
@@ -144,6 +175,8 @@ protected:
 	const BTString& rec_;
 	TReadId rdid_;
 	size_t threadId_;
+	StageMetrics* stageMet_; // charge queue time to STAGE_OUTPUT, if non-NULL
+	ReadDumpRec* dumpRec_;   // --un/--al records for the read, if non-NULL
 };
 
 #endif
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACKED_DNA_H_
+#define PACKED_DNA_H_
+
+#include <stdint.h>
+#include "assert_helpers.h"
+#include "ds.h"
+#include "sstring.h"
+
+/**
+ * DNA string packed 2 bits per base, 32 bases per 64-bit word, with base i
+ * in bits 2i and 2i+1 of its word (the layout BitPairReference uses for
+ * the reference).  Ns are stored as A in 'bases' and marked with both bits
+ * set in the parallel 'ns' mask, so that
+ *
+ *   (a.bases ^ b.bases) | a.ns | b.ns
+ *
+ * is nonzero in the two bits of every position where a and b mismatch or
+ * either has an N, which is how read and reference are compared.
+ */
+class PackedDnaString {
+
+public:
+
+	PackedDnaString() : len_(0) { }
+
+	/**
+	 * Pack 'seq' (bases 0-3, anything greater is an N).
+	 */
+	void install(const BTDnaString& seq) {
+		resize(seq.length());
+		for(size_t i = 0; i < len_; i++) {
+			int c = seq[i];
+			uint64_t sh = (i & 31) << 1;
+			if(c > 3) {
+				ns_[i >> 5] |= (uint64_t)3 << sh;
+			} else {
+				bases_[i >> 5] |= (uint64_t)c << sh;
+			}
+		}
+	}
+
+	/**
+	 * Make this a string of 'len' As, or of 'len' Ns if 'allNs' is true.
+	 * One extra word is kept at the end so windows can always read two
+	 * words.
+	 */
+	void resize(size_t len, bool allNs = false) {
+		len_ = len;
+		size_t nwords = (len + 31) / 32 + 1;
+		bases_.resize(nwords);
+		ns_.resize(nwords);
+		bases_.fillZero();
+		if(allNs) ns_.fill(~(uint64_t)0);
+		else      ns_.fillZero();
+	}
+
+	size_t length() const { return len_; }
+
+	void clear() { len_ = 0; bases_.clear(); ns_.clear(); }
+
+	/**
+	 * Return the 32 bases starting at 'off'; positions past the end are
+	 * unspecified.
+	 */
+	uint64_t bases(size_t off) const { return window(bases_, off); }
+
+	/**
+	 * Return the N mask of the 32 bases starting at 'off'; positions past
+	 * the end are unspecified.
+	 */
+	uint64_t ns(size_t off) const { return window(ns_, off); }
+
+	/**
+	 * Return base 'off' as 0-3, or 4 for an N.
+	 */
+	int get(size_t off) const {
+		assert_lt(off, len_);
+		uint64_t sh = (off & 31) << 1;
+		if((ns_[off >> 5] >> sh) & 1) return 4;
+		return (int)((bases_[off >> 5] >> sh) & 3);
+	}
+
+	/**
+	 * Set 'n' (at most 28) bases starting at 'off' to the low 2n bits of
+	 * 'word' and mark them as not Ns.
+	 */
+	void setBases(size_t off, uint64_t word, size_t n) {
+		assert_leq(n, 28);
+		assert_leq(off + n, len_);
+		if(n == 0) return;
+		uint64_t mask = ((uint64_t)1 << (n << 1)) - 1;
+		word &= mask;
+		size_t w = off >> 5;
+		uint64_t sh = (off & 31) << 1;
+		bases_[w] |= word << sh;
+		ns_[w] &= ~(mask << sh);
+		if(sh + (n << 1) > 64) {
+			bases_[w + 1] |= word >> (64 - sh);
+			ns_[w + 1] &= ~(mask >> (64 - sh));
+		}
+	}
+
+	/**
+	 * Return a mask with bit 2i set iff position i of the 'n' (at most 32)
+	 * positions compared mismatches, given the bases and N masks of both
+	 * sides as returned by bases() and ns().
+	 */
+	static uint64_t mismatches(
+		uint64_t abases, uint64_t ans,
+		uint64_t bbases, uint64_t bns,
+		size_t n)
+	{
+		assert_leq(n, 32);
+		uint64_t x = (abases ^ bbases) | ans | bns;
+		x = (x | (x >> 1)) & 0x5555555555555555ULL;
+		if(n < 32) x &= ((uint64_t)1 << (n << 1)) - 1;
+		return x;
+	}
+
+	/**
+	 * Return the index of the lowest set bit of 'x', which is nonzero.
+	 */
+	static int lowestBit(uint64_t x) {
+		assert_neq(0, x);
+#if defined(__GNUC__)
+		return __builtin_ctzll(x);
+#else
+		int i = 0;
+		while(((x >> i) & 1) == 0) i++;
+		return i;
+#endif
+	}
+
+	/**
+	 * Return the index of the highest set bit of 'x', which is nonzero.
+	 */
+	static int highestBit(uint64_t x) {
+		assert_neq(0, x);
+#if defined(__GNUC__)
+		return 63 - __builtin_clzll(x);
+#else
+		int i = 63;
+		while(((x >> i) & 1) == 0) i--;
+		return i;
+#endif
+	}
+
+protected:
+
+	static uint64_t window(const EList<uint64_t>& words, size_t off) {
+		size_t w = off >> 5;
+		uint64_t sh = (off & 31) << 1;
+		assert_lt(w + 1, words.size());
+		if(sh == 0) return words[w];
+		return (words[w] >> sh) | (words[w + 1] << (64 - sh));
+	}
+
+	size_t          len_;
+	EList<uint64_t> bases_;
+	EList<uint64_t> ns_;
+};
+
+#endif /*PACKED_DNA_H_*/
@@ -150,6 +150,7 @@ public:
 		useSpinlock_(p.useSpinlock),
 		mutex()
 	{
+		LOCK_SITE(mutex, "PatternSource");
 	}
 
 	virtual ~PatternSource() { }
@@ -278,7 +279,9 @@ protected:
  */
 class PairedPatternSource {
 public:
-	PairedPatternSource(const PatternParams& p) : mutex_m(), seed_(p.seed) {}
+	PairedPatternSource(const PatternParams& p) : mutex_m(), seed_(p.seed) {
+		LOCK_SITE(mutex_m, "PairedPatternSource");
+	}
 	virtual ~PairedPatternSource() { }
 
 	virtual void addWrapper() = 0;
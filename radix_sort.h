@@ -83,7 +83,6 @@ void radix_sort_in_place(T* begin, T* end, index_t (*hash)(T&), index_t maxv, in
 
     // {(maxv >> right_shift) + 1 <= BLOCKS},
     int occupied = (maxv >> right_shift) + 1;
-    time_t start = time(0);
     // count number in each bin
     index_t count[BLOCKS] = {0};
     for(T* curr = begin; curr != end; curr++) {
@@ -98,8 +97,6 @@ void radix_sort_in_place(T* begin, T* end, index_t (*hash)(T&), index_t maxv, in
         index[i] = place[i] = index[i - 1] + count[i - 1];
     }
     index[occupied] = end;
-    if(nthreads != 1) cerr << "COUNT NUMBER IN EACH BIN: " << time(0) - start << endl;
-    start = time(0);
     //put objects in proper place
     for(int bin = 0; bin < occupied; bin++) {
         while(place[bin] != index[bin + 1]) {
@@ -114,8 +111,6 @@ void radix_sort_in_place(T* begin, T* end, index_t (*hash)(T&), index_t maxv, in
             *place[bin]++ = curr;
         }
     }
-    if(nthreads != 1) cerr << "PLACE IN CORRECT BIN: " << time(0) - start << endl;
-    start = time(0);
     //sort partitions
     if(nthreads == 1) {
         for(int bin = 0; bin < occupied; bin++) {
@@ -141,7 +136,6 @@ void radix_sort_in_place(T* begin, T* end, index_t (*hash)(T&), index_t maxv, in
             threads[i]->join();
         }
     }
-    if(nthreads != 1) cerr << "FINISHED RECURSIVE SORTS: " << time(0) - start << endl;
 }
 
 template <typename T, typename index_t>
@@ -194,7 +188,6 @@ void radix_sort_copy(T* begin, T* end, T* o, index_t (*hash)(T&), index_t maxv,
     int right_shift = log_size - SHIFT;
     int occupied = (maxv >> right_shift) + 1;
     //count nodes
-    time_t start = time(0);
     EList<CountParams<T, index_t> > cparams; cparams.resizeExact(nthreads);
     AutoArray<tthread::thread*> threads1(nthreads);
     T* st = begin;
@@ -224,8 +217,6 @@ void radix_sort_copy(T* begin, T* end, T* o, index_t (*hash)(T&), index_t maxv,
             delete threads1[i];
         }
     }
-    if(nthreads != 1) cerr << "COUNT NUMBER IN EACH BIN: " << time(0) - start << endl;
-    start = time(0);
     //transform counts into index
     index_t tot = cparams[0].count[0];
     cparams[0].count[0] = 0;
@@ -257,8 +248,6 @@ void radix_sort_copy(T* begin, T* end, T* o, index_t (*hash)(T&), index_t maxv,
         delete[] cparams[i].count;
         delete threads1[i];
     }
-    if(nthreads != 1) cerr << "FINISHED FIRST ROUND: " << time(0) - start << endl;
-    start = time(0);
     //sort partitions
     if(nthreads == 1) {
         for(int bin = 0; bin < occupied; bin++)
@@ -277,7 +266,6 @@ void radix_sort_copy(T* begin, T* end, T* o, index_t (*hash)(T&), index_t maxv,
             while(params[i].num + st < occupied
                         && (index_t)(index[params[i].num + st] - index[st]) < remaining_elements / (nthreads - i))
                 params[i].num++;
-            cerr << params[i].num << " " << (index_t)(index[params[i].num + st] - index[st]) << endl;
             threads[i] = new tthread::thread(&_radix_sort_worker<T, CMP, index_t>, (void*)&params[i]);
             st += params[i].num;
         }
@@ -291,7 +279,67 @@ void radix_sort_copy(T* begin, T* end, T* o, index_t (*hash)(T&), index_t maxv,
             delete threads[i];
         }
     }
-    if(nthreads != 1) cerr << "FINISHED RECURSIVE SORTS: " << time(0) - start << endl;
+}
+
+template <typename T>
+struct SortParams {
+    T* begin;
+    T* mid;
+    T* end;
+};
+
+template <typename T>
+static void _sort_worker(void* vp) {
+    SortParams<T>* params = (SortParams<T>*)vp;
+    sort(params->begin, params->end);
+}
+
+template <typename T>
+static void _merge_worker(void* vp) {
+    SortParams<T>* params = (SortParams<T>*)vp;
+    inplace_merge(params->begin, params->mid, params->end);
+}
+
+// comparison sort using multiple threads; each thread sorts a contiguous range,
+// and adjacent ranges are then merged pairwise, also in parallel
+// the result is the same as std::sort's when no two elements compare equal
+template <typename T>
+void parallel_sort(T* begin, T* end, int nthreads = 1) {
+    size_t n = end - begin;
+    if(nthreads <= 1 || n < ((size_t)nthreads << 10)) {
+        sort(begin, end);
+        return;
+    }
+    EList<SortParams<T> > params; params.resizeExact(nthreads);
+    AutoArray<tthread::thread*> threads(nthreads);
+    EList<T*> bounds; bounds.resizeExact(nthreads + 1);
+    for(int i = 0; i <= nthreads; i++) {
+        bounds[i] = begin + n / nthreads * i;
+    }
+    bounds[nthreads] = end;
+    for(int i = 0; i < nthreads; i++) {
+        params[i].begin = bounds[i];
+        params[i].end = bounds[i + 1];
+        threads[i] = new tthread::thread(&_sort_worker<T>, (void*)&params[i]);
+    }
+    for(int i = 0; i < nthreads; i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+    for(int width = 1; width < nthreads; width <<= 1) {
+        int num_merges = 0;
+        for(int i = 0; i + width < nthreads; i += (width << 1)) {
+            params[num_merges].begin = bounds[i];
+            params[num_merges].mid = bounds[i + width];
+            params[num_merges].end = bounds[min(i + (width << 1), nthreads)];
+            threads[num_merges] = new tthread::thread(&_merge_worker<T>, (void*)&params[num_merges]);
+            num_merges++;
+        }
+        for(int i = 0; i < num_merges; i++) {
+            threads[i]->join();
+            delete threads[i];
+        }
+    }
 }
 
 #endif //RADIX_SORT_H_
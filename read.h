@@ -26,6 +26,7 @@
 #include "sstring.h"
 #include "filebuf.h"
 #include "util.h"
+#include "packed_dna.h"
 
 enum rna_strandness_format {
     RNA_STRANDNESS_UNKNOWN = 0,
@@ -58,10 +59,13 @@ struct Read {
 		readOrigBuf.clear();
 		patFw.clear();
 		patRc.clear();
+		patFwPacked.clear();
+		patRcPacked.clear();
 		qual.clear();
-		patFwRev.clear();
-		patRcRev.clear();
-		qualRev.clear();
+		patFwRev_.clear();
+		patRcRev_.clear();
+		qualRev_.clear();
+		revs_ = 0;
 		name.clear();
 		for(int j = 0; j < 3; j++) {
 			altPatFw[j].clear();
@@ -90,6 +94,7 @@ struct Read {
 		}
 		constructRevComps();
 		constructReverses();
+		constructPacked();
 	}
 
 	/**
@@ -110,6 +115,7 @@ struct Read {
 		}
 		constructRevComps();
 		constructReverses();
+		constructPacked();
 		if(nm != NULL) name.install(nm);
 	}
 
@@ -136,6 +142,7 @@ struct Read {
 	 * them.
 	 */
 	void constructRevComps() {
+		revs_ &= ~REV_PAT_RC;
 		if(color) {
 			patRc.installReverse(patFw);
 			for(int j = 0; j < alts; j++) {
@@ -150,13 +157,14 @@ struct Read {
 	}
 
 	/**
-	 * Given patFw, patRc, and qual, construct the *Rev versions in
-	 * place.  Assumes constructRevComps() was called previously.
+	 * Given altPatFw, altPatRc, and altQual, construct the *Rev versions in
+	 * place.  Assumes constructRevComps() was called previously.  The
+	 * reverses of patFw, patRc and qual are built on first use instead;
+	 * see patFwRev(), patRcRev() and qualRev().  Any reverses built
+	 * before are discarded, since patFw and qual may have changed.
 	 */
 	void constructReverses() {
-		patFwRev.installReverse(patFw);
-		patRcRev.installReverse(patRc);
-		qualRev.installReverse(qual);
+		revs_ = 0;
 		for(int j = 0; j < alts; j++) {
 			altPatFwRev[j].installReverse(altPatFw[j]);
 			altPatRcRev[j].installReverse(altPatRc[j]);
@@ -164,6 +172,48 @@ struct Read {
 		}
 	}
 
+	/**
+	 * Return patFw reversed, building it on first use.
+	 */
+	const BTDnaString& patFwRev() const {
+		if((revs_ & REV_PAT_FW) == 0) {
+			patFwRev_.installReverse(patFw);
+			revs_ |= REV_PAT_FW;
+		}
+		return patFwRev_;
+	}
+
+	/**
+	 * Return patRc reversed, building it on first use.
+	 */
+	const BTDnaString& patRcRev() const {
+		if((revs_ & REV_PAT_RC) == 0) {
+			patRcRev_.installReverse(patRc);
+			revs_ |= REV_PAT_RC;
+		}
+		return patRcRev_;
+	}
+
+	/**
+	 * Return qual reversed, building it on first use.
+	 */
+	const BTString& qualRev() const {
+		if((revs_ & REV_QUAL) == 0) {
+			qualRev_.installReverse(qual);
+			revs_ |= REV_QUAL;
+		}
+		return qualRev_;
+	}
+
+	/**
+	 * Construct the 2-bit packed forms of patFw and patRc, used to compare
+	 * the read against the reference a word at a time.
+	 */
+	void constructPacked() {
+		patFwPacked.install(patFw);
+		patRcPacked.install(patRc);
+	}
+
 	/**
 	 * Append a "/1" or "/2" string onto the end of the name buf if
 	 * it's not already there.
@@ -326,13 +376,20 @@ struct Read {
 	BTDnaString patRc;            // reverse-complement sequence
 	BTString    qual;             // quality values
 
+	PackedDnaString patFwPacked;  // patFw, 2 bits per base
+	PackedDnaString patRcPacked;  // patRc, 2 bits per base
+
 	BTDnaString altPatFw[3];
 	BTDnaString altPatRc[3];
 	BTString    altQual[3];
 
-	BTDnaString patFwRev;
-	BTDnaString patRcRev;
-	BTString    qualRev;
+	// Built on first use by patFwRev(), patRcRev() and qualRev(); 'revs_'
+	// says which of them are up to date
+	enum { REV_PAT_FW = 1, REV_PAT_RC = 2, REV_QUAL = 4 };
+	mutable BTDnaString patFwRev_;
+	mutable BTDnaString patRcRev_;
+	mutable BTString    qualRev_;
+	mutable int         revs_;
 
 	BTDnaString altPatFwRev[3];
 	BTDnaString altPatRcRev[3];
@@ -457,6 +514,7 @@ struct PerReadMetrics {
 		seedMedian = seedMean = 0;
 		bestLtMinscMate1 =
 		bestLtMinscMate2 = std::numeric_limits<TAlScore>::min();
+		overBudget = false;
 		fmString.reset();
 	}
 
@@ -525,6 +583,8 @@ struct PerReadMetrics {
 	TAlScore bestLtMinscMate1; // best invalid score observed for mate 1
 	TAlScore bestLtMinscMate2; // best invalid score observed for mate 2
 	
+	bool overBudget;        // search stopped at the per-read work budget
+	
 	// For collecting information to go into an FM string
 	bool doFmString;
 	FmString fmString;
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sys/stat.h>
+#include "read_dump.h"
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#endif
+
+using namespace std;
+
+/**
+ * Return the option name (without dashes) for the given category.
+ */
+const char *ReadDump::catName(int cat) {
+	static const char *names[READ_DUMP_NCAT] = {
+		"un", "al", "un-conc", "al-conc", "al-conc-disc"
+	};
+	assert_lt(cat, READ_DUMP_NCAT);
+	return names[cat];
+}
+
+/**
+ * Open a single dump file, either directly or through a compressor.
+ */
+FILE *ReadDump::openFile(const string& fn, int compress, bool& pipe) {
+	pipe = (compress != READ_DUMP_PLAIN);
+	if(!pipe) {
+		return fopen(fn.c_str(), "wb");
+	}
+	// Quote the filename for the shell
+	string cmd = (compress == READ_DUMP_GZIP ? "gzip -c > '" : "bzip2 -c > '");
+	for(size_t i = 0; i < fn.length(); i++) {
+		if(fn[i] == '\'') cmd += "'\\''";
+		else              cmd += fn[i];
+	}
+	cmd += "'";
+	return popen(cmd.c_str(), "w");
+}
+
+/**
+ * Open the file(s) for the given category.
+ */
+void ReadDump::open(int cat, const string& path, int compress) {
+	assert_lt(cat, READ_DUMP_NCAT);
+	assert(!isOpen(cat));
+	bool paired = (cat >= READ_DUMP_UN_CONC);
+	string dir, base = path;
+	struct stat st;
+	if(stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+		dir = path;
+		if(dir[dir.length() - 1] != '/') dir += '/';
+		base = string(catName(cat)) + (paired ? "-mate" : "-seqs");
+	} else {
+		size_t slash = path.find_last_of('/');
+		if(slash != string::npos) {
+			dir = path.substr(0, slash + 1);
+			base = path.substr(slash + 1);
+		}
+	}
+	string fns[2];
+	if(!paired) {
+		fns[0] = dir + base;
+	} else {
+		size_t pct = base.find('%');
+		size_t dot = base.find_last_of('.');
+		for(int mate = 0; mate < 2; mate++) {
+			const char *mt = (mate == 0 ? "1" : "2");
+			string fn = base;
+			if(pct != string::npos) {
+				for(size_t i = fn.find('%'); i != string::npos; i = fn.find('%', i)) {
+					fn.replace(i, 1, mt);
+				}
+			} else if(dot != string::npos) {
+				fn.insert(dot, string(".") + mt);
+			} else {
+				fn += string(".") + mt;
+			}
+			fns[mate] = dir + fn;
+		}
+	}
+	for(int mate = 0; mate < (paired ? 2 : 1); mate++) {
+		fhs_[cat][mate] = openFile(fns[mate], compress, pipes_[cat][mate]);
+		if(fhs_[cat][mate] == NULL) {
+			cerr << "Error: could not open --" << catName(cat) << " output file '"
+			     << fns[mate] << "' for writing" << endl;
+			throw 1;
+		}
+	}
+	nopen_++;
+}
+
+/**
+ * Append buffered mate 1 and mate 2 records to the files of the given
+ * category.  Both mates are written under the same lock so that pairs
+ * stay in step across the two files.
+ */
+void ReadDump::write(int cat, const BTString& mate1, const BTString& mate2) {
+	assert(isOpen(cat));
+	ThreadSafe t(&locks_[cat]);
+	const BTString *bufs[2] = { &mate1, &mate2 };
+	for(int mate = 0; mate < 2; mate++) {
+		if(bufs[mate]->empty()) continue;
+		assert(fhs_[cat][mate] != NULL);
+		if(fwrite(bufs[mate]->buf(), 1, bufs[mate]->length(), fhs_[cat][mate]) != bufs[mate]->length()) {
+			// Reported by close(); this may be running in a destructor
+			failed_ = true;
+		}
+	}
+}
+
+/**
+ * Append the records of the next read in input order.
+ */
+void ReadDump::writeOrdered(const ReadDumpRec& rec) {
+	assert(ordered_);
+	for(int cat = 0; cat < READ_DUMP_NCAT; cat++) {
+		if((rec.cats & (1 << cat)) == 0) continue;
+		obufs_[cat][0].append(rec.mate1.buf(), rec.mate1.length());
+		obufs_[cat][1].append(rec.mate2.buf(), rec.mate2.length());
+		if(obufs_[cat][0].length() + obufs_[cat][1].length() >= FLUSH_THRESH) {
+			write(cat, obufs_[cat][0], obufs_[cat][1]);
+			obufs_[cat][0].clear();
+			obufs_[cat][1].clear();
+		}
+	}
+}
+
+/**
+ * Write out whatever writeOrdered() has buffered.
+ */
+void ReadDump::flushOrdered() {
+	for(int cat = 0; cat < READ_DUMP_NCAT; cat++) {
+		if(obufs_[cat][0].empty() && obufs_[cat][1].empty()) continue;
+		write(cat, obufs_[cat][0], obufs_[cat][1]);
+		obufs_[cat][0].clear();
+		obufs_[cat][1].clear();
+	}
+}
+
+/**
+ * Close all files, waiting for any compressors to finish.  Returns false
+ * if anything could not be written.
+ */
+bool ReadDump::close() {
+	flushOrdered();
+	bool ok = !failed_;
+	for(int cat = 0; cat < READ_DUMP_NCAT; cat++) {
+		for(int mate = 0; mate < 2; mate++) {
+			if(fhs_[cat][mate] == NULL) continue;
+			int ret = pipes_[cat][mate] ? pclose(fhs_[cat][mate]) : fclose(fhs_[cat][mate]);
+			if(ret != 0 || failed_) {
+				cerr << "Error: could not write --" << catName(cat) << " output file" << endl;
+				ok = false;
+			}
+			fhs_[cat][mate] = NULL;
+		}
+	}
+	nopen_ = 0;
+	failed_ = false;
+	return ok;
+}
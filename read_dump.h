@@ -0,0 +1,290 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef READ_DUMP_H_
+#define READ_DUMP_H_
+
+#include <stdio.h>
+#include <string>
+#include "assert_helpers.h"
+#include "sstring.h"
+#include "read.h"
+#include "threading.h"
+
+/**
+ * Categories of reads that can be written to files with --un, --al,
+ * --un-conc, --al-conc and --al-conc-disc.
+ */
+enum {
+	READ_DUMP_UN = 0,       // unpaired reads that failed to align
+	READ_DUMP_AL,           // unpaired reads that aligned at least once
+	READ_DUMP_UN_CONC,      // pairs that failed to align concordantly
+	READ_DUMP_AL_CONC,      // pairs that aligned concordantly at least once
+	READ_DUMP_AL_CONC_DISC, // pairs where at least one mate aligned
+	READ_DUMP_NCAT
+};
+
+/**
+ * How a read dump file is compressed.  Compressed files are written
+ * through a gzip or bzip2 process of their own, so compression runs in
+ * parallel with alignment and with the other dump files.
+ */
+enum {
+	READ_DUMP_PLAIN = 0,
+	READ_DUMP_GZIP,
+	READ_DUMP_BZIP2
+};
+
+/**
+ * The records of one read (or pair) and the categories they go to.  With
+ * --reorder, these are passed through the OutputQueue along with the
+ * read's SAM records so that they are written in input order.
+ */
+struct ReadDumpRec {
+
+	ReadDumpRec() : cats(0) { }
+
+	void clear() {
+		cats = 0;
+		mate1.clear();
+		mate2.clear();
+	}
+
+	int      cats;  // bit i is set iff the read goes to category i
+	BTString mate1; // mate 1 (or unpaired read) record
+	BTString mate2; // mate 2 record, if paired
+};
+
+/**
+ * Global set of read dump files shared by all search threads.  Threads
+ * never write single reads here; they accumulate reads in a ReadDumpBuf
+ * and hand over whole buffers, which are written under a per-category
+ * lock so that the mate 1 and mate 2 files of a category stay in step.
+ *
+ * When the dump is ordered, reads instead arrive one by one, in input
+ * order, from the OutputQueue (see writeOrdered()).
+ */
+class ReadDump {
+
+	static const size_t FLUSH_THRESH = 64 * 1024;
+
+public:
+
+	ReadDump() : nopen_(0), ordered_(false), failed_(false) {
+		for(size_t i = 0; i < READ_DUMP_NCAT; i++) {
+			LOCK_SITE(locks_[i], "ReadDump");
+			for(size_t j = 0; j < 2; j++) {
+				fhs_[i][j] = NULL;
+				pipes_[i][j] = false;
+			}
+		}
+	}
+
+	~ReadDump() { close(); }
+
+	/**
+	 * Open the file(s) for the given category.  'path' follows the rules
+	 * of the hisat2 wrapper: for paired categories a '%' is replaced with
+	 * the mate number, or ".1"/".2" is inserted before the extension; if
+	 * 'path' is a directory, files named after the option are created in
+	 * it.
+	 */
+	void open(int cat, const std::string& path, int compress);
+
+	/**
+	 * Return true iff any category has files open.
+	 */
+	bool empty() const { return nopen_ == 0; }
+
+	/**
+	 * Return true iff the given category has files open.
+	 */
+	bool isOpen(int cat) const {
+		assert_lt(cat, READ_DUMP_NCAT);
+		return fhs_[cat][0] != NULL;
+	}
+
+	/**
+	 * Set whether reads are to be written in input order.
+	 */
+	void setOrdered(bool ordered) { ordered_ = ordered; }
+
+	/**
+	 * Return true iff reads are to be written in input order.
+	 */
+	bool ordered() const { return ordered_; }
+
+	/**
+	 * Append buffered mate 1 and mate 2 records to the files of the given
+	 * category.
+	 */
+	void write(int cat, const BTString& mate1, const BTString& mate2);
+
+	/**
+	 * Append the records of the next read in input order.  Only called by
+	 * the OutputQueue, under its lock.
+	 */
+	void writeOrdered(const ReadDumpRec& rec);
+
+	/**
+	 * Write out whatever writeOrdered() has buffered.
+	 */
+	void flushOrdered();
+
+	/**
+	 * Close all files, waiting for any compressors to finish.  Returns
+	 * false if anything could not be written.
+	 */
+	bool close();
+
+	/**
+	 * Return the option name (without dashes) for the given category.
+	 */
+	static const char *catName(int cat);
+
+protected:
+
+	FILE *openFile(const std::string& fn, int compress, bool& pipe);
+
+	FILE    *fhs_[READ_DUMP_NCAT][2];   // mate 1 (or unpaired) and mate 2
+	bool     pipes_[READ_DUMP_NCAT][2]; // opened with popen()?
+	MUTEX_T  locks_[READ_DUMP_NCAT];
+	BTString obufs_[READ_DUMP_NCAT][2]; // reads buffered by writeOrdered()
+	size_t   nopen_;
+	bool     ordered_; // reads come from the OutputQueue in input order
+	bool     failed_;  // a write failed
+};
+
+/**
+ * Per-thread buffer of reads waiting to be written to the read dump
+ * files.  Records are copied from the Read objects the aligner already
+ * holds, and are flushed to the shared ReadDump in large chunks.  If the
+ * dump is ordered, only the current read's records are kept, in rec(),
+ * for the caller to pass to the OutputQueue.
+ */
+class ReadDumpBuf {
+
+	static const size_t FLUSH_THRESH = 64 * 1024;
+
+public:
+
+	explicit ReadDumpBuf(ReadDump *dump = NULL) : dump_(dump) { }
+
+	~ReadDumpBuf() { flush(); }
+
+	/**
+	 * Return true iff there is somewhere to write reads to.
+	 */
+	bool active() const {
+		return dump_ != NULL && !dump_->empty();
+	}
+
+	/**
+	 * Dump an unpaired read to --un or --al.
+	 */
+	void dumpUnpaired(const Read& rd, bool aligned) {
+		add(aligned ? READ_DUMP_AL : READ_DUMP_UN, &rd, NULL);
+	}
+
+	/**
+	 * Dump a pair to --un-conc or --al-conc, and to --al-conc-disc if
+	 * either mate aligned.
+	 */
+	void dumpPair(const Read& rd1, const Read& rd2, bool concord, bool aligned) {
+		add(concord ? READ_DUMP_AL_CONC : READ_DUMP_UN_CONC, &rd1, &rd2);
+		if(aligned) {
+			add(READ_DUMP_AL_CONC_DISC, &rd1, &rd2);
+		}
+	}
+
+	/**
+	 * Records of the current read, when the dump is ordered.
+	 */
+	ReadDumpRec& rec() { return rec_; }
+
+	/**
+	 * Hand everything buffered so far over to the shared ReadDump.
+	 */
+	void flush() {
+		if(dump_ == NULL) return;
+		for(int i = 0; i < READ_DUMP_NCAT; i++) {
+			flush(i);
+		}
+	}
+
+protected:
+
+	void add(int cat, const Read *rd1, const Read *rd2) {
+		if(!dump_->isOpen(cat)) return;
+		if(dump_->ordered()) {
+			if(rec_.cats == 0) {
+				appendRecord(rec_.mate1, *rd1);
+				if(rd2 != NULL) {
+					appendRecord(rec_.mate2, *rd2);
+				}
+			}
+			rec_.cats |= (1 << cat);
+			return;
+		}
+		appendRecord(bufs_[cat][0], *rd1);
+		if(rd2 != NULL) {
+			appendRecord(bufs_[cat][1], *rd2);
+		}
+		if(bufs_[cat][0].length() + bufs_[cat][1].length() >= FLUSH_THRESH) {
+			flush(cat);
+		}
+	}
+
+	void flush(int cat) {
+		if(bufs_[cat][0].empty() && bufs_[cat][1].empty()) return;
+		dump_->write(cat, bufs_[cat][0], bufs_[cat][1]);
+		bufs_[cat][0].clear();
+		bufs_[cat][1].clear();
+	}
+
+	/**
+	 * Append the read exactly as it appeared in the input.  Inputs that
+	 * don't keep the original text (e.g. the second mate of a tab-delimited
+	 * pair) are written as FASTQ.
+	 */
+	static void appendRecord(BTString& o, const Read& rd) {
+		if(!rd.readOrigBuf.empty()) {
+			o.append(rd.readOrigBuf.buf(), rd.readOrigBuf.length());
+			if(rd.readOrigBuf[rd.readOrigBuf.length() - 1] != '\n') {
+				o.append('\n');
+			}
+			return;
+		}
+		o.append('@');
+		o.append(rd.name.buf(), rd.name.length());
+		o.append('\n');
+		for(size_t i = 0; i < rd.patFw.length(); i++) {
+			o.append("ACGTN"[(int)rd.patFw[i]]);
+		}
+		o.append("\n+\n");
+		o.append(rd.qual.buf(), rd.qual.length());
+		o.append('\n');
+	}
+
+	ReadDump   *dump_;
+	BTString    bufs_[READ_DUMP_NCAT][2];
+	ReadDumpRec rec_;
+};
+
+#endif /*READ_DUMP_H_*/
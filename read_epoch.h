@@ -0,0 +1,111 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef READ_EPOCH_H_
+#define READ_EPOCH_H_
+
+#include <stdint.h>
+#include <limits>
+#include "ds.h"
+#include "tinythread.h"
+#include "splice_site.h"
+
+/**
+ * Sequencing barrier for --deterministic.  Reads are grouped into epochs
+ * of a fixed number of reads by read id, and a read may only use the
+ * novel splice sites found by reads in the epochs before the previous one
+ * (see novelSpliceSiteBound).  Before aligning a read, a worker waits
+ * until every read below that bound has been aligned and its splice
+ * sites added, so the set of sites the read sees doesn't depend on how
+ * reads were spread over the threads.
+ *
+ * Reads are handed to the workers in read id order, so a worker that has
+ * begun read 'rdid' has finished all of its earlier reads, and all reads
+ * below 'rdid' have been handed out.  Workers wait on a condition
+ * variable instead of spinning, and only when one of them is still on a
+ * read more than an epoch behind.
+ */
+class ReadEpochBarrier {
+
+public:
+
+	ReadEpochBarrier() : epoch_(0), cur_(MISC_CAT), clear_(0), waiting_(0) { }
+
+	/**
+	 * Set up for 'nthreads' workers and epochs of 'epoch' reads.
+	 */
+	void init(size_t nthreads, uint64_t epoch) {
+		epoch_ = epoch;
+		cur_.resize(nthreads);
+		cur_.fill(0);
+		clear_ = 0;
+		waiting_ = 0;
+	}
+
+	/**
+	 * Worker 'tid' (0-based) is about to align read 'rdid'.  Block until
+	 * every read below the read's bound is done.  Return true iff the
+	 * worker had to wait.
+	 */
+	bool begin(size_t tid, uint64_t rdid) {
+		uint64_t bound = novelSpliceSiteBound(rdid, 0, epoch_);
+		tthread::lock_guard<tthread::mutex> guard(mutex_);
+		assert_lt(tid, cur_.size());
+		assert_leq(cur_[tid], rdid);
+		cur_[tid] = rdid;
+		if(waiting_ > 0) cond_.notify_all();
+		bool waited = false;
+		while(bound > clear_) {
+			uint64_t minrd = cur_[0];
+			for(size_t i = 1; i < cur_.size(); i++) {
+				if(cur_[i] < minrd) minrd = cur_[i];
+			}
+			if(minrd >= bound) {
+				clear_ = bound;
+				break;
+			}
+			waited = true;
+			waiting_++;
+			cond_.wait(mutex_);
+			waiting_--;
+		}
+		return waited;
+	}
+
+	/**
+	 * Worker 'tid' (0-based) has run out of reads.
+	 */
+	void finish(size_t tid) {
+		tthread::lock_guard<tthread::mutex> guard(mutex_);
+		assert_lt(tid, cur_.size());
+		cur_[tid] = std::numeric_limits<uint64_t>::max();
+		if(waiting_ > 0) cond_.notify_all();
+	}
+
+protected:
+
+	uint64_t                     epoch_;   // reads per epoch
+	EList<uint64_t>              cur_;     // per worker: read being aligned, or max if done
+	uint64_t                     clear_;   // all reads below this are done
+	size_t                       waiting_; // # workers waiting on cond_
+	tthread::mutex               mutex_;
+	tthread::condition_variable  cond_;
+};
+
+#endif /*ndef READ_EPOCH_H_*/
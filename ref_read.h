@@ -148,19 +148,21 @@ reverseRefRecords(
 
 /**
  * Reads the next sequence from the given FASTA file and appends it to
- * the end of dst, optionally reversing it.
+ * the end of dst, optionally reversing it.  'lastc' carries the parser
+ * state from one call to the next on the same input, so that several
+ * inputs can be parsed at once by different threads.
  */
 template <typename TStr>
 static RefRecord fastaRefReadAppend(
 	FileBuf& in,             // input file
 	bool first,              // true iff this is the first record in the file
+	int& lastc,              // last character seen by the previous call
 	TStr& dst,               // destination buf for parsed characters
 	TIndexOffU& dstoff,          // index of next character in dst to assign
 	RefReadInParams& rparms, // 
 	string* name = NULL)     // put parsed FASTA name here
 {
 	int c;
-	static int lastc = '>';
 	if(first) {
 		c = in.getPastWhitespace();
 		if(c != '>') {
@@ -579,6 +579,86 @@ int BitPairReference::getStretch(
 }
 
 
+/**
+ * Load a stretch of the reference string into 'dest', 2 bits per base.
+ */
+void BitPairReference::getPackedStretch(
+	PackedDnaString& dest,
+	size_t tidx,
+	int64_t toff,
+	size_t count) const
+{
+	dest.resize(count, true /* all Ns */);
+	if(count == 0) return;
+	size_t cur = 0;
+	if(toff < 0) {
+		// Positions before the start of the reference sequence are Ns
+		cur = min<size_t>((size_t)(-toff), count);
+		toff = 0;
+	}
+	uint64_t reci = refRecOffs_[tidx];   // first record for target reference sequence
+	uint64_t recf = refRecOffs_[tidx+1]; // last record (exclusive) for target seq
+	assert_gt(recf, reci);
+	uint64_t i = reci;
+	if(recf > reci + 16) {
+		// binary search finds the last record i s.t. toff >= cumRefOff_[i]
+		uint64_t left = reci, right = recf;
+		while(left < right-1) {
+			uint64_t mid = left + ((right - left) >> 1);
+			if(cumRefOff_[mid] <= (uint64_t)toff) left = mid;
+			else                                 right = mid;
+		}
+		i = left;
+	}
+	uint64_t off = cumRefOff_[i];
+	uint64_t bufOff = cumUnambig_[i];
+	uint64_t tend = (uint64_t)toff + (count - cur);
+	// For the records overlapping [toff, tend)...
+	for(; i < recf && off < tend; i++) {
+		off += recs_[i].off; // skip Ns at beginning of stretch
+		uint64_t beg = max<uint64_t>(off, (uint64_t)toff);
+		uint64_t end = min<uint64_t>(off + recs_[i].len, tend);
+		if(beg < end) {
+			uint64_t src = bufOff + (beg - off);
+			size_t d = cur + (size_t)(beg - (uint64_t)toff);
+			for(uint64_t left = end - beg; left > 0;) {
+				// 8 bytes hold at least 28 bases past any 2-bit boundary
+				size_t n = (size_t)min<uint64_t>(left, 28);
+				uint64_t byte = src >> 2;
+				uint64_t word = 0;
+				size_t nbytes = (size_t)min<uint64_t>(bufAllocSz_ - byte, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+				// buf_ packs the first base in the low bits of each byte,
+				// so on a little-endian machine the bytes load in order
+				memcpy(&word, buf_ + byte, nbytes);
+#else
+				for(size_t b = 0; b < nbytes; b++) {
+					word |= (uint64_t)buf_[byte + b] << (b << 3);
+				}
+#endif
+				dest.setBases(d, word >> ((src & 3) << 1), n);
+				src += n;
+				d += n;
+				left -= n;
+			}
+		}
+		off += recs_[i].len;
+		bufOff += recs_[i].len;
+	}
+	// Positions not covered by a record stay Ns
+#ifndef NDEBUG
+	if((rand() % 10) == 0) {
+		// Compare with the unpacked stretch
+		EList<uint32_t> naive;
+		naive.resize((count >> 2) + 2);
+		getStretchNaive(naive.ptr(), tidx, (size_t)toff, count - cur);
+		for(size_t j = cur; j < count; j++) {
+			assert_eq((int)((uint8_t*)naive.ptr())[j - cur], dest.get(j));
+		}
+	}
+#endif
+}
+
 /**
  * Parse the input fasta files, populating the szs list and writing the
  * .3.gfm_ext and .4.gfm_ext portions of the index as we go.
@@ -36,6 +36,7 @@
 #include "timer.h"
 #include "sstring.h"
 #include "btypes.h"
+#include "packed_dna.h"
 
 
 /**
@@ -115,6 +116,18 @@ public:
 		size_t count
 		ASSERT_ONLY(, SStringExpandable<uint32_t>& destU32_2)) const;
 
+	/**
+	 * Load a stretch of the reference string into 'dest' without
+	 * unpacking it: bases are copied from the bitpacked buffer a word at
+	 * a time.  'toff' may be negative; positions before the start of the
+	 * reference sequence, and all ambiguous positions, are Ns.
+	 */
+	void getPackedStretch(
+		PackedDnaString& dest,
+		size_t tidx,
+		int64_t toff,
+		size_t count) const;
+
 	/**
 	 * Return the number of reference sequences.
 	 */
@@ -149,6 +162,21 @@ public:
 		return refOffs_[idx];
 	}
 
+	/**
+	 * Return the number of unambiguous bases in the bitpacked reference
+	 * buffer.
+	 */
+	TIndexOffU bufSz() const {
+		return bufSz_;
+	}
+
+	/**
+	 * Return the size in bytes of the bitpacked reference buffer.
+	 */
+	TIndexOffU bufAllocSz() const {
+		return bufAllocSz_;
+	}
+
 	/**
 	 * Parse the input fasta files, populating the szs list and writing the
 	 * .3.ebwt and .4.ebwt portions of the index as we go.
@@ -175,8 +203,8 @@ protected:
 	EList<TIndexOffU> refRecOffs_; /// record begin/end offsets per ref seq
 	uint8_t *buf_;      /// the whole reference as a big bitpacked byte array
 	uint8_t *sanityBuf_;/// for sanity-checking buf_
-	TIndexOffU bufSz_;    /// size of buf_
-	TIndexOffU bufAllocSz_;
+	TIndexOffU bufSz_;    /// # bases in buf_
+	TIndexOffU bufAllocSz_; /// size of buf_ in bytes
 	TIndexOffU nrefs_;    /// the number of reference sequences
 	bool     loaded_;   /// whether it's loaded
 	bool     sanity_;   /// do sanity checking
@@ -470,8 +470,7 @@ void SamConfig<index_t>::printSqLines(BTString& o) const {
         o.append("@SQ\tSN:");
         printRefName(o, refnames_[i]);
         o.append("\tLN:");
-        itoa10<size_t>(reflens_[i], buf);
-        o.append(buf);
+        o.append(buf, itoa10<size_t>(reflens_[i], buf) - buf);
         o.append('\n');
     }
 }
@@ -706,6 +705,11 @@ const
         // YF:i: Read was filtered?
         first = flags.printYF(o, first) && first;
     }
+    if(prm.overBudget) {
+        // ZW:i: Search was stopped at the per-read work budget
+        WRITE_SEP();
+        o.append("ZW:i:1");
+    }
     if(print_yi_) {
         // Print MAPQ calibration info
         if(mapqInp[0] != '\0') {
@@ -720,8 +724,7 @@ const
         WRITE_SEP();
         o.append("ZP:Z:");
         if(summ.bestPaired().valid()) {
-            itoa10<TAlScore>(summ.bestPaired().score(), buf);
-            o.append(buf);
+            o.append(buf, itoa10<TAlScore>(summ.bestPaired().score(), buf) - buf);
         } else {
             o.append("NA");
         }
@@ -729,8 +732,7 @@ const
         WRITE_SEP();
         o.append("Zp:Z:");
         if(summ.secbestPaired().valid()) {
-            itoa10<TAlScore>(summ.secbestPaired().score(), buf);
-            o.append(buf);
+            o.append(buf, itoa10<TAlScore>(summ.secbestPaired().score(), buf) - buf);
         } else {
             o.append("NA");
         }
@@ -742,8 +744,7 @@ const
         WRITE_SEP();
         o.append("ZU:i:");
         if(best.valid()) {
-            itoa10<TAlScore>(best.score(), buf);
-            o.append(buf);
+            o.append(buf, itoa10<TAlScore>(best.score(), buf) - buf);
         } else {
             o.append("NA");
         }
@@ -751,8 +752,7 @@ const
         WRITE_SEP();
         o.append("Zu:i:");
         if(secbest.valid()) {
-            itoa10<TAlScore>(secbest.score(), buf);
-            o.append(buf);
+            o.append(buf, itoa10<TAlScore>(secbest.score(), buf) - buf);
         } else {
             o.append("NA");
         }
@@ -838,20 +838,15 @@ const
         // XP:Z: String describing seed hits
         WRITE_SEP();
         o.append("XP:B:I,");
-        itoa10<uint64_t>(prm.nSeedElts, buf);
-        o.append(buf);
+        o.append(buf, itoa10<uint64_t>(prm.nSeedElts, buf) - buf);
         o.append(',');
-        itoa10<uint64_t>(prm.nSeedEltsFw, buf);
-        o.append(buf);
+        o.append(buf, itoa10<uint64_t>(prm.nSeedEltsFw, buf) - buf);
         o.append(',');
-        itoa10<uint64_t>(prm.nSeedEltsRc, buf);
-        o.append(buf);
+        o.append(buf, itoa10<uint64_t>(prm.nSeedEltsRc, buf) - buf);
         o.append(',');
-        itoa10<uint64_t>(prm.seedMean, buf);
-        o.append(buf);
+        o.append(buf, itoa10<uint64_t>(prm.seedMean, buf) - buf);
         o.append(',');
-        itoa10<uint64_t>(prm.seedMedian, buf);
-        o.append(buf);
+        o.append(buf, itoa10<uint64_t>(prm.seedMedian, buf) - buf);
     }
     if(print_yr_) {
         // YR:i: Redundant seed hits
@@ -994,8 +989,7 @@ const
                 }
                 j--;
             }
-            itoa10<uint64_t>(pos, buf);
-            o.append(buf);
+            o.append(buf, itoa10<uint64_t>(pos, buf) - buf);
             o.append("|");
             if(snp.type == ALT_SNP_SGL) {
                 o.append("S");
@@ -1079,6 +1073,11 @@ const
         // YM:i: Read was repetitive when aligned unpaired?
         first = flags.printYF(o, first) && first;
     }
+    if(prm.overBudget) {
+        // ZW:i: Search was stopped at the per-read work budget
+        WRITE_SEP();
+        o.append("ZW:i:1");
+    }
     if(!rgs_.empty()) {
         WRITE_SEP();
         o.append(rgs_.c_str());
@@ -1160,20 +1159,15 @@ const
         // XP:Z: String describing seed hits
         WRITE_SEP();
         o.append("XP:B:I,");
-        itoa10<uint64_t>(prm.nSeedElts, buf);
-        o.append(buf);
+        o.append(buf, itoa10<uint64_t>(prm.nSeedElts, buf) - buf);
         o.append(',');
-        itoa10<uint64_t>(prm.nSeedEltsFw, buf);
-        o.append(buf);
+        o.append(buf, itoa10<uint64_t>(prm.nSeedEltsFw, buf) - buf);
         o.append(',');
-        itoa10<uint64_t>(prm.nSeedEltsRc, buf);
-        o.append(buf);
+        o.append(buf, itoa10<uint64_t>(prm.nSeedEltsRc, buf) - buf);
         o.append(',');
-        itoa10<uint64_t>(prm.seedMean, buf);
-        o.append(buf);
+        o.append(buf, itoa10<uint64_t>(prm.seedMean, buf) - buf);
         o.append(',');
-        itoa10<uint64_t>(prm.seedMedian, buf);
-        o.append(buf);
+        o.append(buf, itoa10<uint64_t>(prm.seedMedian, buf) - buf);
     }
     if(print_yr_) {
         // YR:i: Redundant seed hits
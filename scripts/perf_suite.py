@@ -0,0 +1,313 @@
+#!/usr/bin/env python
+
+#
+# Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+#
+# This file is part of HISAT 2.
+#
+# HISAT 2 is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# HISAT 2 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+"""
+perf_suite.py
+
+End-to-end performance suite for hisat2-build and hisat2-align-s.
+
+Builds the reference index with and without --snp (and --ss/--exon when a
+GTF file is given), simulates reads from the reference with
+hisat2_simulate_reads.py using a fixed seed, and aligns them with 1, 2,
+4, ... up to --max-threads threads.  One line per run is appended to a
+tab-separated results file, so results from different commits can be
+compared by concatenating or joining the files on the Case and Threads
+columns.
+
+Recorded for index builds: wall time, peak RSS and total index size.
+Recorded for alignment runs: wall time, index load time (the wall time of
+aligning an empty input), reads/sec excluding load time, parallel
+efficiency relative to the 1-thread run, peak RSS, and SAM output
+bytes/sec.
+
+Example, from the top of the source tree after 'make':
+    python scripts/perf_suite.py --max-threads 8 --results perf.tsv
+"""
+
+from __future__ import print_function
+
+import sys, os, time, socket, subprocess
+from argparse import ArgumentParser
+
+
+RESULT_COLUMNS = ["Label", "Date", "Host", "Kind", "Case", "Threads",
+                  "WallSecs", "LoadSecs", "Reads", "ReadsPerSec", "Efficiency",
+                  "PeakRssKB", "OutBytes", "OutBytesPerSec", "IndexBytes"]
+
+
+"""
+Run 'cmd' and return (wall seconds, peak RSS of the process in KB).
+stdout goes to 'out_fname' if given; stderr goes to 'log'.
+"""
+def run_timed(cmd, log, out_fname = None, verbose = False):
+    if verbose:
+        print(" ".join(cmd), file=sys.stderr)
+    print(" ".join(cmd), file=log)
+    log.flush()
+    out = open(out_fname, "w") if out_fname else log
+    start = time.time()
+    proc = subprocess.Popen(cmd, stdout = out, stderr = log)
+    _, status, rusage = os.wait4(proc.pid, 0)
+    wall = time.time() - start
+    proc.returncode = status
+    if out_fname:
+        out.close()
+    if status != 0:
+        print("Error: command failed (status %d): %s" % (status, " ".join(cmd)), file=sys.stderr)
+        sys.exit(1)
+    # ru_maxrss is in KB on Linux and in bytes on Mac OS
+    rss = rusage.ru_maxrss
+    if sys.platform == "darwin":
+        rss //= 1024
+    return wall, rss
+
+
+"""
+Return the label identifying the tree being measured: the git commit if
+the tree is a git checkout, "unknown" otherwise.
+"""
+def default_label(src_dir):
+    try:
+        label = subprocess.check_output(["git", "-C", src_dir, "describe", "--always", "--dirty"],
+                                        stderr = open(os.devnull, "w"))
+        return label.decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+"""
+Thread counts 1, 2, 4, ... up to and including max_threads.
+"""
+def thread_counts(max_threads):
+    counts = []
+    t = 1
+    while t < max_threads:
+        counts.append(t)
+        t *= 2
+    counts.append(max_threads)
+    return counts
+
+
+def index_bytes(base):
+    total = 0
+    i = 1
+    while os.path.exists("%s.%d.ht2" % (base, i)):
+        total += os.path.getsize("%s.%d.ht2" % (base, i))
+        i += 1
+    return total
+
+
+class Results:
+    def __init__(self, fname, label):
+        new_file = not os.path.exists(fname) or os.path.getsize(fname) == 0
+        self.f = open(fname, "a")
+        if new_file:
+            print("\t".join(RESULT_COLUMNS), file=self.f)
+        self.label = label
+        self.date = time.strftime("%Y-%m-%dT%H:%M:%S")
+        self.host = socket.gethostname()
+
+    def add(self, **fields):
+        fields["Label"] = self.label
+        fields["Date"] = self.date
+        fields["Host"] = self.host
+        row = []
+        for col in RESULT_COLUMNS:
+            val = fields.get(col, "NA")
+            if isinstance(val, float):
+                val = "%.3f" % val
+            row.append(str(val))
+        print("\t".join(row), file=self.f)
+        self.f.flush()
+        print("\t".join(row))
+
+
+def perf_suite(args):
+    src_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    bin_dir = args.bin_dir or src_dir
+    build_bin = os.path.join(bin_dir, "hisat2-build-s")
+    align_bin = os.path.join(bin_dir, "hisat2-align-s")
+    for binary in [build_bin, align_bin]:
+        if not os.path.exists(binary):
+            print("Error: %s does not exist; run make first" % binary, file=sys.stderr)
+            sys.exit(1)
+
+    if not os.path.exists(args.work_dir):
+        os.makedirs(args.work_dir)
+    log = open(os.path.join(args.work_dir, "perf_suite.log"), "a")
+    results = Results(args.results, args.label or default_label(src_dir))
+    print("\t".join(RESULT_COLUMNS))
+
+    # Splice sites and exons for the --ss/--exon builds and RNA-seq reads
+    ss_fname = exon_fname = None
+    if args.gtf:
+        ss_fname = os.path.join(args.work_dir, "ref.ss")
+        exon_fname = os.path.join(args.work_dir, "ref.exon")
+        run_timed([args.sim_python, os.path.join(src_dir, "hisat2_extract_splice_sites.py"), args.gtf],
+                  log, ss_fname, args.verbose)
+        run_timed([args.sim_python, os.path.join(src_dir, "hisat2_extract_exons.py"), args.gtf],
+                  log, exon_fname, args.verbose)
+
+    # Index builds
+    variants = [("plain", [])]
+    if args.snp:
+        variants.append(("snp", ["--snp", args.snp]))
+    if ss_fname:
+        variants.append(("ss", ["--ss", ss_fname, "--exon", exon_fname]))
+        if args.snp:
+            variants.append(("snp_ss", ["--snp", args.snp, "--ss", ss_fname, "--exon", exon_fname]))
+    for name, opts in variants:
+        base = os.path.join(args.work_dir, "index_" + name)
+        cmd = [build_bin, "-p", str(args.build_threads)] + opts + [args.reference, base]
+        wall, rss = run_timed(cmd, log, None, args.verbose)
+        results.add(Kind = "build", Case = name, Threads = args.build_threads,
+                    WallSecs = wall, PeakRssKB = rss, IndexBytes = index_bytes(base))
+    align_index = os.path.join(args.work_dir, "index_" + variants[-1][0])
+
+    # Simulated reads; kept across runs with the same parameters
+    sim_base = os.path.join(args.work_dir, "reads_%d_%d%s" % (args.num_frag, args.random_seed, "_rna" if args.gtf else ""))
+    read1_fname, read2_fname = sim_base + "_1.fa", sim_base + "_2.fa"
+    if not os.path.exists(read2_fname):
+        gtf = args.gtf
+        if not gtf:
+            gtf = os.path.join(args.work_dir, "empty.gtf")
+            open(gtf, "w").close()
+        cmd = [args.sim_python, os.path.join(src_dir, "hisat2_simulate_reads.py"),
+               "-n", str(args.num_frag), "--random-seed", str(args.random_seed)]
+        if not args.gtf:
+            cmd.append("--dna")
+        cmd += [args.reference, gtf, args.snp or os.devnull, sim_base]
+        run_timed(cmd, log, None, args.verbose)
+    reads = args.num_frag * 2
+
+    # Index load time: aligning an empty input
+    empty_fname = os.path.join(args.work_dir, "empty.fa")
+    open(empty_fname, "w").close()
+    load = None
+    for rep in range(args.repeats):
+        wall, _ = run_timed([align_bin, "-x", align_index, "-f", "-U", empty_fname, "-S", os.devnull],
+                            log, None, args.verbose)
+        if load is None or wall < load:
+            load = wall
+    results.add(Kind = "load", Case = variants[-1][0], Threads = 1, WallSecs = load, LoadSecs = load)
+
+    # Alignment at 1, 2, 4, ... threads
+    sam_fname = os.path.join(args.work_dir, "out.sam")
+    base_rate = None
+    for threads in thread_counts(args.max_threads):
+        best_wall, best_rss = None, None
+        for rep in range(args.repeats):
+            cmd = [align_bin, "-p", str(threads), "-x", align_index, "-f",
+                   "-1", read1_fname, "-2", read2_fname, "-S", sam_fname]
+            wall, rss = run_timed(cmd, log, None, args.verbose)
+            if best_wall is None or wall < best_wall:
+                best_wall, best_rss = wall, rss
+        out_bytes = os.path.getsize(sam_fname)
+        search = max(best_wall - load, 1e-6)
+        rate = reads / search
+        if threads == 1:
+            base_rate = rate
+        efficiency = rate / (threads * base_rate) if base_rate else "NA"
+        results.add(Kind = "align", Case = variants[-1][0], Threads = threads,
+                    WallSecs = best_wall, LoadSecs = load, Reads = reads,
+                    ReadsPerSec = rate, Efficiency = efficiency, PeakRssKB = best_rss,
+                    OutBytes = out_bytes, OutBytesPerSec = out_bytes / search)
+    os.remove(sam_fname)
+
+
+if __name__ == '__main__':
+    parser = ArgumentParser(
+        description='Measure index build and alignment performance and append the results to a table')
+    src_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser.add_argument('--reference',
+                        dest='reference',
+                        type=str,
+                        default=os.path.join(src_dir, "example", "reference", "22_20-21M.fa"),
+                        help='reference FASTA file (default: example/reference/22_20-21M.fa)')
+    parser.add_argument('--snp',
+                        dest='snp',
+                        type=str,
+                        default=os.path.join(src_dir, "example", "reference", "22_20-21M.snp"),
+                        help='SNP file for the --snp builds; "" to skip them (default: example/reference/22_20-21M.snp)')
+    parser.add_argument('--gtf',
+                        dest='gtf',
+                        type=str,
+                        default="",
+                        help='GTF file; adds --ss/--exon builds and simulates RNA-seq reads instead of DNA-seq reads')
+    parser.add_argument('--bin-dir',
+                        dest='bin_dir',
+                        type=str,
+                        default="",
+                        help='directory containing hisat2-build-s and hisat2-align-s (default: top of the source tree)')
+    parser.add_argument('--work-dir',
+                        dest='work_dir',
+                        type=str,
+                        default="perf_suite_work",
+                        help='directory for indexes, reads and logs (default: perf_suite_work)')
+    parser.add_argument('--results',
+                        dest='results',
+                        type=str,
+                        default="perf_results.tsv",
+                        help='results file, appended to (default: perf_results.tsv)')
+    parser.add_argument('--label',
+                        dest='label',
+                        type=str,
+                        default="",
+                        help='label for this set of runs (default: git describe of the source tree)')
+    parser.add_argument('-n', '--num-fragment',
+                        dest='num_frag',
+                        type=int,
+                        default=200000,
+                        help='number of read pairs to simulate (default: 200000)')
+    parser.add_argument('--random-seed',
+                        dest='random_seed',
+                        type=int,
+                        default=0,
+                        help='seed for simulating reads (default: 0)')
+    parser.add_argument('--max-threads',
+                        dest='max_threads',
+                        type=int,
+                        default=4,
+                        help='align with 1, 2, 4, ... up to this many threads (default: 4)')
+    parser.add_argument('--build-threads',
+                        dest='build_threads',
+                        type=int,
+                        default=1,
+                        help='threads for hisat2-build (default: 1)')
+    parser.add_argument('--repeats',
+                        dest='repeats',
+                        type=int,
+                        default=1,
+                        help='run each alignment this many times and keep the fastest (default: 1)')
+    parser.add_argument('--sim-python',
+                        dest='sim_python',
+                        type=str,
+                        default="python",
+                        help='Python 2 interpreter for hisat2_simulate_reads.py and the extraction scripts (default: python)')
+    parser.add_argument('-v', '--verbose',
+                        dest='verbose',
+                        action='store_true',
+                        help='print commands as they are run')
+    args = parser.parse_args()
+    if args.max_threads < 1 or args.repeats < 1 or args.num_frag < 1:
+        parser.print_help()
+        exit(1)
+    perf_suite(args)
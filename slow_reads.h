@@ -0,0 +1,234 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SLOW_READS_H_
+#define SLOW_READS_H_
+
+#include <stdint.h>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include "assert_helpers.h"
+#include "ds.h"
+#include "sstring.h"
+#include "read.h"
+#include "threading.h"
+#include "stage_timer.h"
+
+/**
+ * One read or pair that took long to align, with the work it took.
+ */
+struct SlowRead {
+
+	SlowRead() { reset(); }
+
+	void reset() {
+		usecs = 0;
+		rdid = 0;
+		paired = false;
+		name.clear();
+		seq[0].clear(); seq[1].clear();
+		qual[0].clear(); qual[1].clear();
+		fmops = coords = localSearches = exts = mateAtts = 0;
+		for(int i = 0; i < STAGE_NUM; i++) ticks[i] = 0;
+	}
+
+	/**
+	 * Copy the name, sequence and qualities of the read or pair as they
+	 * are aligned, i.e. after trimming and with Phred+33 qualities.
+	 */
+	void setRead(const Read& rd1, const Read* rd2, TReadId rdid_) {
+		rdid = rdid_;
+		paired = (rd2 != NULL);
+		name = rd1.name;
+		seq[0].install(rd1.patFw.toZBuf());
+		qual[0] = rd1.qual;
+		if(rd2 != NULL) {
+			seq[1].install(rd2->patFw.toZBuf());
+			qual[1] = rd2->qual;
+		} else {
+			seq[1].clear();
+			qual[1].clear();
+		}
+	}
+
+	/**
+	 * Set the work counters.  The worker sets them from its running
+	 * totals before and after a read and then takes the difference.
+	 */
+	void setCounters(
+		uint64_t fmops_,
+		uint64_t coords_,
+		uint64_t localSearches_,
+		uint64_t exts_,
+		uint64_t mateAtts_,
+		const StageMetrics& stages)
+	{
+		fmops = fmops_;
+		coords = coords_;
+		localSearches = localSearches_;
+		exts = exts_;
+		mateAtts = mateAtts_;
+		for(int i = 0; i < STAGE_NUM; i++) ticks[i] = stages.ticks[i];
+	}
+
+	/**
+	 * Turn running totals into the work done since 'beg'.
+	 */
+	void subtract(const SlowRead& beg) {
+		fmops -= beg.fmops;
+		coords -= beg.coords;
+		localSearches -= beg.localSearches;
+		exts -= beg.exts;
+		mateAtts -= beg.mateAtts;
+		for(int i = 0; i < STAGE_NUM; i++) ticks[i] -= beg.ticks[i];
+	}
+
+	bool operator<(const SlowRead& o) const {
+		// Slowest first
+		if(usecs != o.usecs) return usecs > o.usecs;
+		return rdid < o.rdid;
+	}
+
+	uint64_t usecs;         // wall time spent aligning the read or pair
+	TReadId  rdid;          // read id
+	bool     paired;
+	BTString name;          // name of mate 1
+	BTString seq[2];        // sequences after trimming
+	BTString qual[2];       // Phred+33 qualities after trimming
+	uint64_t fmops;         // FM index ops
+	uint64_t coords;        // genome coordinates resolved (global + local)
+	uint64_t localSearches; // local index searches
+	uint64_t exts;          // extension attempts
+	uint64_t mateAtts;      // alignMate attempts
+	uint64_t ticks[STAGE_NUM]; // ticks charged to each stage
+};
+
+/**
+ * Keeps the N slowest reads/pairs (that took at least a minimum time) seen
+ * by a thread.  Each worker fills its own log and merges it into a shared
+ * one at the end; the shared one is written out as a table so that the
+ * reads can be turned back into input for reproducing slow cases.
+ */
+class SlowReadLog {
+
+public:
+
+	SlowReadLog(size_t n, uint64_t minUsecs) :
+		n_(n),
+		minUsecs_(minUsecs),
+		reads_(n < 64 ? n : 64, MISC_CAT),
+		fastest_(0),
+		mutex_m()
+	{
+		LOCK_SITE(mutex_m, "SlowReadLog");
+	}
+
+	/**
+	 * Return true iff a read that took 'usecs' would be kept.
+	 */
+	bool wants(uint64_t usecs) const {
+		if(n_ == 0 || usecs < minUsecs_) return false;
+		return reads_.size() < n_ || usecs > reads_[fastest_].usecs;
+	}
+
+	/**
+	 * Return a slot for a read that took 'usecs', evicting the fastest
+	 * read if the log is full.  Only call if wants(usecs).
+	 */
+	SlowRead& add(uint64_t usecs) {
+		assert(wants(usecs));
+		size_t i;
+		if(reads_.size() < n_) {
+			reads_.expand();
+			i = reads_.size() - 1;
+		} else {
+			i = fastest_;
+		}
+		reads_[i].reset();
+		reads_[i].usecs = usecs;
+		if(reads_.size() == n_) {
+			fastest_ = 0;
+			for(size_t j = 1; j < reads_.size(); j++) {
+				if(reads_[j].usecs < reads_[fastest_].usecs) fastest_ = j;
+			}
+		}
+		return reads_[i];
+	}
+
+	/**
+	 * Add the reads in 'o' to this log.  Synchronized.
+	 */
+	void merge(const SlowReadLog& o) {
+		ThreadSafe ts(&mutex_m);
+		for(size_t i = 0; i < o.reads_.size(); i++) {
+			if(wants(o.reads_[i].usecs)) {
+				add(o.reads_[i].usecs) = o.reads_[i];
+			}
+		}
+	}
+
+	/**
+	 * Write the reads, slowest first, as a tab-separated table with a
+	 * header line.  Unpaired reads have '*' for the mate 2 columns.
+	 */
+	void write(const std::string& fname) {
+		std::ofstream out(fname.c_str());
+		if(!out.good()) {
+			cerr << "Error: could not open " << fname.c_str() << " for writing" << endl;
+			throw 1;
+		}
+		reads_.sort();
+		out << "Name\tReadId\tUsecs\tFmops\tGenomeCoords\tLocalSearches\tExts\tMateSearches";
+		for(int i = 0; i < STAGE_NUM; i++) {
+			out << '\t' << stageNames[i] << "Usecs";
+		}
+		out << "\tSeq1\tQual1\tSeq2\tQual2" << endl;
+		for(size_t i = 0; i < reads_.size(); i++) {
+			const SlowRead& r = reads_[i];
+			out << r.name << '\t' << r.rdid << '\t' << r.usecs
+			    << '\t' << r.fmops << '\t' << r.coords
+			    << '\t' << r.localSearches << '\t' << r.exts
+			    << '\t' << r.mateAtts;
+			for(int j = 0; j < STAGE_NUM; j++) {
+				out << '\t' << ticksToUsecs(r.ticks[j]);
+			}
+			out << '\t' << r.seq[0] << '\t' << r.qual[0];
+			if(r.paired) {
+				out << '\t' << r.seq[1] << '\t' << r.qual[1];
+			} else {
+				out << "\t*\t*";
+			}
+			out << endl;
+		}
+		out.close();
+	}
+
+	size_t size() const { return reads_.size(); }
+
+protected:
+
+	size_t           n_;        // max # reads to keep
+	uint64_t         minUsecs_; // only keep reads that took at least this long
+	EList<SlowRead>  reads_;
+	size_t           fastest_;  // index of fastest read, valid when full
+	MUTEX_T          mutex_m;
+};
+
+#endif /*ndef SLOW_READS_H_*/
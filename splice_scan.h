@@ -0,0 +1,189 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPLICE_SCAN_H_
+#define SPLICE_SCAN_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <emmintrin.h>
+#include "assert_helpers.h"
+#include "scoring.h"
+#include "splice_site.h"
+
+/**
+ * Kernels used by GenomeHit::combineWith to scan the candidate breakpoints
+ * between two partial hits 16 positions at a time with SSE2.  Sequences
+ * are one base per byte (0-3, 4 for N), as returned by
+ * BitPairReference::getStretch.  Each kernel gives exactly the results of
+ * the position-by-position loops it replaces.
+ */
+
+/**
+ * Return a mask with bit j set iff a[j] != b[j], for j < 16.
+ */
+static inline uint32_t spliceScanMismatches16(const char* a, const char* b) {
+	__m128i x = _mm_cmpeq_epi8(
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)),
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(b)));
+	return (uint32_t)_mm_movemask_epi8(x) ^ 0xffff;
+}
+
+/**
+ * Set scores[i], for i = 0, 1, ..., to the sum of the mismatch penalties
+ * of rd[0..i] against rf[0..i], stopping at the first i where scores[i] is
+ * less than 'floor'.  Return that i, or n if there is none.
+ */
+static inline int spliceScanPrefix(
+	const char*    rd,
+	const char*    qual,
+	const char*    rf,
+	int            n,
+	const Scoring& sc,
+	int64_t        floor,
+	int64_t*       scores)
+{
+	int64_t sum = 0;
+	for(int i = 0; i < n; i += 16) {
+		int w = min<int>(16, n - i);
+		uint32_t mm = 0;
+		if(w == 16) {
+			mm = spliceScanMismatches16(rd + i, rf + i);
+		} else {
+			for(int j = 0; j < w; j++) {
+				if(rd[i + j] != rf[i + j]) mm |= (1 << j);
+			}
+		}
+		for(int j = 0; j < w; j++) {
+			if((mm >> j) & 1) {
+				sum += sc.score(rd[i + j], 1 << rf[i + j], qual[i + j] - 33);
+			}
+			scores[i + j] = sum;
+			if(sum < floor) return i + j;
+		}
+	}
+	return n;
+}
+
+/**
+ * Set scores[i], for i = n-1, n-2, ..., to the sum of the mismatch
+ * penalties of rd[i..n) against rf[i..n), stopping at the first i where
+ * scores[i] is less than 'floor'.  Return that i, or -1 if there is none.
+ */
+static inline int spliceScanSuffix(
+	const char*    rd,
+	const char*    qual,
+	const char*    rf,
+	int            n,
+	const Scoring& sc,
+	int64_t        floor,
+	int64_t*       scores)
+{
+	int64_t sum = 0;
+	for(int i = n; i > 0; i -= 16) {
+		int w = min<int>(16, i);
+		int lo = i - w;
+		uint32_t mm = 0;
+		if(w == 16) {
+			mm = spliceScanMismatches16(rd + lo, rf + lo);
+		} else {
+			for(int j = 0; j < w; j++) {
+				if(rd[lo + j] != rf[lo + j]) mm |= (1 << j);
+			}
+		}
+		for(int j = w - 1; j >= 0; j--) {
+			if((mm >> j) & 1) {
+				sum += sc.score(rd[lo + j], 1 << rf[lo + j], qual[lo + j] - 33);
+			}
+			scores[lo + j] = sum;
+			if(sum < floor) return lo + j;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Return the splice direction (SPL_FW, SPL_RC, SPL_SEMI_FW, SPL_SEMI_RC or
+ * SPL_UNKNOWN) implied by donor dinucleotide d0 d1 and acceptor
+ * dinucleotide a0 a1, both read along the reference.
+ */
+static inline uint8_t spliceScanMotif(int d0, int d1, int a0, int a1) {
+	// 0 = A, 1 = C, 2 = G, 3 = T
+	if(d0 == 2 && d1 == 3 && a0 == 0 && a1 == 2) return SPL_FW;      // GT-AG
+	if(d0 == 1 && d1 == 3 && a0 == 0 && a1 == 1) return SPL_RC;      // CT-AC
+	if((d0 == 2 && d1 == 1 && a0 == 0 && a1 == 2) ||                 // GC-AG
+	   (d0 == 0 && d1 == 3 && a0 == 0 && a1 == 1)) return SPL_SEMI_FW; // AT-AC
+	if((d0 == 1 && d1 == 3 && a0 == 2 && a1 == 1) ||                 // CT-GC
+	   (d0 == 2 && d1 == 0 && a0 == 0 && a1 == 3)) return SPL_SEMI_RC; // GA-AT
+	return SPL_UNKNOWN;
+}
+
+/**
+ * Set dirs[i], for i < n, to the splice direction of a breakpoint whose
+ * donor dinucleotide is donor[i] donor[i+1] and whose acceptor
+ * dinucleotide is acceptor[i] acceptor[i+1].  Reads donor[0..n] and
+ * acceptor[0..n].
+ */
+static inline void spliceScanMotifs(
+	const char* donor,
+	const char* acceptor,
+	int         n,
+	uint8_t*    dirs)
+{
+	int i = 0;
+	const __m128i A = _mm_set1_epi8(0), C = _mm_set1_epi8(1);
+	const __m128i G = _mm_set1_epi8(2), T = _mm_set1_epi8(3);
+	for(; i + 16 <= n; i += 16) {
+		__m128i d0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(donor + i));
+		__m128i d1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(donor + i + 1));
+		__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acceptor + i));
+		__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acceptor + i + 1));
+		__m128i dG0 = _mm_cmpeq_epi8(d0, G), dC0 = _mm_cmpeq_epi8(d0, C), dA0 = _mm_cmpeq_epi8(d0, A);
+		__m128i dT1 = _mm_cmpeq_epi8(d1, T), dC1 = _mm_cmpeq_epi8(d1, C), dA1 = _mm_cmpeq_epi8(d1, A);
+		__m128i aA0 = _mm_cmpeq_epi8(a0, A), aG0 = _mm_cmpeq_epi8(a0, G);
+		__m128i aG1 = _mm_cmpeq_epi8(a1, G), aC1 = _mm_cmpeq_epi8(a1, C), aT1 = _mm_cmpeq_epi8(a1, T);
+		__m128i dGT = _mm_and_si128(dG0, dT1), dCT = _mm_and_si128(dC0, dT1);
+		__m128i dGC = _mm_and_si128(dG0, dC1), dAT = _mm_and_si128(dA0, dT1);
+		__m128i dGA = _mm_and_si128(dG0, dA1);
+		__m128i aAG = _mm_and_si128(aA0, aG1), aAC = _mm_and_si128(aA0, aC1);
+		__m128i aGC = _mm_and_si128(aG0, aC1), aAT = _mm_and_si128(aA0, aT1);
+		// The four classes are disjoint
+		__m128i fw = _mm_and_si128(dGT, aAG);
+		__m128i rc = _mm_and_si128(dCT, aAC);
+		__m128i semi_fw = _mm_or_si128(_mm_and_si128(dGC, aAG), _mm_and_si128(dAT, aAC));
+		__m128i semi_rc = _mm_or_si128(_mm_and_si128(dCT, aGC), _mm_and_si128(dGA, aAT));
+		__m128i any = _mm_or_si128(_mm_or_si128(fw, rc), _mm_or_si128(semi_fw, semi_rc));
+		__m128i x = _mm_andnot_si128(any, _mm_set1_epi8(SPL_UNKNOWN));
+		x = _mm_or_si128(x, _mm_and_si128(fw, _mm_set1_epi8(SPL_FW)));
+		x = _mm_or_si128(x, _mm_and_si128(rc, _mm_set1_epi8(SPL_RC)));
+		x = _mm_or_si128(x, _mm_and_si128(semi_fw, _mm_set1_epi8(SPL_SEMI_FW)));
+		x = _mm_or_si128(x, _mm_and_si128(semi_rc, _mm_set1_epi8(SPL_SEMI_RC)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dirs + i), x);
+	}
+	for(; i < n; i++) {
+		dirs[i] = spliceScanMotif(donor[i], donor[i + 1], acceptor[i], acceptor[i + 1]);
+	}
+#ifndef NDEBUG
+	for(int j = 0; j < n; j++) {
+		assert_eq(spliceScanMotif(donor[j], donor[j + 1], acceptor[j], acceptor[j + 1]), dirs[j]);
+	}
+#endif
+}
+
+#endif /*SPLICE_SCAN_H_*/
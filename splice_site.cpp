@@ -152,6 +152,7 @@ _empty(true)
         _pool.expand();
         _spliceSites.expand();
         _mutex.push_back(MUTEX_T());
+        LOCK_SITE(_mutex.back(), "SpliceSiteDB");
     }
     
     donorstr.resize(donor_exonic_len + donor_intronic_len);
@@ -439,7 +440,8 @@ bool SpliceSiteDB::hasSpliceSites(
                                   uint32_t right1,
                                   uint32_t left2,
                                   uint32_t right2,
-                                  bool includeNovel) const
+                                  bool includeNovel,
+                                  uint64_t novelBound) const
 {
     if(!_read) return false;
     
@@ -452,7 +454,7 @@ bool SpliceSiteDB::hasSpliceSites(
         assert(_bwIndex[ref] != NULL);
         const Node *cur = _bwIndex[ref]->root();
         if(cur != NULL) {
-            if(hasSpliceSites_recur(cur, left1, right1, includeNovel))
+            if(hasSpliceSites_recur(cur, left1, right1, includeNovel, novelBound))
                 return true;
         }
     }
@@ -462,7 +464,7 @@ bool SpliceSiteDB::hasSpliceSites(
         assert(_fwIndex[ref] != NULL);
         const Node *cur = _fwIndex[ref]->root();
         if(cur != NULL) {
-            return hasSpliceSites_recur(cur, left2, right2, includeNovel);
+            return hasSpliceSites_recur(cur, left2, right2, includeNovel, novelBound);
         }
     }
     return false;
@@ -472,7 +474,8 @@ bool SpliceSiteDB::hasSpliceSites_recur(
                                         const RedBlackNode<SpliceSitePos, uint32_t> *node,
                                         uint32_t left,
                                         uint32_t right,
-                                        bool includeNovel) const
+                                        bool includeNovel,
+                                        uint64_t novelBound) const
 {
     assert(node != NULL);
     if(node->key.left() >= left && node->key.left() <= right) {
@@ -480,7 +483,7 @@ bool SpliceSiteDB::hasSpliceSites_recur(
         assert_lt(ref, _spliceSites.size());
         assert_lt(node->payload, _spliceSites[ref].size());
         const SpliceSite& ss = _spliceSites[ref][node->payload];
-        if(includeNovel || ss._known)
+        if(ss._known || (includeNovel && (ss._fromfile || ss._readid < novelBound)))
             return true;
     }
     
@@ -489,7 +492,8 @@ bool SpliceSiteDB::hasSpliceSites_recur(
                                 node->left,
                                 left,
                                 right,
-                                includeNovel))
+                                includeNovel,
+                                novelBound))
             return true;
     }
     
@@ -498,7 +502,8 @@ bool SpliceSiteDB::hasSpliceSites_recur(
                                 node->right,
                                 left,
                                 right,
-                                includeNovel))
+                                includeNovel,
+                                novelBound))
             return true;
     }
     
@@ -371,6 +371,22 @@ public:
 
 std::ostream& operator<<(std::ostream& out, const SpliceSite& c);
 
+/**
+ * Return the read id below which novel splice sites found during this run
+ * may be used to align read 'rdid'; a site is usable if one of the reads
+ * that found it has a smaller id.  With 'epoch' > 0, reads are grouped
+ * into epochs of that many reads and a read sees the sites found in all
+ * epochs before the previous one, regardless of the number of threads.
+ * Otherwise it sees the sites found by reads at least 'mindist' before it.
+ */
+static inline uint64_t novelSpliceSiteBound(uint64_t rdid, uint64_t mindist, uint64_t epoch) {
+    if(epoch > 0) {
+        uint64_t e = rdid / epoch;
+        return e > 0 ? (e - 1) * epoch : 0;
+    }
+    return rdid + 1 >= mindist ? rdid + 1 - mindist : 0;
+}
+
 /**
  *
  */
@@ -549,7 +565,8 @@ public:
     bool getSpliceSite(SpliceSite& ss) const;
     void getLeftSpliceSites(uint32_t ref, uint32_t left, uint32_t range, EList<SpliceSite>& spliceSites) const;
     void getRightSpliceSites(uint32_t ref, uint32_t right, uint32_t range, EList<SpliceSite>& spliceSites) const;
-    bool hasSpliceSites(uint32_t ref, uint32_t left1, uint32_t right1, uint32_t left2, uint32_t right2, bool includeNovel = false) const;
+    bool hasSpliceSites(uint32_t ref, uint32_t left1, uint32_t right1, uint32_t left2, uint32_t right2, bool includeNovel = false,
+                        uint64_t novelBound = std::numeric_limits<uint64_t>::max()) const;
     bool insideExon(uint32_t ref, uint32_t left, uint32_t right) const;
     
     void print(ofstream& out);
@@ -567,7 +584,8 @@ private:
                               const RedBlackNode<SpliceSitePos, uint32_t> *node,
                               uint32_t left,
                               uint32_t right,
-                              bool includeNovel) const;    
+                              bool includeNovel,
+                              uint64_t novelBound) const;    
     
     const RedBlackNode<SpliceSitePos, uint32_t>* getSpliceSite_temp(const SpliceSitePos& ssp) const;
     
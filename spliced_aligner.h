@@ -38,12 +38,14 @@ public:
                    bool anchorStop,
                    bool secondary = false,
                    bool local = false,
-                   uint64_t threads_rids_mindist = 0) :
+                   uint64_t threads_rids_mindist = 0,
+                   uint64_t ss_epoch = 0) :
     HI_Aligner<index_t, local_index_t>(gfm,
                                        anchorStop,
                                        secondary,
                                        local,
-                                       threads_rids_mindist)
+                                       threads_rids_mindist,
+                                       ss_epoch)
     {
     }
     
@@ -131,6 +133,7 @@ void SplicedAligner<index_t, local_index_t>::hybridSearch(
 {
     assert_lt(rdi, 2);
     assert(this->_rds[rdi] != NULL);
+    StageTimer stageTimer(&him.stages, STAGE_EXTEND);
     him.localatts++;
     
     // before further alignment using local search, extend the partial alignments directly
@@ -167,6 +170,7 @@ void SplicedAligner<index_t, local_index_t>::hybridSearch(
             if(!this->_genomeHits_done[hj]) break;
         }
         if(hj >= this->_genomeHits.size()) break;
+        if(this->overBudget(him)) break;
         for(index_t hk = hj + 1; hk < this->_genomeHits.size(); hk++) {
             if(this->_genomeHits_done[hk]) continue;
             GenomeHit<index_t>& genomeHit_j = this->_genomeHits[hj];
@@ -241,6 +245,8 @@ int64_t SplicedAligner<index_t, local_index_t>::hybridSearch_recur(
     index_t rdlen = (index_t)rd.length();
     if(hit.score() < this->_minsc[rdi]) return maxsc;
     if(dep >= 128) return maxsc;
+    // once over the per-read budget, only report hits that are already full
+    if((hitoff != 0 || hitlen != rdlen) && this->overBudget(him)) return maxsc;
     
     // if it's already examined, just return
     if(hitoff == hit.rdoff() - hit.trim5() && hitlen == hit.len() + hit.trim5() + hit.trim3()) {
@@ -302,7 +308,7 @@ int64_t SplicedAligner<index_t, local_index_t>::hybridSearch_recur(
                     ssdb.getLeftSpliceSites(hit.ref(), left + minMatchLen, minMatchLen, spliceSites);
                     for(size_t si = 0; si < spliceSites.size(); si++) {
                         const SpliceSite& ss = spliceSites[si];
-                        if(!ss._fromfile && ss._readid + this->_thread_rids_mindist > rd.rdid) continue;
+                        if(!ss._fromfile && ss._readid >= this->novelSpliceSiteBound(rd.rdid)) continue;
                         if(left + fraglen - 1 < ss.right()) continue;
                         index_t frag2off = ss.left() -  (ss.right() - left);
                         if(frag2off + 1 < hitoff) continue;
@@ -420,7 +426,7 @@ int64_t SplicedAligner<index_t, local_index_t>::hybridSearch_recur(
                         for(size_t si = 0; si < spliceSites.size(); si++) {
                             const GenomeHit<index_t>& canHit = this->_local_genomeHits[dep][i];
                             const SpliceSite& ss = spliceSites[si];
-                            if(!ss._fromfile && ss._readid + this->_thread_rids_mindist > rd.rdid) continue;
+                            if(!ss._fromfile && ss._readid >= this->novelSpliceSiteBound(rd.rdid)) continue;
                             if(right > ss.left()) continue;
                             GenomeHit<index_t> tempHit;
                             index_t readoff = fragoff + ss.left() - right + 1;
@@ -559,7 +565,7 @@ int64_t SplicedAligner<index_t, local_index_t>::hybridSearch_recur(
                 ssdb.getLeftSpliceSites(hit.ref(), left + minMatchLen, minMatchLen + min<index_t>(minMatchLen, fragoff), spliceSites);
                 for(size_t si = 0; si < spliceSites.size(); si++) {
                     const SpliceSite& ss = spliceSites[si];
-                    if(!ss._fromfile && ss._readid + this->_thread_rids_mindist > rd.rdid) continue;
+                    if(!ss._fromfile && ss._readid >= this->novelSpliceSiteBound(rd.rdid)) continue;
                     if(left + fraglen - 1 < ss.right()) continue;
                     if(fragoff + ss.right() < left + 1) continue;
                     index_t readoff = fragoff + ss.right() - left - 1;
@@ -1213,7 +1219,7 @@ int64_t SplicedAligner<index_t, local_index_t>::hybridSearch_recur(
                 ssdb.getRightSpliceSites(hit.ref(), right + fraglen - minMatchLen, minMatchLen + min<index_t>(minMatchLen, right_unmapped_len), spliceSites);
                 for(size_t si = 0; si < spliceSites.size(); si++) {
                     const SpliceSite& ss = spliceSites[si];
-                    if(!ss._fromfile && ss._readid + this->_thread_rids_mindist > rd.rdid) continue;
+                    if(!ss._fromfile && ss._readid >= this->novelSpliceSiteBound(rd.rdid)) continue;
                     if(right > ss.left()) continue;
                     GenomeHit<index_t> tempHit;
                     assert_leq(right, ss.left());
@@ -232,7 +232,7 @@ private:
 		}
 		assert_eq(0, (tmpint & 0xf)); // should be 16-byte aligned
 		assert(tmp != NULL);
-		gMemTally.add(cat_, sz);
+		gMemTally.add(cat_, sizeof(__m128i) * sz);
 		return tmp;
 	}
 
@@ -243,7 +243,7 @@ private:
 	void free() {
 		if(list_ != NULL) {
 			delete[] last_alloc_;
-			gMemTally.del(cat_, sz_);
+			gMemTally.del(cat_, sizeof(__m128i) * sz_);
 			list_ = NULL;
 			sz_ = cur_ = 0;
 		}
@@ -2005,6 +2005,32 @@ public:
 		append(b, strlen(b));
 	}
 
+	/**
+	 * Append 'sz' elements of 'b', each mapped through 'xform', with a
+	 * single capacity check.  Used to print 2-bit encoded sequence without
+	 * going through an intermediate print buffer.
+	 */
+	void appendXForm(const T* b, size_t sz, const char* xform) {
+		if(sz_ < len_ + sz) expandCopy((len_ + sz + S) * M);
+		T* dst = cs_ + len_;
+		for(size_t i = 0; i < sz; i++) {
+			dst[i] = xform[(int)b[i]];
+		}
+		len_ += sz;
+	}
+
+	/**
+	 * Append 'sz' elements of 'b' in reverse order.
+	 */
+	void appendReverse(const T* b, size_t sz) {
+		if(sz_ < len_ + sz) expandCopy((len_ + sz + S) * M);
+		T* dst = cs_ + len_;
+		for(size_t i = 0; i < sz; i++) {
+			dst[i] = b[sz - i - 1];
+		}
+		len_ += sz;
+	}
+
 	/**
 	 * Return the length of the string.
 	 */
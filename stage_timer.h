@@ -0,0 +1,162 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STAGE_TIMER_H_
+#define STAGE_TIMER_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "ticks.h"
+#include "threading.h"
+
+/**
+ * Stages of the alignment pipeline that per-thread cycle counts are kept
+ * for.  STAGE_OTHER collects whatever a worker does outside of the other
+ * stages.
+ */
+enum {
+	STAGE_OTHER = 0,
+	STAGE_PARSE,      // reading and parsing input reads
+	STAGE_GLOBAL,     // FM search against the global index
+	STAGE_RESOLVE,    // resolving SA ranges to genome coordinates
+	STAGE_LOCAL,      // FM search against local indexes
+	STAGE_EXTEND,     // extending and combining hits
+	STAGE_PAIR,       // pairing mate alignments
+	STAGE_SAM,        // selecting and formatting alignments for output
+	STAGE_OUTPUT,     // waiting for and writing to the output queue
+	STAGE_NUM
+};
+
+/**
+ * Short names used for the metrics column headers.
+ */
+static const char* const stageNames[STAGE_NUM] = {
+	"Other", "Parse", "Global", "Resolve", "Local",
+	"Extend", "Pair", "Sam", "Output"
+};
+
+/**
+ * Per-stage tick and call counts.  Stages nest; ticks are charged to the
+ * innermost active stage only, so the counts of all stages add up to the
+ * time the owning thread spent between resets.  Each worker keeps its
+ * own object and merges it into the global one like the other metrics.
+ */
+struct StageMetrics {
+
+	StageMetrics() : mutex_m() {
+		LOCK_SITE(mutex_m, "StageMetrics");
+		cur = STAGE_OTHER;
+		last = cpuTicks();
+		reset();
+	}
+
+	/**
+	 * Zero the counts.  The active stage and the time of the last switch
+	 * are left alone, so the ticks since then are charged to the current
+	 * stage in the next interval rather than lost.
+	 */
+	void reset() {
+		memset(ticks, 0, sizeof(ticks));
+		memset(calls, 0, sizeof(calls));
+	}
+
+	/**
+	 * Charge ticks since the last switch to the current stage without
+	 * switching, so the counts are up to date before they are merged or
+	 * reported.
+	 */
+	void charge() {
+		uint64_t now = cpuTicks();
+		ticks[cur] += now - last;
+		last = now;
+	}
+
+	/**
+	 * Merge (add) the counters in the given StageMetrics object into this
+	 * object.
+	 */
+	void merge(const StageMetrics& r, bool getLock = false) {
+		ThreadSafe ts(&mutex_m, getLock);
+		for(int i = 0; i < STAGE_NUM; i++) {
+			ticks[i] += r.ticks[i];
+			calls[i] += r.calls[i];
+		}
+	}
+
+	/**
+	 * Charge ticks since the last switch to the current stage and make
+	 * 'stage' current.  Returns the stage that was current before.
+	 */
+	int enter(int stage) {
+		uint64_t now = cpuTicks();
+		ticks[cur] += now - last;
+		last = now;
+		calls[stage]++;
+		int prev = cur;
+		cur = stage;
+		return prev;
+	}
+
+	/**
+	 * Charge ticks since the last switch to the current stage and return
+	 * to stage 'prev'.
+	 */
+	void leave(int prev) {
+		uint64_t now = cpuTicks();
+		ticks[cur] += now - last;
+		last = now;
+		cur = prev;
+	}
+
+	uint64_t ticks[STAGE_NUM]; // ticks charged to each stage
+	uint64_t calls[STAGE_NUM]; // # times each stage was entered
+	uint64_t last;             // tick count at the last stage switch
+	int      cur;              // innermost active stage
+
+	MUTEX_T mutex_m;
+};
+
+/**
+ * Charges the lifetime of the object to a stage in a StageMetrics.  Does
+ * nothing if the StageMetrics pointer is NULL or if compiled with
+ * NO_STAGE_TIMING.
+ */
+class StageTimer {
+public:
+	StageTimer(StageMetrics* met, int stage) {
+#ifndef NO_STAGE_TIMING
+		met_ = met;
+		prev_ = (met_ != NULL) ? met_->enter(stage) : STAGE_OTHER;
+#endif
+	}
+
+	~StageTimer() {
+#ifndef NO_STAGE_TIMING
+		if(met_ != NULL) met_->leave(prev_);
+#endif
+	}
+
+private:
+#ifndef NO_STAGE_TIMING
+	StageMetrics* met_;
+	int prev_;
+#endif
+};
+
+#endif /*ndef STAGE_TIMER_H_*/
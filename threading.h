@@ -24,11 +24,22 @@
 #include "tinythread.h"
 #include "fast_mutex.h"
 
-#ifdef NO_SPINLOCK
+#ifdef LOCK_PROFILE
+#   include "lock_profile.h"
+#   define MUTEX_T ProfiledMutex
+#elif defined(NO_SPINLOCK)
 #   define MUTEX_T tthread::mutex
 #else
 #  	define MUTEX_T tthread::fast_mutex
-#endif /* NO_SPINLOCK */
+#endif /* LOCK_PROFILE */
+
+/**
+ * Name the lock site a mutex is reported under when built with
+ * LOCK_PROFILE (see lock_profile.h); does nothing otherwise.
+ */
+#ifndef LOCK_PROFILE
+#   define LOCK_SITE(m, name)
+#endif
 
 
 /**
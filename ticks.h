@@ -0,0 +1,79 @@
+/*
+ * Copyright 2015, Daehwan Kim <infphilo@gmail.com>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TICKS_H_
+#define TICKS_H_
+
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * Cheap monotonic tick counter: the time-stamp counter on x86, nanoseconds
+ * from the monotonic clock elsewhere.
+ */
+static inline uint64_t cpuTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/**
+ * Measure the number of cpuTicks() per microsecond against the monotonic
+ * clock, over about 10 ms.
+ */
+static inline double measureTicksPerUsec() {
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	uint64_t c0 = cpuTicks();
+	uint64_t ns;
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		ns = (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000ull + t1.tv_nsec - t0.tv_nsec;
+	} while(ns < 10000000ull);
+	return (double)(cpuTicks() - c0) * 1000.0 / ns;
+}
+
+/**
+ * Return the number of cpuTicks() per microsecond, measuring it on first
+ * use on x86.
+ */
+static inline double ticksPerUsec() {
+#if defined(__x86_64__) || defined(__i386__)
+	static const double rate = measureTicksPerUsec();
+	return rate;
+#else
+	return 1000.0;
+#endif
+}
+
+/**
+ * Convert a difference of cpuTicks() values to microseconds.
+ */
+static inline uint64_t ticksToUsecs(uint64_t ticks) {
+	return (uint64_t)(ticks / ticksPerUsec() + 0.5);
+}
+
+#endif /*ndef TICKS_H_*/
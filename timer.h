@@ -21,21 +21,27 @@
 #define TIMER_H_
 
 #include <ctime>
+#include <stdint.h>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <sys/time.h>
 
 using namespace std;
 
 /**
- * Use time() call to keep track of elapsed time between creation and
+ * Use gettimeofday() to keep track of elapsed time between creation and
  * destruction.  If verbose is true, Timer will print a message showing
- * elapsed time to the given output stream upon destruction.
+ * elapsed time to the given output stream upon destruction, as HH:MM:SS
+ * or, if millis is true, as HH:MM:SS.mmm.
  */
 class Timer {
 public:
-	Timer(ostream& out = cout, const char *msg = "", bool verbose = true) :
-		_t(time(0)), _out(out), _msg(msg), _verbose(verbose) { }
+	Timer(ostream& out = cout, const char *msg = "", bool verbose = true, bool millis = false) :
+		_t(time(0)), _out(out), _msg(msg), _verbose(verbose), _millis(millis)
+	{
+		gettimeofday(&_tv, NULL);
+	}
 
 	/// Optionally print message
 	~Timer() {
@@ -46,26 +52,50 @@ public:
 	time_t elapsed() const {
 		return time(0) - _t;
 	}
+
+	/// Return elapsed time in seconds, with microsecond resolution
+	double elapsedSecs() const {
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		return (tv.tv_sec - _tv.tv_sec) + (tv.tv_usec - _tv.tv_usec) / 1e6;
+	}
 	
 	void write(ostream& out) {
-		time_t passed = elapsed();
-		// Print the message supplied at construction time followed
-		// by time elapsed formatted HH:MM:SS 
-		time_t hours   = (passed / 60) / 60;
-		time_t minutes = (passed / 60) % 60;
-		time_t seconds = (passed % 60);
+		if(!_millis) {
+			time_t passed = elapsed();
+			// Print the message supplied at construction time followed
+			// by time elapsed formatted HH:MM:SS 
+			time_t hours   = (passed / 60) / 60;
+			time_t minutes = (passed / 60) % 60;
+			time_t seconds = (passed % 60);
+			std::ostringstream oss;
+			oss << _msg << setfill ('0') << setw (2) << hours << ":"
+			           << setfill ('0') << setw (2) << minutes << ":"
+			           << setfill ('0') << setw (2) << seconds << endl;
+			out << oss.str().c_str();
+			return;
+		}
+		uint64_t passed = (uint64_t)(elapsedSecs() * 1000.0 + 0.5);
+		// Same, formatted HH:MM:SS.mmm
+		uint64_t hours   = passed / (60 * 60 * 1000);
+		uint64_t minutes = (passed / (60 * 1000)) % 60;
+		uint64_t seconds = (passed / 1000) % 60;
+		uint64_t millis  = passed % 1000;
 		std::ostringstream oss;
 		oss << _msg << setfill ('0') << setw (2) << hours << ":"
 		           << setfill ('0') << setw (2) << minutes << ":"
-		           << setfill ('0') << setw (2) << seconds << endl;
+		           << setfill ('0') << setw (2) << seconds << "."
+		           << setfill ('0') << setw (3) << millis << endl;
 		out << oss.str().c_str();
 	}
 	
 private:
-	time_t      _t;
-	ostream&    _out;
-	const char *_msg;
-	bool        _verbose;
+	time_t         _t;
+	struct timeval _tv;
+	ostream&       _out;
+	const char    *_msg;
+	bool           _verbose;
+	bool           _millis;
 };
 
 static inline void logTime(std::ostream& os, bool nl = true) {
@@ -24,28 +24,57 @@
 #include <limits>
 
 /**
- * C++ version char* style "itoa":
+ * Pairs of decimal digits "00" through "99", used by itoa10 to emit two
+ * digits per division.
+ */
+static const char itoa10_digits[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/**
+ * C++ version char* style "itoa".  Writes the decimal representation of
+ * 'value' plus a terminator to 'result' and returns a pointer to the
+ * terminator, so callers can append exactly (ret - result) chars.  Digits
+ * are produced two at a time from the back of a scratch buffer, which
+ * avoids both a division per digit and the final reverse.
  */
 template<typename T>
 char* itoa10(const T& value, char* result) {
-	// Check that base is valid
-	char* out = result;
+	char tmp[std::numeric_limits<T>::digits10 + 3];
+	char* end = tmp + sizeof(tmp);
+	char* p = end;
 	T quotient = value;
 	if(std::numeric_limits<T>::is_signed) {
 		if(quotient <= 0) quotient = 0-quotient;
 	}
-	// Now write each digit from most to least significant
-	do {
-		*out = "0123456789"[quotient % 10];
-		++out;
-		quotient /= 10;
-	} while (quotient > 0);
+	while(quotient >= 100) {
+		int r = (int)(quotient % 100);
+		quotient /= 100;
+		*--p = itoa10_digits[2*r+1];
+		*--p = itoa10_digits[2*r];
+	}
+	if(quotient >= 10) {
+		int r = (int)quotient;
+		*--p = itoa10_digits[2*r+1];
+		*--p = itoa10_digits[2*r];
+	} else {
+		*--p = (char)('0' + (int)quotient);
+	}
+	char* out = result;
 	// Only apply negative sign for base 10
 	if(std::numeric_limits<T>::is_signed) {
 		// Avoid compiler warning in cases where T is unsigned
 		if (value <= 0 && value != 0) *out++ = '-';
 	}
-	reverse( result, out );
+	while(p < end) *out++ = *p++;
 	*out = 0; // terminator
 	return out;
 }
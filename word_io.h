@@ -21,6 +21,8 @@
 #define WORD_IO_H_
 
 #include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
 #include <unistd.h>
 #include <iostream>
 #include <fstream>
@@ -372,5 +374,27 @@ static inline index_t readIndex(FILE* in, bool swap) {
 	}
 }
 
+/**
+ * Seek a FILE* to an absolute or relative offset that may not fit in a
+ * long, i.e. past 2 GB where long is 32 bits.
+ */
+static inline int fseek64(FILE* f, int64_t off, int whence) {
+#ifdef _WIN32
+	return _fseeki64(f, off, whence);
+#else
+	return fseeko(f, (off_t)off, whence);
+#endif
+}
+
+/**
+ * Return the position of a FILE* as a 64-bit offset.
+ */
+static inline int64_t ftell64(FILE* f) {
+#ifdef _WIN32
+	return _ftelli64(f);
+#else
+	return (int64_t)ftello(f);
+#endif
+}
 
 #endif /*WORD_IO_H_*/